@@ -3,10 +3,18 @@
 
 #include <iostream>
 #include <thread>
+#if defined(_WIN32)
 #include "base/task_queue_win.h"
+#else
+#include "base/task_queue_linux.h"
+#endif
 int main()
 {
+#if defined(_WIN32)
   auto task_queue_win_factory = webrtc::CreateTaskQueueWinFactory();
+#else
+  auto task_queue_win_factory = webrtc::CreateTaskQueueLinuxFactory();
+#endif
   auto task_queue_win = task_queue_win_factory->CreateTaskQueue("test", webrtc::TaskQueueFactory::Priority::HIGH);
   task_queue_win->PostDelayedHighPrecisionTask([] {
     std::cout << "Hello World111!\n";
@@ -0,0 +1,443 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "delayed_task_store.h"
+
+#include <algorithm>
+#include <limits>
+#include <new>
+#include <utility>
+
+namespace webrtc {
+
+struct DelayedTaskStore::Entry {
+  Entry(Timestamp due_time, uint64_t sequence, QueuedClosure task,
+        rtc::scoped_refptr<CancelableTaskState> cancelable, size_t charge)
+    : due_time_us(due_time.us()), sequence(sequence), task(std::move(task)),
+      cancelable(std::move(cancelable)), charge(charge) {}
+  int64_t due_time_us;
+  uint64_t sequence;
+  // Exactly one of `task` and `cancelable` is set; a cancelable task keeps its
+  // closure in the shared state.
+  QueuedClosure task;
+  rtc::scoped_refptr<CancelableTaskState> cancelable;
+  size_t charge;
+  // Timing wheel slot links; `next` also links the free list.
+  Entry* prev = nullptr;
+  Entry* next = nullptr;
+  int level = 0;
+  int index = 0;
+  // Heap: cancelled, waiting to be discarded.
+  bool removed = false;
+};
+
+DelayedTaskStore::~DelayedTaskStore() {
+  while (free_entries_) {
+    Entry* next = free_entries_->next;
+    delete free_entries_;
+    free_entries_ = next;
+  }
+}
+
+void DelayedTaskStore::Insert(Timestamp now, Timestamp due_time, QueuedClosure task, size_t charge) {
+  InsertEntry(now, NewEntry(due_time, std::move(task), nullptr, charge));
+}
+
+void DelayedTaskStore::Insert(Timestamp now, Timestamp due_time, rtc::scoped_refptr<CancelableTaskState> task) {
+  // Cancelled from another thread while on its way to the queue.
+  if (!task->IsPending())
+    return;
+  CancelableTaskState* state = task.get();
+  Entry* entry = NewEntry(due_time, nullptr, std::move(task), 0);
+  state->SetStoreEntry(this, entry);
+  InsertEntry(now, entry);
+}
+
+Timestamp DelayedTaskStore::CoalescedDueTime(Timestamp earliest, TimeDelta slack) const {
+  if (slack <= TimeDelta::Zero())
+    return earliest;
+  absl::optional<Timestamp> wakeup = NextWakeupTime();
+  if (wakeup && *wakeup >= earliest && *wakeup <= earliest + slack)
+    return *wakeup;
+  const int64_t grid_us = slack.us();
+  const int64_t earliest_us = earliest.us();
+  return Timestamp::Micros((earliest_us / grid_us + (earliest_us % grid_us > 0 ? 1 : 0)) * grid_us);
+}
+
+DelayedTaskStore::Entry* DelayedTaskStore::NewEntry(Timestamp due_time, QueuedClosure task,
+                                                    rtc::scoped_refptr<CancelableTaskState> cancelable,
+                                                    size_t charge) {
+  Entry* entry = free_entries_;
+  if (entry == nullptr)
+    return new Entry(due_time, next_sequence_++, std::move(task), std::move(cancelable), charge);
+  free_entries_ = entry->next;
+  entry->~Entry();
+  return new (entry) Entry(due_time, next_sequence_++, std::move(task), std::move(cancelable), charge);
+}
+
+DelayedTaskStore::DueTask DelayedTaskStore::ReleaseEntry(Entry* entry) {
+  QueuedClosure task;
+  if (entry->cancelable) {
+    entry->cancelable->SetStoreEntry(nullptr, nullptr);
+    task = [state = std::move(entry->cancelable)] { state->Run(); };
+  } else {
+    task = std::move(entry->task);
+  }
+  const Timestamp due_time = Timestamp::Micros(entry->due_time_us);
+  const size_t charge = entry->charge;
+  DeleteEntry(entry);
+  return {std::move(task), due_time, charge};
+}
+
+void DelayedTaskStore::DeleteEntry(Entry* entry) {
+  if (entry->cancelable) {
+    entry->cancelable->SetStoreEntry(nullptr, nullptr);
+    entry->cancelable = nullptr;
+  }
+  // Captures are released now; only the entry's memory is kept for reuse.
+  entry->task = nullptr;
+  entry->next = free_entries_;
+  free_entries_ = entry;
+}
+
+namespace {
+
+class HeapDelayedTaskStore final : public DelayedTaskStore {
+ public:
+  ~HeapDelayedTaskStore() override {
+    for (Entry* entry : timer_tasks_)
+      DeleteEntry(entry);
+  }
+
+  void Remove(void* entry_ptr) override {
+    Entry* entry = static_cast<Entry*>(entry_ptr);
+    // Release the shared state now; the entry itself stays in the heap until
+    // it reaches the top or the heap is compacted.
+    entry->cancelable->SetStoreEntry(nullptr, nullptr);
+    entry->cancelable = nullptr;
+    entry->removed = true;
+    ++removed_count_;
+    PopRemoved();
+    if (removed_count_ > 16 && removed_count_ * 2 > timer_tasks_.size())
+      Compact();
+  }
+
+  absl::optional<Timestamp> NextWakeupTime() const override {
+    if (timer_tasks_.empty())
+      return absl::nullopt;
+    return Timestamp::Micros(timer_tasks_.front()->due_time_us);
+  }
+
+  void TakeDueTasks(Timestamp now, std::vector<DueTask>* tasks) override {
+    while (!timer_tasks_.empty() && timer_tasks_.front()->due_time_us <= now.us()) {
+      tasks->push_back(ReleaseEntry(Pop()));
+      PopRemoved();
+    }
+  }
+
+  bool empty() const override { return timer_tasks_.empty(); }
+  size_t size() const override { return timer_tasks_.size() - removed_count_; }
+
+ protected:
+  void InsertEntry(Timestamp /*now*/, Entry* entry) override {
+    timer_tasks_.push_back(entry);
+    std::push_heap(timer_tasks_.begin(), timer_tasks_.end(), &Later);
+  }
+
+ private:
+  // Heap order; ties are broken by posting order so equal deadlines run FIFO.
+  static bool Later(const Entry* a, const Entry* b) {
+    if (a->due_time_us != b->due_time_us)
+      return a->due_time_us > b->due_time_us;
+    return a->sequence > b->sequence;
+  }
+
+  Entry* Pop() {
+    std::pop_heap(timer_tasks_.begin(), timer_tasks_.end(), &Later);
+    Entry* entry = timer_tasks_.back();
+    timer_tasks_.pop_back();
+    return entry;
+  }
+
+  // Keeps a cancelled entry from ever being the reported next wakeup.
+  void PopRemoved() {
+    while (!timer_tasks_.empty() && timer_tasks_.front()->removed) {
+      DeleteEntry(Pop());
+      --removed_count_;
+    }
+  }
+
+  void Compact() {
+    auto live_end = std::partition(timer_tasks_.begin(), timer_tasks_.end(),
+                                   [](const Entry* entry) { return !entry->removed; });
+    for (auto it = live_end; it != timer_tasks_.end(); ++it)
+      DeleteEntry(*it);
+    timer_tasks_.erase(live_end, timer_tasks_.end());
+    std::make_heap(timer_tasks_.begin(), timer_tasks_.end(), &Later);
+    removed_count_ = 0;
+  }
+
+  std::vector<Entry*> timer_tasks_;
+  size_t removed_count_ = 0;
+};
+
+// Hierarchical timing wheel. Level 0 has one slot per tick; each slot of
+// level n covers 64^n ticks. A task is filed at the lowest level whose range
+// reaches its deadline and moves down ("cascades") when the wheel reaches
+// the start of its slot, so insert and expiry are O(1) and each task
+// cascades at most kLevels - 1 times. Per-level occupancy bitmaps let the
+// wheel jump straight to the next occupied slot instead of ticking through
+// idle time.
+class TimingWheelDelayedTaskStore final : public DelayedTaskStore {
+ public:
+  explicit TimingWheelDelayedTaskStore(int64_t tick_us) : tick_us_(tick_us) {}
+  ~TimingWheelDelayedTaskStore() override {
+    for (auto& level : slots_) {
+      for (Slot& slot : level) {
+        while (slot.head) {
+          Entry* next = slot.head->next;
+          DeleteEntry(slot.head);
+          slot.head = next;
+        }
+      }
+    }
+  }
+
+  void Remove(void* entry_ptr) override {
+    Entry* entry = static_cast<Entry*>(entry_ptr);
+    Unlink(entry);
+    DeleteEntry(entry);
+    --size_;
+  }
+
+  absl::optional<Timestamp> NextWakeupTime() const override {
+    if (size_ == 0)
+      return absl::nullopt;
+    const Slot& current = slots_[0][current_tick_ & kSlotMask];
+    if (current.head)
+      return Timestamp::Micros(current.min_due_time_us);
+    int64_t wakeup = std::numeric_limits<int64_t>::max();
+    const int first_level0 = NextOccupiedSlot();
+    if (first_level0 >= 0)
+      wakeup = slots_[0][first_level0].min_due_time_us;
+    for (int level = 1; level < kLevels; ++level) {
+      absl::optional<int64_t> tick = NextCascadeTick(level);
+      if (tick)
+        wakeup = std::min(wakeup, *tick * tick_us_);
+    }
+    return Timestamp::Micros(wakeup);
+  }
+
+  void TakeDueTasks(Timestamp now, std::vector<DueTask>* tasks) override {
+    const int64_t now_us = now.us();
+    const int64_t now_tick = TickOf(now_us);
+    CollectDue(now_us, tasks);
+    while (current_tick_ < now_tick) {
+      if (size_ == 0) {
+        current_tick_ = now_tick;
+        break;
+      }
+      current_tick_ = std::min(now_tick, NextEventTick());
+      for (int level = kLevels - 1; level >= 1; --level) {
+        if ((current_tick_ & ((int64_t{1} << (kSlotBits * level)) - 1)) == 0)
+          Cascade(level);
+      }
+      CollectDue(now_us, tasks);
+    }
+  }
+
+  bool empty() const override { return size_ == 0; }
+  size_t size() const override { return size_; }
+
+ protected:
+  void InsertEntry(Timestamp now, Entry* entry) override {
+    // With nothing filed the wheel position is free to move, which keeps the
+    // first task after an idle period out of the upper levels.
+    if (size_ == 0)
+      current_tick_ = std::max(current_tick_, TickOf(now.us()));
+    Place(entry);
+    ++size_;
+  }
+
+ private:
+  static constexpr int kSlotBits = 6;
+  static constexpr int kSlots = 1 << kSlotBits;
+  static constexpr int64_t kSlotMask = kSlots - 1;
+  static constexpr int kLevels = 5;
+  // 64^5 ticks, a little over 12 days with 1 ms ticks. Later deadlines are
+  // parked in the last slot of the top level and re-filed when it cascades.
+  static constexpr int64_t kMaxDelta = int64_t{1} << (kSlotBits * kLevels);
+
+  struct Slot {
+    Entry* head = nullptr;
+    Entry* tail = nullptr;
+    // Only maintained for level 0, where a slot holds a single tick. It may
+    // run early after a removal, which costs at most one spurious wakeup.
+    int64_t min_due_time_us = std::numeric_limits<int64_t>::max();
+  };
+
+  int64_t TickOf(int64_t time_us) const { return time_us / tick_us_; }
+
+  static uint64_t RotateRight(uint64_t bits, int shift) {
+    shift &= 63;
+    return shift == 0 ? bits : (bits >> shift) | (bits << (64 - shift));
+  }
+
+  static int CountTrailingZeros(uint64_t bits) {
+    int count = 0;
+    while ((bits & 1) == 0) {
+      bits >>= 1;
+      ++count;
+    }
+    return count;
+  }
+
+  // Index of the first occupied level 0 slot after the current one, or -1.
+  int NextOccupiedSlot() const {
+    const int current = static_cast<int>(current_tick_ & kSlotMask);
+    const uint64_t bits = occupied_[0] & ~(uint64_t{1} << current);
+    if (!bits)
+      return -1;
+    return (current + 1 + CountTrailingZeros(RotateRight(bits, current + 1))) & kSlotMask;
+  }
+
+  // Tick at which the next occupied slot of `level` (>= 1) cascades. Every
+  // slot of an upper level lies between 1 and 64 slots ahead of the wheel.
+  absl::optional<int64_t> NextCascadeTick(int level) const {
+    const uint64_t bits = occupied_[level];
+    if (!bits)
+      return absl::nullopt;
+    const int shift = kSlotBits * level;
+    const int64_t bucket = current_tick_ >> shift;
+    const int current = static_cast<int>(bucket & kSlotMask);
+    const int ahead = 1 + CountTrailingZeros(RotateRight(bits, current + 1));
+    return (bucket + ahead) << shift;
+  }
+
+  int64_t NextEventTick() const {
+    int64_t tick = std::numeric_limits<int64_t>::max();
+    const int first_level0 = NextOccupiedSlot();
+    if (first_level0 >= 0)
+      tick = current_tick_ + ((first_level0 - current_tick_) & kSlotMask);
+    for (int level = 1; level < kLevels; ++level) {
+      absl::optional<int64_t> cascade_tick = NextCascadeTick(level);
+      if (cascade_tick)
+        tick = std::min(tick, *cascade_tick);
+    }
+    return tick;
+  }
+
+  void Place(Entry* node) {
+    int64_t due_tick = TickOf(node->due_time_us);
+    int level = 0;
+    if (due_tick <= current_tick_) {
+      // Already due: file it under the current tick, which is drained next.
+      due_tick = current_tick_;
+    } else {
+      int64_t delta = due_tick - current_tick_;
+      if (delta >= kMaxDelta) {
+        delta = kMaxDelta - 1;
+        due_tick = current_tick_ + delta;
+      }
+      while (delta >= (int64_t{1} << (kSlotBits * (level + 1))))
+        ++level;
+    }
+    const int index = static_cast<int>((due_tick >> (kSlotBits * level)) & kSlotMask);
+    Slot& slot = slots_[level][index];
+    node->level = level;
+    node->index = index;
+    node->prev = slot.tail;
+    node->next = nullptr;
+    if (slot.tail)
+      slot.tail->next = node;
+    else
+      slot.head = node;
+    slot.tail = node;
+    if (level == 0)
+      slot.min_due_time_us = std::min(slot.min_due_time_us, node->due_time_us);
+    occupied_[level] |= uint64_t{1} << index;
+  }
+
+  void Unlink(Entry* node) {
+    const int level = node->level;
+    const int index = node->index;
+    Slot& slot = slots_[level][index];
+    if (node->prev)
+      node->prev->next = node->next;
+    else
+      slot.head = node->next;
+    if (node->next)
+      node->next->prev = node->prev;
+    else
+      slot.tail = node->prev;
+    if (!slot.head) {
+      slot.min_due_time_us = std::numeric_limits<int64_t>::max();
+      occupied_[level] &= ~(uint64_t{1} << index);
+    }
+  }
+
+  // Re-files every task of the `level` slot that starts at the current tick.
+  void Cascade(int level) {
+    const int index = static_cast<int>((current_tick_ >> (kSlotBits * level)) & kSlotMask);
+    Slot& slot = slots_[level][index];
+    Entry* node = slot.head;
+    slot = Slot();
+    occupied_[level] &= ~(uint64_t{1} << index);
+    while (node) {
+      Entry* next = node->next;
+      Place(node);
+      node = next;
+    }
+  }
+
+  void CollectDue(int64_t now_us, std::vector<DueTask>* tasks) {
+    const int index = static_cast<int>(current_tick_ & kSlotMask);
+    Slot& slot = slots_[0][index];
+    if (!slot.head || slot.min_due_time_us > now_us)
+      return;
+    int64_t min_due_time_us = std::numeric_limits<int64_t>::max();
+    for (Entry* node = slot.head; node;) {
+      Entry* next = node->next;
+      if (node->due_time_us <= now_us) {
+        Unlink(node);
+        tasks->push_back(ReleaseEntry(node));
+        --size_;
+      } else {
+        min_due_time_us = std::min(min_due_time_us, node->due_time_us);
+      }
+      node = next;
+    }
+    if (slot.head)
+      slot.min_due_time_us = min_due_time_us;
+  }
+
+  const int64_t tick_us_;
+  Slot slots_[kLevels][kSlots];
+  uint64_t occupied_[kLevels] = {};
+  int64_t current_tick_ = 0;
+  size_t size_ = 0;
+};
+}  // namespace
+
+std::unique_ptr<DelayedTaskStore> CreateDelayedTaskStore(DelayedTaskPolicy policy) {
+  switch (policy) {
+    case DelayedTaskPolicy::kHeap:
+      return std::make_unique<HeapDelayedTaskStore>();
+    case DelayedTaskPolicy::kTimingWheel:
+      return std::make_unique<TimingWheelDelayedTaskStore>(/*tick_us=*/1000);
+  }
+  return std::make_unique<HeapDelayedTaskStore>();
+}
+
+TimeDelta LowPrecisionSlack(TimeDelta delay, TimeDelta window) {
+  const TimeDelta millisecond = TimeDelta::Millis(1);
+  return window > millisecond && delay >= window ? window : millisecond;
+}
+
+}  // namespace webrtc
@@ -0,0 +1,97 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_DELAYED_TASK_STORE_H_
+#define RTC_BASE_DELAYED_TASK_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "inline_task.h"
+#include "scoped_refptr.h"
+#include "task_handle.h"
+#include "task_queue_options.h"
+#include "time_delta.h"
+#include "timestamp.h"
+
+namespace webrtc {
+
+// Holds the delayed tasks of one queue, keyed by due time. Timestamps come
+// from the owning queue's clock; the store never reads a clock itself. Not
+// thread safe, all calls are made on the queue thread. Entries are recycled
+// through a free list, so a store that has reached its working set no longer
+// allocates.
+class DelayedTaskStore {
+ public:
+  // A task taken out of the store, with the deadline it was filed under and
+  // the capacity it holds on a bounded queue.
+  struct DueTask {
+    QueuedClosure task;
+    Timestamp due_time;
+    size_t charge = 0;
+  };
+
+  virtual ~DelayedTaskStore();
+
+  // `now` is the queue's current time, used as the reference point for
+  // stores that bucket tasks relative to the present. `charge` is handed back
+  // with the task; cancelable tasks carry none.
+  void Insert(Timestamp now, Timestamp due_time, QueuedClosure task, size_t charge = 0);
+  // Files a cancelable task. The store records its entry in `task` so that
+  // TaskHandle::Cancel() on the owning queue can remove it through Remove().
+  void Insert(Timestamp now, Timestamp due_time, rtc::scoped_refptr<CancelableTaskState> task);
+  // Drops the entry of a cancelled task. O(1) for the timing wheel; the heap
+  // discards entries lazily and compacts once they make up half of it.
+  virtual void Remove(void* entry) = 0;
+  // Earliest time at which TakeDueTasks may return a task, or nullopt if the
+  // store is empty. The owning queue arms its timer for this time.
+  virtual absl::optional<Timestamp> NextWakeupTime() const = 0;
+  // Moves every task due at or before `now` to `tasks`, in run order.
+  virtual void TakeDueTasks(Timestamp now, std::vector<DueTask>* tasks) = 0;
+  virtual bool empty() const = 0;
+  virtual size_t size() const = 0;
+  // Deadline to file a task under that may run anywhere in
+  // [earliest, earliest + slack]: the pending wakeup if it falls in that
+  // window, otherwise the next multiple of `slack` on the clock, so that low
+  // precision timers of all queues expire on the same instants. A zero slack
+  // returns `earliest`.
+  Timestamp CoalescedDueTime(Timestamp earliest, TimeDelta slack) const;
+
+ protected:
+  struct Entry;
+
+  virtual void InsertEntry(Timestamp now, Entry* entry) = 0;
+  // Turns a stored entry into the closure to run and recycles the entry.
+  DueTask ReleaseEntry(Entry* entry);
+  void DeleteEntry(Entry* entry);
+
+ private:
+  Entry* NewEntry(Timestamp due_time,
+                  QueuedClosure task,
+                  rtc::scoped_refptr<CancelableTaskState> cancelable,
+                  size_t charge);
+
+  uint64_t next_sequence_ = 0;
+  Entry* free_entries_ = nullptr;
+};
+
+std::unique_ptr<DelayedTaskStore> CreateDelayedTaskStore(DelayedTaskPolicy policy);
+
+// Slack granted to a low precision task posted with `delay`: `window` once the
+// delay is at least that long, whole milliseconds for shorter delays so they
+// are not stretched by a multiple. Never zero; only high precision tasks are
+// filed with exact deadlines.
+TimeDelta LowPrecisionSlack(TimeDelta delay, TimeDelta window);
+
+}  // namespace webrtc
+#endif  // RTC_BASE_DELAYED_TASK_STORE_H_
@@ -0,0 +1,123 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "delayed_task_store.h"
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "time_delta.h"
+#include "timestamp.h"
+
+namespace webrtc {
+namespace {
+
+// Not on a tick boundary, so deadlines do not line up with the wheel's slots
+// by accident.
+const Timestamp kStart = Timestamp::Micros(1000000500);
+
+class DelayedTaskStoreTest : public ::testing::TestWithParam<DelayedTaskPolicy> {
+ protected:
+  DelayedTaskStoreTest() : store_(CreateDelayedTaskStore(GetParam())) {}
+
+  void Insert(Timestamp now, Timestamp due_time, int id) {
+    store_->Insert(now, due_time, QueuedClosure([this, id] { ran_.push_back(id); }));
+  }
+  // Runs what is due at `now` and returns the ids, in run order.
+  std::vector<int> RunDue(Timestamp now) {
+    std::vector<DelayedTaskStore::DueTask> due;
+    store_->TakeDueTasks(now, &due);
+    ran_.clear();
+    for (DelayedTaskStore::DueTask& task : due) {
+      EXPECT_LE(task.due_time, now);
+      std::move(task.task)();
+    }
+    return ran_;
+  }
+
+  std::unique_ptr<DelayedTaskStore> store_;
+  std::vector<int> ran_;
+};
+
+TEST_P(DelayedTaskStoreTest, RunsTasksOnTimeAndNeverEarly) {
+  Insert(kStart, kStart + TimeDelta::Millis(10), 1);
+  EXPECT_EQ(store_->size(), 1u);
+  ASSERT_TRUE(store_->NextWakeupTime());
+  EXPECT_LE(*store_->NextWakeupTime(), kStart + TimeDelta::Millis(10));
+  EXPECT_TRUE(RunDue(kStart + TimeDelta::Millis(10) - TimeDelta::Micros(1)).empty());
+  EXPECT_EQ(RunDue(kStart + TimeDelta::Millis(10)), (std::vector<int>{1}));
+  EXPECT_TRUE(store_->empty());
+  EXPECT_FALSE(store_->NextWakeupTime());
+}
+
+TEST_P(DelayedTaskStoreTest, RunsTasksInDeadlineOrder) {
+  Insert(kStart, kStart + TimeDelta::Millis(30), 3);
+  Insert(kStart, kStart + TimeDelta::Millis(10), 1);
+  Insert(kStart, kStart + TimeDelta::Millis(20), 2);
+  Insert(kStart, kStart + TimeDelta::Millis(20), 4);
+  EXPECT_EQ(RunDue(kStart + TimeDelta::Seconds(1)), (std::vector<int>{1, 2, 4, 3}));
+}
+
+// Deadlines on either side of the ranges of the wheel's levels, 64^n ticks,
+// expire exactly once their time comes, whether the queue wakes up for each
+// of them or only once for all.
+TEST_P(DelayedTaskStoreTest, ExpiresAcrossLevelBoundaries) {
+  const std::vector<int64_t> delays_ms = {1,    63,    64,     65,     4095,   4096,
+                                          4097, 65535, 262143, 262144, 262145, 16777217};
+  for (size_t i = 0; i < delays_ms.size(); ++i)
+    Insert(kStart, kStart + TimeDelta::Millis(delays_ms[i]), static_cast<int>(i));
+  for (size_t i = 0; i < delays_ms.size(); ++i) {
+    const Timestamp due_time = kStart + TimeDelta::Millis(delays_ms[i]);
+    ASSERT_TRUE(store_->NextWakeupTime());
+    EXPECT_LE(*store_->NextWakeupTime(), due_time);
+    // Wakeups before the deadline, such as the wheel's cascades, run nothing.
+    while (*store_->NextWakeupTime() < due_time)
+      EXPECT_TRUE(RunDue(*store_->NextWakeupTime()).empty());
+    EXPECT_TRUE(RunDue(due_time - TimeDelta::Micros(1)).empty());
+    EXPECT_EQ(RunDue(due_time), (std::vector<int>{static_cast<int>(i)}));
+  }
+  EXPECT_TRUE(store_->empty());
+}
+
+TEST_P(DelayedTaskStoreTest, CollectsEveryLevelInOneJump) {
+  const std::vector<int64_t> delays_ms = {16777217, 262145, 4097, 65, 1};
+  for (size_t i = 0; i < delays_ms.size(); ++i)
+    Insert(kStart, kStart + TimeDelta::Millis(delays_ms[i]), static_cast<int>(i));
+  EXPECT_EQ(RunDue(kStart + TimeDelta::Millis(16777217)), (std::vector<int>{4, 3, 2, 1, 0}));
+}
+
+// Beyond the reach of the top level, about 12 days with 1 ms ticks.
+TEST_P(DelayedTaskStoreTest, KeepsDeadlinesBeyondTheWheelRange) {
+  const Timestamp due_time = kStart + TimeDelta::Seconds(13 * 24 * 3600);
+  Insert(kStart, due_time, 1);
+  Timestamp now = kStart;
+  while (*store_->NextWakeupTime() < due_time) {
+    now = *store_->NextWakeupTime();
+    EXPECT_TRUE(RunDue(now).empty());
+  }
+  EXPECT_TRUE(RunDue(due_time - TimeDelta::Micros(1)).empty());
+  EXPECT_EQ(RunDue(due_time), (std::vector<int>{1}));
+}
+
+TEST_P(DelayedTaskStoreTest, InsertsAfterTheClockMoved) {
+  Insert(kStart, kStart + TimeDelta::Millis(100), 1);
+  EXPECT_TRUE(RunDue(kStart + TimeDelta::Millis(50)).empty());
+  const Timestamp now = kStart + TimeDelta::Millis(50);
+  Insert(now, now + TimeDelta::Millis(10), 2);
+  EXPECT_EQ(RunDue(now + TimeDelta::Millis(10)), (std::vector<int>{2}));
+  EXPECT_EQ(RunDue(kStart + TimeDelta::Millis(100)), (std::vector<int>{1}));
+}
+
+INSTANTIATE_TEST_SUITE_P(Policies,
+                         DelayedTaskStoreTest,
+                         ::testing::Values(DelayedTaskPolicy::kHeap, DelayedTaskPolicy::kTimingWheel));
+
+}  // namespace
+}  // namespace webrtc
@@ -1,31 +1,155 @@
 #include "event.h"
+#if defined(_WIN32)
 #include <windows.h>
-#include "absl/types/optional.h"
+#else
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include <stdio.h>
+
+#include <algorithm>
+#include <thread>
+
+#include "time_utils.h"
 
 namespace rtc {
+namespace {
 
-Event::Event() : Event(false, false) {}
+constexpr uint32_t kUnsignaled = 0;
+constexpr uint32_t kSignaled = 1;
+constexpr uint32_t kSleepers = 2;
+constexpr int kMinSpins = 16;
+constexpr int kMaxSpins = 4000;
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && std::atomic<uint32_t>::is_always_lock_free,
+              "the state word is waited on directly");
 
-Event::Event(bool manual_reset, bool initially_signaled) {
-  event_handle_ = ::CreateEvent(nullptr,  // Security attributes.
-                                manual_reset, initially_signaled,
-                                nullptr);  // Name.
+void CpuRelax() {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield");
+#endif
 }
 
-Event::~Event() {
-  CloseHandle(event_handle_);
+// Sleeps while `*state` holds `expected`, for at most `timeout_us` or without
+// limit if negative. May return early.
+void SleepWhile(std::atomic<uint32_t>* state, uint32_t expected, int64_t timeout_us) {
+#if defined(_WIN32)
+  const DWORD ms = timeout_us < 0 ? INFINITE : static_cast<DWORD>((timeout_us + 999) / 1000);
+  ::WaitOnAddress(state, &expected, sizeof(expected), ms);
+#else
+  timespec ts = {static_cast<time_t>(timeout_us / 1000000), static_cast<long>(timeout_us % 1000000) * 1000};
+  syscall(SYS_futex, state, FUTEX_WAIT_PRIVATE, expected, timeout_us < 0 ? nullptr : &ts, nullptr, 0);
+#endif
 }
 
+void WakeSleepers(std::atomic<uint32_t>* state, bool all) {
+#if defined(_WIN32)
+  if (all)
+    ::WakeByAddressAll(state);
+  else
+    ::WakeByAddressSingle(state);
+#else
+  syscall(SYS_futex, state, FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, nullptr, nullptr, 0);
+#endif
+}
+}  // namespace
+
+Event::Event() : Event(false, false) {}
+
+Event::Event(bool manual_reset, bool initially_signaled)
+    : is_manual_reset_(manual_reset), state_(initially_signaled ? kSignaled : kUnsignaled) {}
+
+Event::~Event() = default;
+
 void Event::Set() {
-  SetEvent(event_handle_);
+  // Wakes one sleeper of an auto-reset event: the one that takes the signal
+  // leaves kSleepers behind, so the next Set() wakes another. Once the signal
+  // is stored a waiter may return and destroy the event, so only the address
+  // of the state word is used after that; a stray wake is harmless.
+  const bool all = is_manual_reset_;
+  if (state_.exchange(kSignaled, std::memory_order_acq_rel) == kSleepers)
+    WakeSleepers(&state_, all);
 }
 
 void Event::Reset() {
-  ResetEvent(event_handle_);
+  uint32_t expected = kSignaled;
+  state_.compare_exchange_strong(expected, kUnsignaled, std::memory_order_relaxed);
+}
+
+bool Event::TryConsume(bool slept) {
+  if (is_manual_reset_)
+    return state_.load(std::memory_order_acquire) == kSignaled;
+  uint32_t expected = kSignaled;
+  return state_.compare_exchange_strong(expected, slept ? kSleepers : kUnsignaled, std::memory_order_acquire,
+                                        std::memory_order_relaxed);
 }
 
-bool Event::Wait(const int give_up_after_ms, int /*warn_after_ms*/) {
-  const DWORD ms = give_up_after_ms == kForever ? INFINITE : give_up_after_ms;
-  return (WaitForSingleObject(event_handle_, ms) == WAIT_OBJECT_0);
+// Spinning only pays off when the thread that will call Set() can run at
+// the same time.
+bool Event::Spin() {
+  static const bool kMultiCore = std::thread::hardware_concurrency() > 1;
+  if (!kMultiCore)
+    return false;
+  const int estimate = spin_estimate_.load(std::memory_order_relaxed);
+  const int limit = std::min(kMaxSpins, 2 * estimate + kMinSpins);
+  for (int i = 0; i < limit; ++i) {
+    CpuRelax();
+    if (state_.load(std::memory_order_relaxed) == kSignaled && TryConsume(/*slept=*/false)) {
+      spin_estimate_.store(estimate + (i - estimate) / 8, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  spin_estimate_.store(estimate / 2, std::memory_order_relaxed);
+  return false;
 }
+
+bool Event::Wait(const int give_up_after_ms, int warn_after_ms) {
+  if (TryConsume(/*slept=*/false))
+    return true;
+  if (give_up_after_ms == 0)
+    return false;
+  if (Spin())
+    return true;
+
+  const int64_t start_us = TimeMicros();
+  const int64_t give_up_us =
+      give_up_after_ms == kForever ? -1 : start_us + int64_t{give_up_after_ms} * 1000;
+  int64_t warn_us =
+      warn_after_ms == kForever || (give_up_after_ms != kForever && warn_after_ms >= give_up_after_ms)
+          ? -1
+          : start_us + int64_t{warn_after_ms} * 1000;
+  bool slept = false;
+  while (true) {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    if (state == kSignaled) {
+      if (TryConsume(slept))
+        return true;
+      continue;
+    }
+    if (state == kUnsignaled &&
+        !state_.compare_exchange_weak(state, kSleepers, std::memory_order_relaxed))
+      continue;
+    slept = true;
+    const int64_t now_us = TimeMicros();
+    if (give_up_us >= 0 && now_us >= give_up_us)
+      return false;
+    if (warn_us >= 0 && now_us >= warn_us) {
+      fprintf(stderr, "rtc::Event::Wait: still waiting after %d ms\n", warn_after_ms);
+      warn_us = -1;
+    }
+    int64_t until_us = give_up_us;
+    if (warn_us >= 0 && (until_us < 0 || warn_us < until_us))
+      until_us = warn_us;
+    SleepWhile(&state_, kSleepers, until_us < 0 ? -1 : until_us - now_us);
+  }
+}
+
 }  // namespace rtc
@@ -11,10 +11,16 @@
 #ifndef RTC_BASE_EVENT_H_
 #define RTC_BASE_EVENT_H_
 
-#include <windows.h>
+#include <stdint.h>
+
+#include <atomic>
 
 namespace rtc {
 
+// Set() and a Wait() that finds the event signaled stay in user space. A
+// waiter spins briefly, adapting to how long recent waits took, before it
+// sleeps on the state word (futex on Linux, WaitOnAddress on Windows); Set()
+// only enters the kernel when someone sleeps.
 class Event {
  public:
   static const int kForever = -1;
@@ -26,13 +32,25 @@ class Event {
 
   void Set();
   void Reset();
+  // Returns false if the event was not signaled within `give_up_after_ms`.
+  // A wait still blocked after `warn_after_ms` reports it on stderr, once,
+  // and goes on waiting.
   bool Wait(int give_up_after_ms, int warn_after_ms);
   bool Wait(int give_up_after_ms) {
     return Wait(give_up_after_ms,
                 give_up_after_ms == kForever ? 3000 : kForever);
   }
  private:
-  HANDLE event_handle_;
+  // `slept` is set once the caller has marked the state as having sleepers;
+  // consuming the signal then keeps that mark for the others.
+  bool TryConsume(bool slept);
+  bool Spin();
+
+  const bool is_manual_reset_;
+  // kUnsignaled, kSignaled or kSleepers (unsignaled, waiters may sleep).
+  std::atomic<uint32_t> state_;
+  // Spin iterations recent successful spins took; a failed spin halves it.
+  std::atomic<int> spin_estimate_{0};
 };
 
 class ScopedAllowBaseSyncPrimitives {
@@ -0,0 +1,48 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "fd_watch_set.h"
+
+#include <utility>
+
+namespace webrtc {
+
+bool FdWatchSet::Add(NativeFd fd, int events, absl::AnyInvocable<void(int events)> callback) {
+  std::unique_ptr<Watch>& watch = watches_[fd];
+  if (watch)
+    return false;
+  watch.reset(new Watch{events, std::move(callback)});
+  return true;
+}
+
+bool FdWatchSet::Remove(NativeFd fd) {
+  auto it = watches_.find(fd);
+  if (it == watches_.end())
+    return false;
+  if (it->second.get() == running_)
+    removed_ = std::move(it->second);
+  watches_.erase(it);
+  return true;
+}
+
+void FdWatchSet::Dispatch(NativeFd fd, int events) {
+  auto it = watches_.find(fd);
+  if (it == watches_.end())
+    return;
+  Watch* watch = it->second.get();
+  events &= watch->events;
+  if (events == 0)
+    return;
+  running_ = watch;
+  watch->callback(events);
+  running_ = nullptr;
+  removed_ = nullptr;
+}
+
+}  // namespace webrtc
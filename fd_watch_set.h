@@ -0,0 +1,60 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_FD_WATCH_SET_H_
+#define RTC_BASE_FD_WATCH_SET_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <unordered_map>
+
+#include "absl/functional/any_invocable.h"
+#include "task_queue_base.h"
+
+namespace webrtc {
+
+// The descriptors a queue watches, see TaskQueueBase::RegisterFd(). The queue
+// waits on them; FdWatchSet keeps the callbacks and makes it safe for a
+// callback to unregister any descriptor, its own included. Not thread safe,
+// all calls are made on the queue thread.
+class FdWatchSet {
+ public:
+  using NativeFd = TaskQueueBase::NativeFd;
+
+  FdWatchSet() = default;
+  FdWatchSet(const FdWatchSet&) = delete;
+  FdWatchSet& operator=(const FdWatchSet&) = delete;
+
+  // Returns false if `fd` is already watched.
+  bool Add(NativeFd fd, int events, absl::AnyInvocable<void(int events)> callback);
+  // Returns false if `fd` is not watched. The callback is destroyed right
+  // away, or once it returns if it is running.
+  bool Remove(NativeFd fd);
+  // Runs the callback of `fd` with those of `events` it watches for. Does
+  // nothing if `fd` was removed since the queue saw it ready.
+  void Dispatch(NativeFd fd, int events);
+  bool empty() const { return watches_.empty(); }
+  size_t size() const { return watches_.size(); }
+
+ private:
+  struct Watch {
+    int events;
+    absl::AnyInvocable<void(int events)> callback;
+  };
+
+  std::unordered_map<NativeFd, std::unique_ptr<Watch>> watches_;
+  // The watch whose callback is running, and the same watch once it has been
+  // removed by that callback.
+  Watch* running_ = nullptr;
+  std::unique_ptr<Watch> removed_;
+};
+
+}  // namespace webrtc
+#endif  // RTC_BASE_FD_WATCH_SET_H_
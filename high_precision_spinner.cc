@@ -0,0 +1,68 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "high_precision_spinner.h"
+
+#include <algorithm>
+
+namespace webrtc {
+namespace {
+
+constexpr int kMaxCreditGuards = 4;
+
+}  // namespace
+
+HighPrecisionSpinner::HighPrecisionSpinner(TimeDelta guard, double cpu_budget)
+  : guard_(guard),
+    cpu_budget_(std::min(std::max(cpu_budget, 0.0), 1.0)),
+    credit_us_(static_cast<double>(guard.us() * kMaxCreditGuards)),
+    last_refill_us_(rtc::TimeMicros()) {}
+
+void HighPrecisionSpinner::AddDeadline(Timestamp due_time) {
+  if (enabled())
+    deadlines_.push(due_time.us());
+}
+
+Timestamp HighPrecisionSpinner::TimerTime(Timestamp now, Timestamp wakeup) {
+  if (!enabled())
+    return wakeup;
+  Refill(now);
+  DropPassed(now);
+  if (deadlines_.empty() || credit_us_ < guard_.us())
+    return wakeup;
+  return std::min(wakeup, Timestamp::Micros(deadlines_.top()) - guard_);
+}
+
+void HighPrecisionSpinner::Refill(Timestamp now) {
+  credit_us_ += (now.us() - last_refill_us_) * cpu_budget_ - spent_us_;
+  credit_us_ = std::min(credit_us_, static_cast<double>(guard_.us() * kMaxCreditGuards));
+  spent_us_ = 0;
+  last_refill_us_ = now.us();
+}
+
+void HighPrecisionSpinner::DropPassed(Timestamp now) {
+  while (!deadlines_.empty() && deadlines_.top() <= now.us())
+    deadlines_.pop();
+}
+
+absl::optional<Timestamp> HighPrecisionSpinner::SpinDeadline(Timestamp now) {
+  if (!enabled())
+    return absl::nullopt;
+  Refill(now);
+  DropPassed(now);
+  if (deadlines_.empty())
+    return absl::nullopt;
+  const Timestamp deadline = Timestamp::Micros(deadlines_.top());
+  const TimeDelta remaining = deadline - now;
+  if (remaining > guard_ || credit_us_ < remaining.us())
+    return absl::nullopt;
+  return deadline;
+}
+
+}  // namespace webrtc
@@ -0,0 +1,87 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_HIGH_PRECISION_SPINNER_H_
+#define RTC_BASE_HIGH_PRECISION_SPINNER_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "time_delta.h"
+#include "time_utils.h"
+#include "timestamp.h"
+
+namespace webrtc {
+
+// Sleep-then-spin support for high precision delayed tasks. The queue thread
+// arms its OS timer `guard` ahead of the earliest high precision deadline and
+// yields in a loop for the rest, which takes OS timer overshoot out of the
+// task's lateness. Spinning is paid for from a CPU budget that refills at
+// `cpu_budget` seconds per second of wall time; when it runs dry the queue
+// falls back to sleeping until the deadline. Used on the queue thread only.
+class HighPrecisionSpinner {
+ public:
+  // A zero `guard` disables spinning.
+  HighPrecisionSpinner(TimeDelta guard, double cpu_budget);
+
+  bool enabled() const { return guard_ > TimeDelta::Zero(); }
+  // Records the deadline of a high precision task filed in the queue's store.
+  void AddDeadline(Timestamp due_time);
+  // Time to arm the OS timer for when the store's next wakeup is `wakeup`:
+  // `guard` ahead of the earliest high precision deadline if the budget can
+  // pay for the spin, otherwise `wakeup`.
+  Timestamp TimerTime(Timestamp now, Timestamp wakeup);
+  // Called after the OS timer fired. If a high precision deadline is less than
+  // `guard` away and affordable, yields until it has passed or `interrupted`
+  // returns true, and returns true.
+  template <typename Interrupted>
+  bool SpinToDeadline(Interrupted interrupted) {
+    absl::optional<Timestamp> deadline = SpinDeadline(rtc::CurrentTimestamp());
+    if (!deadline)
+      return false;
+    const int64_t start_us = rtc::TimeMicros();
+    int64_t now_us = start_us;
+    while (now_us < deadline->us() && !interrupted()) {
+      std::this_thread::yield();
+      now_us = rtc::TimeMicros();
+    }
+    OnSpun(TimeDelta::Micros(now_us - start_us));
+    return true;
+  }
+  // The two halves of SpinToDeadline(): the deadline to spin to, if a high
+  // precision deadline is less than `guard` after `now` and the budget can
+  // pay for it, and charging the time actually spun to the budget.
+  absl::optional<Timestamp> SpinDeadline(Timestamp now);
+  void OnSpun(TimeDelta spun) { spent_us_ += spun.us(); }
+
+ private:
+  void Refill(Timestamp now);
+  // Drops deadlines at or before `now`; their tasks are due and no longer
+  // need the spinner.
+  void DropPassed(Timestamp now);
+
+  const TimeDelta guard_;
+  const double cpu_budget_;
+  // Budget in microseconds of spinning. Capped at a few guard intervals so
+  // that an idle queue cannot save up for a long burst.
+  double credit_us_;
+  int64_t spent_us_ = 0;
+  int64_t last_refill_us_;
+  // Min-heap of high precision deadlines. Cancelled tasks leave their
+  // deadline behind; at worst it costs one spin that finds nothing to run.
+  std::priority_queue<int64_t, std::vector<int64_t>, std::greater<int64_t>> deadlines_;
+};
+
+}  // namespace webrtc
+#endif  // RTC_BASE_HIGH_PRECISION_SPINNER_H_
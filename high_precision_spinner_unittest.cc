@@ -0,0 +1,114 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "high_precision_spinner.h"
+
+#include "gtest/gtest.h"
+#include "time_delta.h"
+#include "time_utils.h"
+#include "timestamp.h"
+
+namespace webrtc {
+namespace {
+
+constexpr TimeDelta kGuard = TimeDelta::Millis(1);
+
+// Spins one guard interval at a time, each time to a deadline one guard
+// after `*now`, until the budget refuses. Returns the number of spins and
+// leaves `*now` at the refused one.
+int SpinsUntilRefused(HighPrecisionSpinner& spinner, Timestamp* now) {
+  int spins = 0;
+  while (spins < 100) {
+    spinner.AddDeadline(*now + kGuard);
+    if (!spinner.SpinDeadline(*now))
+      break;
+    spinner.OnSpun(kGuard);
+    *now += kGuard;
+    ++spins;
+  }
+  return spins;
+}
+
+TEST(HighPrecisionSpinnerTest, ZeroGuardDisablesSpinning) {
+  HighPrecisionSpinner spinner(TimeDelta::Zero(), 0.25);
+  const Timestamp now = rtc::CurrentTimestamp();
+  EXPECT_FALSE(spinner.enabled());
+  spinner.AddDeadline(now + kGuard);
+  EXPECT_EQ(spinner.TimerTime(now, now + kGuard), now + kGuard);
+  EXPECT_FALSE(spinner.SpinDeadline(now));
+  EXPECT_FALSE(spinner.SpinToDeadline([] { return false; }));
+}
+
+TEST(HighPrecisionSpinnerTest, ArmsTheTimerOneGuardAheadOfTheDeadline) {
+  HighPrecisionSpinner spinner(kGuard, 0.25);
+  const Timestamp now = rtc::CurrentTimestamp();
+  const Timestamp deadline = now + TimeDelta::Millis(10);
+  spinner.AddDeadline(deadline);
+  EXPECT_EQ(spinner.TimerTime(now, deadline), deadline - kGuard);
+  // An earlier wakeup of the queue's store comes first.
+  EXPECT_EQ(spinner.TimerTime(now, now + TimeDelta::Millis(5)), now + TimeDelta::Millis(5));
+  // Too far ahead to spin for yet.
+  EXPECT_FALSE(spinner.SpinDeadline(deadline - kGuard - TimeDelta::Micros(1)));
+  EXPECT_EQ(spinner.SpinDeadline(deadline - kGuard), deadline);
+  // Passed deadlines are dropped.
+  EXPECT_FALSE(spinner.SpinDeadline(deadline));
+  EXPECT_EQ(spinner.TimerTime(deadline, deadline + TimeDelta::Millis(50)), deadline + TimeDelta::Millis(50));
+}
+
+// The credit starts at four guards and refills at a quarter of the wall
+// time: every 1 ms spin costs 750 us net, so five fit before it runs dry.
+TEST(HighPrecisionSpinnerTest, RefusesToSpinOnceTheCreditRunsOut) {
+  HighPrecisionSpinner spinner(kGuard, 0.25);
+  Timestamp now = rtc::CurrentTimestamp();
+  EXPECT_EQ(SpinsUntilRefused(spinner, &now), 5);
+  // 250 us of credit left; the timer is armed for the deadline itself.
+  const Timestamp deadline = now + TimeDelta::Millis(10);
+  spinner.AddDeadline(deadline);
+  EXPECT_EQ(spinner.TimerTime(now, deadline), deadline);
+  // The missing 750 us take 3 ms of wall time to refill.
+  EXPECT_EQ(spinner.TimerTime(now + TimeDelta::Micros(2999), deadline), deadline);
+  EXPECT_EQ(spinner.TimerTime(now + TimeDelta::Millis(3), deadline), deadline - kGuard);
+}
+
+TEST(HighPrecisionSpinnerTest, IdleTimeRefillsTheCreditUpToItsCap) {
+  HighPrecisionSpinner spinner(kGuard, 0.25);
+  Timestamp now = rtc::CurrentTimestamp();
+  EXPECT_EQ(SpinsUntilRefused(spinner, &now), 5);
+  // An hour without spinning buys no more than a full credit.
+  now += TimeDelta::Seconds(3600);
+  EXPECT_EQ(SpinsUntilRefused(spinner, &now), 5);
+}
+
+TEST(HighPrecisionSpinnerTest, ZeroBudgetNeverRefills) {
+  HighPrecisionSpinner spinner(kGuard, 0.0);
+  Timestamp now = rtc::CurrentTimestamp();
+  EXPECT_EQ(SpinsUntilRefused(spinner, &now), 4);
+  now += TimeDelta::Seconds(3600);
+  EXPECT_EQ(SpinsUntilRefused(spinner, &now), 0);
+}
+
+TEST(HighPrecisionSpinnerTest, SpinsUntilTheDeadline) {
+  HighPrecisionSpinner spinner(kGuard, 0.25);
+  const Timestamp deadline = rtc::CurrentTimestamp() + TimeDelta::Micros(500);
+  spinner.AddDeadline(deadline);
+  EXPECT_TRUE(spinner.SpinToDeadline([] { return false; }));
+  EXPECT_GE(rtc::CurrentTimestamp(), deadline);
+}
+
+TEST(HighPrecisionSpinnerTest, InterruptedSpinReturnsEarly) {
+  HighPrecisionSpinner spinner(kGuard, 0.25);
+  const Timestamp deadline = rtc::CurrentTimestamp() + TimeDelta::Micros(900);
+  spinner.AddDeadline(deadline);
+  int polls = 0;
+  EXPECT_TRUE(spinner.SpinToDeadline([&polls] { return ++polls == 1; }));
+  EXPECT_EQ(polls, 1);
+}
+
+}  // namespace
+}  // namespace webrtc
@@ -0,0 +1,28 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "inline_task.h"
+
+#include <atomic>
+
+namespace webrtc {
+namespace {
+std::atomic<uint64_t> heap_spills{0};
+}  // namespace
+
+uint64_t InlineTaskHeapSpillCount() {
+  return heap_spills.load(std::memory_order_relaxed);
+}
+
+namespace inline_task_internal {
+void RecordHeapSpill() {
+  heap_spills.fetch_add(1, std::memory_order_relaxed);
+}
+}  // namespace inline_task_internal
+}  // namespace webrtc
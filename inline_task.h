@@ -0,0 +1,148 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef API_TASK_QUEUE_INLINE_TASK_H_
+#define API_TASK_QUEUE_INLINE_TASK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Bytes of closure state a queued task stores without allocating. Captures
+// that do not fit still work but are moved to the heap ("spill"); raise this
+// if InlineTaskHeapSpillCount() shows that typical tasks do not fit.
+#ifndef WEBRTC_TASK_INLINE_CAPACITY
+#define WEBRTC_TASK_INLINE_CAPACITY 64
+#endif
+
+namespace webrtc {
+
+// Number of InlineTask closures, of any capacity, that were too large or too
+// strictly aligned for their inline buffer and were heap allocated instead.
+uint64_t InlineTaskHeapSpillCount();
+
+namespace inline_task_internal {
+void RecordHeapSpill();
+}  // namespace inline_task_internal
+
+// Move-only, type erased `void()` closure that keeps up to `kCapacity` bytes
+// of captured state in an inline buffer. Unlike absl::AnyInvocable, whose
+// buffer only holds a couple of pointers, a typical lambda that captures a
+// few pointers and values can travel through the queue without touching
+// malloc. Like AnyInvocable<void() &&> it is invoked at most once, as an
+// rvalue.
+template <size_t kCapacity>
+class InlineTask {
+ public:
+  static_assert(kCapacity >= sizeof(void*), "the buffer must hold a pointer");
+
+  InlineTask() = default;
+  InlineTask(std::nullptr_t) {}
+  template <typename Closure,
+            typename F = typename std::decay<Closure>::type,
+            typename = typename std::enable_if<!std::is_same<F, InlineTask>::value &&
+                                               std::is_invocable<F>::value>::type>
+  InlineTask(Closure&& closure) {
+    if constexpr (kFitsInline<F>) {
+      new (storage_) F(std::forward<Closure>(closure));
+      ops_ = &InlineOps<F>::kOps;
+    } else {
+      *reinterpret_cast<F**>(storage_) = new F(std::forward<Closure>(closure));
+      ops_ = &HeapOps<F>::kOps;
+      inline_task_internal::RecordHeapSpill();
+    }
+  }
+  InlineTask(InlineTask&& other) noexcept { MoveFrom(other); }
+  InlineTask& operator=(InlineTask&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      MoveFrom(other);
+    }
+    return *this;
+  }
+  InlineTask& operator=(std::nullptr_t) {
+    Reset();
+    return *this;
+  }
+  InlineTask(const InlineTask&) = delete;
+  InlineTask& operator=(const InlineTask&) = delete;
+  ~InlineTask() { Reset(); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+  // False if the closure spilled to the heap.
+  bool is_inline() const { return ops_ == nullptr || ops_->is_inline; }
+  // Bytes the closure took on the heap; zero when stored inline.
+  size_t heap_size() const { return ops_ ? ops_->heap_size : 0; }
+
+  void operator()() && { ops_->invoke(storage_); }
+
+ private:
+  struct Ops {
+    void (*invoke)(void* storage);
+    // Move-constructs the closure into `to` and destroys the one in `from`.
+    void (*relocate)(void* from, void* to);
+    void (*destroy)(void* storage);
+    bool is_inline;
+    size_t heap_size;
+  };
+
+  template <typename F>
+  static constexpr bool kFitsInline = sizeof(F) <= kCapacity &&
+                                      alignof(F) <= alignof(std::max_align_t) &&
+                                      std::is_nothrow_move_constructible<F>::value;
+
+  template <typename F>
+  struct InlineOps {
+    static F* Get(void* storage) { return std::launder(reinterpret_cast<F*>(storage)); }
+    static void Invoke(void* storage) { std::move(*Get(storage))(); }
+    static void Relocate(void* from, void* to) {
+      new (to) F(std::move(*Get(from)));
+      Get(from)->~F();
+    }
+    static void Destroy(void* storage) { Get(storage)->~F(); }
+    static constexpr Ops kOps = {&Invoke, &Relocate, &Destroy, true, 0};
+  };
+
+  template <typename F>
+  struct HeapOps {
+    static F*& Get(void* storage) { return *reinterpret_cast<F**>(storage); }
+    static void Invoke(void* storage) { std::move(*Get(storage))(); }
+    static void Relocate(void* from, void* to) { Get(to) = Get(from); }
+    static void Destroy(void* storage) { delete Get(storage); }
+    static constexpr Ops kOps = {&Invoke, &Relocate, &Destroy, false, sizeof(F)};
+  };
+
+  void MoveFrom(InlineTask& other) {
+    if (other.ops_) {
+      other.ops_->relocate(other.storage_, storage_);
+      ops_ = other.ops_;
+      other.ops_ = nullptr;
+    }
+  }
+
+  void Reset() {
+    if (ops_) {
+      ops_->destroy(storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  alignas(std::max_align_t) unsigned char storage_[kCapacity];
+  const Ops* ops_ = nullptr;
+};
+
+// The closure type the task queues store internally.
+using QueuedClosure = InlineTask<WEBRTC_TASK_INLINE_CAPACITY>;
+
+}  // namespace webrtc
+#endif  // API_TASK_QUEUE_INLINE_TASK_H_
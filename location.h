@@ -0,0 +1,39 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_LOCATION_H_
+#define RTC_BASE_LOCATION_H_
+
+namespace webrtc {
+
+// A place in the source, e.g. where a task was posted from. Location::Current()
+// as a default argument captures the caller's location.
+class Location {
+ public:
+  Location() = default;
+  Location(const char* file, int line, const char* function) : file_(file), line_(line), function_(function) {}
+
+  static Location Current(const char* file = __builtin_FILE(),
+                          int line = __builtin_LINE(),
+                          const char* function = __builtin_FUNCTION()) {
+    return Location(file, line, function);
+  }
+
+  const char* file() const { return file_; }
+  int line() const { return line_; }
+  const char* function() const { return function_; }
+
+ private:
+  const char* file_ = "";
+  int line_ = 0;
+  const char* function_ = "";
+};
+
+}  // namespace webrtc
+#endif  // RTC_BASE_LOCATION_H_
@@ -0,0 +1,85 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_MPSC_QUEUE_H_
+#define RTC_BASE_MPSC_QUEUE_H_
+
+#include <stddef.h>
+
+#include <atomic>
+
+namespace webrtc {
+
+constexpr size_t kCacheLineSize = 64;
+
+// Link embedded in every node that is pushed onto an MpscQueue.
+struct MpscNode {
+  MpscNode* mpsc_next = nullptr;
+};
+
+// Intrusive multi-producer/single-consumer queue. Producers push with a
+// single CAS on a shared head; the consumer takes everything that has been
+// pushed with one atomic exchange and gets it back in FIFO order. The queue
+// never allocates: T must derive from MpscNode and the node travels with the
+// task it carries.
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() = default;
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  // Pushes `node` and returns true if the queue was empty before, i.e. only
+  // the producer that makes the queue non-empty needs to wake the consumer.
+  // Safe to call from any thread.
+  bool Push(T* node) { return PushChain(node, node); }
+
+  // Pushes a chain of nodes as one unit, so no other producer's node can land
+  // in the middle of it. The chain is linked newest-to-oldest through
+  // mpsc_next, from `last` (newest) back to `first` (oldest).
+  bool PushChain(T* first, T* last) {
+    MpscNode* head = head_.load(std::memory_order_relaxed);
+    do {
+      static_cast<MpscNode*>(first)->mpsc_next = head;
+    } while (!head_.compare_exchange_weak(head, last, std::memory_order_release,
+                                          std::memory_order_relaxed));
+    return head == nullptr;
+  }
+
+  // Removes every node pushed so far and returns the oldest one; the rest
+  // follow through Next(). Consumer thread only.
+  T* PopAll() {
+    MpscNode* node = head_.exchange(nullptr, std::memory_order_acquire);
+    MpscNode* fifo = nullptr;
+    while (node) {
+      MpscNode* next = node->mpsc_next;
+      node->mpsc_next = fifo;
+      fifo = node;
+      node = next;
+    }
+    return static_cast<T*>(fifo);
+  }
+
+  static T* Next(T* node) {
+    return static_cast<T*>(static_cast<MpscNode*>(node)->mpsc_next);
+  }
+
+  bool empty() const {
+    return head_.load(std::memory_order_relaxed) == nullptr;
+  }
+
+ private:
+  // Producers hammer `head_`; keep it on a line of its own so it does not
+  // false-share with whatever the owner places next to the queue.
+  alignas(kCacheLineSize) std::atomic<MpscNode*> head_{nullptr};
+  char padding_[kCacheLineSize - sizeof(std::atomic<MpscNode*>)];
+};
+
+}  // namespace webrtc
+#endif  // RTC_BASE_MPSC_QUEUE_H_
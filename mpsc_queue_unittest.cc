@@ -0,0 +1,95 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "mpsc_queue.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace webrtc {
+namespace {
+
+struct Node : public MpscNode {
+  Node() = default;
+  Node(int producer, int sequence) : producer(producer), sequence(sequence) {}
+  int producer = 0;
+  int sequence = 0;
+};
+
+std::vector<int> Sequences(Node* node) {
+  std::vector<int> sequences;
+  for (; node != nullptr; node = MpscQueue<Node>::Next(node))
+    sequences.push_back(node->sequence);
+  return sequences;
+}
+
+TEST(MpscQueueTest, PopAllReturnsNodesOldestFirst) {
+  MpscQueue<Node> queue;
+  Node nodes[3] = {{0, 1}, {0, 2}, {0, 3}};
+  EXPECT_TRUE(queue.empty());
+  EXPECT_TRUE(queue.Push(&nodes[0]));
+  EXPECT_FALSE(queue.Push(&nodes[1]));
+  EXPECT_FALSE(queue.Push(&nodes[2]));
+  EXPECT_FALSE(queue.empty());
+  EXPECT_EQ(Sequences(queue.PopAll()), (std::vector<int>{1, 2, 3}));
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.PopAll(), nullptr);
+  EXPECT_TRUE(queue.Push(&nodes[0]));
+}
+
+TEST(MpscQueueTest, PushChainKeepsTheChainTogether) {
+  MpscQueue<Node> queue;
+  Node nodes[4] = {{0, 1}, {0, 2}, {0, 3}, {0, 4}};
+  queue.Push(&nodes[0]);
+  // Linked newest to oldest: 4 -> 3 -> 2.
+  nodes[3].mpsc_next = &nodes[2];
+  nodes[2].mpsc_next = &nodes[1];
+  EXPECT_FALSE(queue.PushChain(&nodes[1], &nodes[3]));
+  EXPECT_EQ(Sequences(queue.PopAll()), (std::vector<int>{1, 2, 3, 4}));
+}
+
+// Every producer's nodes come out in the order it pushed them, however the
+// producers interleave with each other and with the consumer.
+TEST(MpscQueueTest, KeepsFifoOrderPerProducer) {
+  constexpr int kProducers = 4;
+  constexpr int kNodesPerProducer = 20000;
+  MpscQueue<Node> queue;
+  std::vector<std::vector<Node>> nodes(kProducers, std::vector<Node>(kNodesPerProducer));
+  std::atomic<int> started{0};
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&, p] {
+      started.fetch_add(1);
+      while (started.load() < kProducers) {
+      }
+      for (int i = 0; i < kNodesPerProducer; ++i) {
+        nodes[p][i] = Node(p, i);
+        queue.Push(&nodes[p][i]);
+      }
+    });
+  }
+  std::vector<int> next(kProducers, 0);
+  int received = 0;
+  while (received < kProducers * kNodesPerProducer) {
+    for (Node* node = queue.PopAll(); node != nullptr; node = MpscQueue<Node>::Next(node)) {
+      EXPECT_EQ(node->sequence, next[node->producer]) << "producer " << node->producer;
+      next[node->producer] = node->sequence + 1;
+      ++received;
+    }
+  }
+  for (std::thread& producer : producers)
+    producer.join();
+  EXPECT_TRUE(queue.empty());
+}
+
+}  // namespace
+}  // namespace webrtc
@@ -10,12 +10,27 @@
 
 #include "platform_thread.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+
 #include <algorithm>
 #include <memory>
 
+#if !defined(_WIN32)
+#include <limits.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
 namespace rtc {
 namespace {
 
+#if defined(_WIN32)
 int Win32PriorityFromThreadPriority(ThreadPriority priority) {
   switch (priority) {
     case ThreadPriority::kLow:
@@ -34,6 +49,62 @@ bool SetPriority(ThreadPriority priority) {
   return SetThreadPriority(GetCurrentThread(), Win32PriorityFromThreadPriority(priority)) != FALSE;
 }
 
+int Win32PriorityFromNice(int nice) {
+  if (nice <= -15)
+    return THREAD_PRIORITY_HIGHEST;
+  if (nice < 0)
+    return THREAD_PRIORITY_ABOVE_NORMAL;
+  if (nice == 0)
+    return THREAD_PRIORITY_NORMAL;
+  if (nice < 15)
+    return THREAD_PRIORITY_BELOW_NORMAL;
+  return THREAD_PRIORITY_LOWEST;
+}
+
+bool SetScheduling(const ThreadAttributes& attributes) {
+  switch (attributes.scheduling_policy) {
+    case ThreadSchedulingPolicy::kDefault:
+      return SetPriority(attributes.priority);
+    case ThreadSchedulingPolicy::kNice:
+      return SetThreadPriority(GetCurrentThread(), Win32PriorityFromNice(attributes.scheduling_priority)) != FALSE;
+    case ThreadSchedulingPolicy::kFifo:
+    case ThreadSchedulingPolicy::kRoundRobin:
+      return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != FALSE;
+  }
+  return false;
+}
+
+// CPU indices are taken to be in processor group 0, as for
+// SetThreadAffinityMask().
+bool SetAffinity(const ThreadAttributes& attributes) {
+  GROUP_AFFINITY affinity = {};
+  if (attributes.numa_node >= 0 &&
+      !GetNumaNodeProcessorMaskEx(static_cast<USHORT>(attributes.numa_node), &affinity))
+    affinity.Mask = 0;
+  KAFFINITY cpus = 0;
+  for (int cpu : attributes.cpu_set) {
+    if (cpu >= 0 && cpu < static_cast<int>(8 * sizeof(KAFFINITY)))
+      cpus |= KAFFINITY{1} << cpu;
+  }
+  if (cpus != 0) {
+    // The explicit set wins over a node it does not overlap.
+    if (affinity.Group == 0 && (affinity.Mask & cpus) != 0) {
+      affinity.Mask &= cpus;
+    } else {
+      affinity.Group = 0;
+      affinity.Mask = cpus;
+    }
+  }
+  if (affinity.Mask == 0)
+    return true;
+  return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != FALSE;
+}
+
+void ApplyAttributes(const ThreadAttributes& attributes) {
+  SetAffinity(attributes);
+  SetScheduling(attributes);
+}
+
 DWORD WINAPI RunPlatformThread(void* param) {
   ::SetLastError(ERROR_SUCCESS);
   auto function = static_cast<std::function<void()>*>(param);
@@ -41,6 +112,138 @@ DWORD WINAPI RunPlatformThread(void* param) {
   delete function;
   return 0;
 }
+#else
+bool SetPriority(ThreadPriority priority) {
+  // Normal and low priority threads stay on the default time-sharing policy;
+  // only the elevated priorities ask for a real-time class. The call fails
+  // without CAP_SYS_NICE, in which case the thread keeps running as is.
+  if (priority != ThreadPriority::kHigh && priority != ThreadPriority::kRealtime)
+    return true;
+  const int policy = SCHED_FIFO;
+  const int min_prio = sched_get_priority_min(policy);
+  const int max_prio = sched_get_priority_max(policy);
+  if (min_prio == -1 || max_prio == -1)
+    return false;
+  if (max_prio - min_prio <= 2)
+    return false;
+  sched_param param;
+  const int top_prio = max_prio - 1;
+  const int low_prio = min_prio + 1;
+  param.sched_priority = priority == ThreadPriority::kRealtime
+                             ? top_prio
+                             : std::max(top_prio - 2, low_prio);
+  return pthread_setschedparam(pthread_self(), policy, &param) == 0;
+}
+
+bool SetScheduling(const ThreadAttributes& attributes) {
+  switch (attributes.scheduling_policy) {
+    case ThreadSchedulingPolicy::kDefault:
+      return SetPriority(attributes.priority);
+    case ThreadSchedulingPolicy::kNice:
+#if defined(__linux__)
+      // Linux keeps a nice value per thread, addressed by its tid.
+      return setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), attributes.scheduling_priority) == 0;
+#else
+      return false;
+#endif
+    case ThreadSchedulingPolicy::kFifo:
+    case ThreadSchedulingPolicy::kRoundRobin: {
+      const int policy = attributes.scheduling_policy == ThreadSchedulingPolicy::kFifo ? SCHED_FIFO : SCHED_RR;
+      const int min_prio = sched_get_priority_min(policy);
+      const int max_prio = sched_get_priority_max(policy);
+      if (min_prio == -1 || max_prio == -1)
+        return false;
+      sched_param param;
+      param.sched_priority = std::clamp(attributes.scheduling_priority, min_prio, max_prio);
+      return pthread_setschedparam(pthread_self(), policy, &param) == 0;
+    }
+  }
+  return false;
+}
+
+#if defined(__linux__)
+// CPUs of a NUMA node as listed in sysfs, e.g. "0-3,8-11"; empty if the node
+// does not exist.
+std::vector<int> NumaNodeCpus(int node) {
+  std::vector<int> cpus;
+  char path[64];
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+  FILE* file = fopen(path, "r");
+  if (!file)
+    return cpus;
+  char line[1024];
+  if (fgets(line, sizeof(line), file)) {
+    char* p = line;
+    while (*p >= '0' && *p <= '9') {
+      const long first = strtol(p, &p, 10);
+      long last = first;
+      if (*p == '-')
+        last = strtol(p + 1, &p, 10);
+      for (long cpu = first; cpu <= last; ++cpu)
+        cpus.push_back(static_cast<int>(cpu));
+      if (*p == ',')
+        ++p;
+    }
+  }
+  fclose(file);
+  return cpus;
+}
+
+bool SetAffinity(const ThreadAttributes& attributes) {
+  std::vector<int> cpus = attributes.cpu_set;
+  if (attributes.numa_node >= 0) {
+    std::vector<int> node_cpus = NumaNodeCpus(attributes.numa_node);
+    std::vector<int> both;
+    for (int cpu : cpus) {
+      if (std::find(node_cpus.begin(), node_cpus.end(), cpu) != node_cpus.end())
+        both.push_back(cpu);
+    }
+    // The explicit set wins over a node it does not overlap.
+    if (cpus.empty())
+      cpus = std::move(node_cpus);
+    else if (!both.empty())
+      cpus = std::move(both);
+  }
+  if (cpus.empty())
+    return true;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// Prefers the node for the thread's allocations; set_mempolicy() is called
+// directly so that libnuma is not needed.
+bool SetNumaMemoryPolicy(int node) {
+  constexpr int kMpolPreferred = 1;  // From <linux/mempolicy.h>.
+  constexpr int kBitsPerLong = 8 * sizeof(unsigned long);
+  if (node < 0 || node >= kBitsPerLong)
+    return false;
+  const unsigned long mask = 1UL << node;
+  // The kernel reads one bit less than `maxnode`.
+  return syscall(SYS_set_mempolicy, kMpolPreferred, &mask, kBitsPerLong + 1) == 0;
+}
+#endif
+
+void ApplyAttributes(const ThreadAttributes& attributes) {
+#if defined(__linux__)
+  SetAffinity(attributes);
+  if (attributes.numa_node >= 0)
+    SetNumaMemoryPolicy(attributes.numa_node);
+#endif
+  SetScheduling(attributes);
+}
+
+void* RunPlatformThread(void* param) {
+  auto function = static_cast<std::function<void()>*>(param);
+  (*function)();
+  delete function;
+  return nullptr;
+}
+#endif
 }  // namespace
 
 PlatformThread::PlatformThread(Handle handle, bool joinable)
@@ -75,16 +278,23 @@ absl::optional<PlatformThread::Handle> PlatformThread::GetHandle() const {
   return handle_;
 }
 
+#if defined(_WIN32)
 bool PlatformThread::QueueAPC(PAPCFUNC function, ULONG_PTR data) {
   return handle_.has_value() ? QueueUserAPC(function, *handle_, data) != FALSE : false;
 }
+#endif
 
 void PlatformThread::Finalize() {
   if (!handle_.has_value())
     return;
+#if defined(_WIN32)
   if (joinable_)
     WaitForSingleObject(*handle_, INFINITE);
   CloseHandle(*handle_);
+#else
+  if (joinable_)
+    pthread_join(*handle_, nullptr);
+#endif
   handle_ = absl::nullopt;
 }
 
@@ -92,11 +302,31 @@ PlatformThread PlatformThread::SpawnThread( std::function<void()> thread_functio
   auto start_thread_function_ptr = new std::function<void()>(
     [thread_function = std::move(thread_function), name = std::string(name), attributes] {
         rtc::SetCurrentThreadName(name.c_str());
-        SetPriority(attributes.priority);
+        ApplyAttributes(attributes);
         thread_function();
     });
+  const size_t stack_size = attributes.stack_size != 0 ? attributes.stack_size : 1024 * 1024;
+#if defined(_WIN32)
   DWORD thread_id = 0;
-  PlatformThread::Handle handle = ::CreateThread(nullptr, 1024 * 1024, &RunPlatformThread, start_thread_function_ptr, STACK_SIZE_PARAM_IS_A_RESERVATION, &thread_id);
+  PlatformThread::Handle handle = ::CreateThread(nullptr, stack_size, &RunPlatformThread, start_thread_function_ptr, STACK_SIZE_PARAM_IS_A_RESERVATION, &thread_id);
+  if (handle == nullptr) {
+    fprintf(stderr, "CreateThread for %s failed: %lu\n", std::string(name).c_str(), ::GetLastError());
+    abort();
+  }
+#else
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, std::max<size_t>(stack_size, PTHREAD_STACK_MIN));
+  pthread_attr_setdetachstate(&attr, joinable ? PTHREAD_CREATE_JOINABLE : PTHREAD_CREATE_DETACHED);
+  PlatformThread::Handle handle;
+  const int error = pthread_create(&handle, &attr, &RunPlatformThread, start_thread_function_ptr);
+  pthread_attr_destroy(&attr);
+  // A queue without its thread would silently never run a task.
+  if (error != 0) {
+    fprintf(stderr, "pthread_create for %s failed: %s\n", std::string(name).c_str(), strerror(error));
+    abort();
+  }
+#endif
   return PlatformThread(handle, joinable);
 }
 }  // namespace rtc
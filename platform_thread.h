@@ -11,8 +11,12 @@
 #ifndef RTC_BASE_PLATFORM_THREAD_H_
 #define RTC_BASE_PLATFORM_THREAD_H_
 
+#include <stddef.h>
+
 #include <functional>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
@@ -27,18 +31,67 @@ enum class ThreadPriority {
   kRealtime,
 };
 
+// Scheduling class of a thread. kDefault derives it from ThreadPriority. On
+// Windows, which has no such classes, the real-time ones map to
+// THREAD_PRIORITY_TIME_CRITICAL and kNice to the nearest thread priority.
+enum class ThreadSchedulingPolicy {
+  kDefault,
+  // SCHED_OTHER with the given nice value, -20 (highest) to 19.
+  kNice,
+  // SCHED_FIFO or SCHED_RR with the given priority, clamped to the range the
+  // system supports (1 to 99 on Linux).
+  kFifo,
+  kRoundRobin,
+};
+
+// Everything but the priority is best effort: a CPU set or scheduling class
+// the system refuses (e.g. without CAP_SYS_NICE) leaves the thread as if it
+// had not been asked for.
 struct ThreadAttributes {
   ThreadPriority priority = ThreadPriority::kNormal;
+  // CPUs the thread may run on, by index. Empty means any.
+  std::vector<int> cpu_set;
+  // Keeps the thread, and on Linux its memory allocations, on this NUMA node.
+  // Combined with `cpu_set` the thread runs on the CPUs in both; -1 means no
+  // preference.
+  int numa_node = -1;
+  // Overrides `priority` unless kDefault.
+  ThreadSchedulingPolicy scheduling_policy = ThreadSchedulingPolicy::kDefault;
+  // The nice value or real-time priority, depending on `scheduling_policy`.
+  int scheduling_priority = 0;
+  // Stack size in bytes; 0 means 1 MB. Raised to the system minimum.
+  size_t stack_size = 0;
   ThreadAttributes& SetPriority(ThreadPriority priority_param) {
     priority = priority_param;
     return *this;
   }
+  ThreadAttributes& SetCpuSet(std::vector<int> cpu_set_param) {
+    cpu_set = std::move(cpu_set_param);
+    return *this;
+  }
+  ThreadAttributes& SetNumaNode(int numa_node_param) {
+    numa_node = numa_node_param;
+    return *this;
+  }
+  ThreadAttributes& SetSchedulingPolicy(ThreadSchedulingPolicy policy, int priority_param) {
+    scheduling_policy = policy;
+    scheduling_priority = priority_param;
+    return *this;
+  }
+  ThreadAttributes& SetStackSize(size_t stack_size_param) {
+    stack_size = stack_size_param;
+    return *this;
+  }
 };
 
 // Represents a simple worker thread.
 class PlatformThread final {
  public:
+#if defined(_WIN32)
   using Handle = HANDLE;
+#else
+  using Handle = pthread_t;
+#endif
   PlatformThread() = default;
   PlatformThread(PlatformThread&& rhs);
   PlatformThread(const PlatformThread&) = delete;
@@ -50,7 +103,9 @@ class PlatformThread final {
   static PlatformThread SpawnJoinable(std::function<void()> thread_function, absl::string_view name, ThreadAttributes attributes = ThreadAttributes());
   static PlatformThread SpawnDetached(std::function<void()> thread_function, absl::string_view name, ThreadAttributes attributes = ThreadAttributes());
   absl::optional<Handle> GetHandle() const;
+#if defined(_WIN32)
   bool QueueAPC(PAPCFUNC apc_function, ULONG_PTR data);
+#endif
  private:
   PlatformThread(Handle handle, bool joinable);
   static PlatformThread SpawnThread(std::function<void()> thread_function, absl::string_view name, ThreadAttributes attributes, bool joinable);
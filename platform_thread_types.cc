@@ -10,23 +10,46 @@
 
 #include "platform_thread_types.h"
 #include "arraysize.h"
+#include "task_trace.h"
 
+#if defined(_WIN32)
 typedef HRESULT(WINAPI* RTC_SetThreadDescription)(HANDLE hThread, PCWSTR lpThreadDescription);
+#else
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace rtc {
 
 PlatformThreadId CurrentThreadId() {
+#if defined(_WIN32)
   return GetCurrentThreadId();
+#else
+  return static_cast<pid_t>(syscall(__NR_gettid));
+#endif
 }
 
 PlatformThreadRef CurrentThreadRef() {
+#if defined(_WIN32)
   return GetCurrentThreadId();
+#else
+  return pthread_self();
+#endif
 }
 
 bool IsThreadRefEqual(const PlatformThreadRef& a, const PlatformThreadRef& b) {
+#if defined(_WIN32)
   return a == b;
+#else
+  return pthread_equal(a, b);
+#endif
 }
 
+#if defined(_WIN32)
+
 void SetCurrentThreadName(const char* name) {
+  webrtc::TaskTrace::OnThreadNamed(name);
   // The SetThreadDescription API works even if no debugger is attached.
   // The names set with this API also show up in ETW traces. Very handy.
   static auto set_thread_description_func =
@@ -65,5 +88,12 @@ void SetCurrentThreadName(const char* name) {
   }
 #pragma warning(pop)
 }
+#else
+void SetCurrentThreadName(const char* name) {
+  webrtc::TaskTrace::OnThreadNamed(name);
+  // The kernel truncates the name to 15 characters plus terminator.
+  prctl(PR_SET_NAME, reinterpret_cast<unsigned long>(name), 0, 0, 0);  // NOLINT
+}
+#endif
 
 }  // namespace rtc
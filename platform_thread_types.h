@@ -11,13 +11,23 @@
 #ifndef RTC_BASE_PLATFORM_THREAD_TYPES_H_
 #define RTC_BASE_PLATFORM_THREAD_TYPES_H_
 
+#if defined(_WIN32)
 #include <winsock2.h>
 #include <windows.h>
+#else
+#include <pthread.h>
+#include <sys/types.h>
+#endif
 
 namespace rtc {
 
+#if defined(_WIN32)
 typedef DWORD PlatformThreadId;
 typedef DWORD PlatformThreadRef;
+#else
+typedef pid_t PlatformThreadId;
+typedef pthread_t PlatformThreadRef;
+#endif
 
 PlatformThreadId CurrentThreadId();
 
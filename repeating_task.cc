@@ -0,0 +1,102 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "repeating_task.h"
+
+#include <utility>
+
+#include "task_queue_limiter.h"
+#include "time_utils.h"
+
+namespace webrtc {
+
+RepeatingTaskState::RepeatingTaskState(TaskQueueBase* task_queue,
+                                       absl::AnyInvocable<TimeDelta()> closure,
+                                       TaskQueueBase::DelayPrecision precision,
+                                       std::function<Timestamp()> clock)
+  : task_queue_(task_queue), closure_(std::move(closure)), precision_(precision), clock_(std::move(clock)) {}
+
+Timestamp RepeatingTaskState::Now() const {
+  return clock_ ? clock_() : rtc::CurrentTimestamp();
+}
+
+void RepeatingTaskState::Schedule(rtc::scoped_refptr<RepeatingTaskState> self, Timestamp first_run) {
+  next_run_ = first_run;
+  PostRun(std::move(self), first_run - Now());
+}
+
+void RepeatingTaskState::PostRun(rtc::scoped_refptr<RepeatingTaskState> self, TimeDelta delay) {
+  // Moving the reference along keeps the reference count untouched.
+  auto run = [self = std::move(self)]() mutable {
+    RepeatingTaskState* state = self.get();
+    state->Run(std::move(self));
+  };
+  // A dropped run would stop the task for good.
+  TaskQueueLimiter::MustPost must_post;
+  if (delay <= TimeDelta::Zero())
+    task_queue_->PostTask(std::move(run));
+  else
+    task_queue_->PostDelayedTaskWithPrecision(precision_, std::move(run), delay);
+}
+
+void RepeatingTaskState::Stop() {
+  stopped_ = true;
+  if (!in_closure_)
+    closure_ = nullptr;
+}
+
+void RepeatingTaskState::Run(rtc::scoped_refptr<RepeatingTaskState> self) {
+  if (stopped_)
+    return;
+  in_closure_ = true;
+  const TimeDelta interval = closure_();
+  in_closure_ = false;
+  if (interval.IsPlusInfinity())
+    stopped_ = true;
+  if (stopped_) {
+    closure_ = nullptr;
+    return;
+  }
+  const Timestamp now = Now();
+  next_run_ = next_run_ + interval;
+  if (next_run_ + interval < now)
+    next_run_ = now;
+  PostRun(std::move(self), next_run_ - now);
+}
+
+RepeatingTaskHandle RepeatingTaskHandle::Start(TaskQueueBase* task_queue,
+                                               absl::AnyInvocable<TimeDelta()> closure,
+                                               TaskQueueBase::DelayPrecision precision,
+                                               std::function<Timestamp()> clock) {
+  return DelayedStart(task_queue, TimeDelta::Zero(), std::move(closure), precision, std::move(clock));
+}
+
+RepeatingTaskHandle RepeatingTaskHandle::DelayedStart(TaskQueueBase* task_queue,
+                                                      TimeDelta first_delay,
+                                                      absl::AnyInvocable<TimeDelta()> closure,
+                                                      TaskQueueBase::DelayPrecision precision,
+                                                      std::function<Timestamp()> clock) {
+  rtc::scoped_refptr<RepeatingTaskState> state(
+      new RepeatingTaskState(task_queue, std::move(closure), precision, std::move(clock)));
+  state->Schedule(state, state->Now() + first_delay);
+  return RepeatingTaskHandle(std::move(state));
+}
+
+void RepeatingTaskHandle::Stop() {
+  if (state_) {
+    state_->Stop();
+    state_ = nullptr;
+  }
+}
+
+bool RepeatingTaskHandle::Running() const {
+  return state_ && state_->running();
+}
+
+}  // namespace webrtc
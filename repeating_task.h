@@ -0,0 +1,109 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_REPEATING_TASK_H_
+#define RTC_BASE_REPEATING_TASK_H_
+
+#include <atomic>
+#include <functional>
+
+#include "absl/functional/any_invocable.h"
+#include "scoped_refptr.h"
+#include "task_queue_base.h"
+#include "time_delta.h"
+#include "timestamp.h"
+
+namespace webrtc {
+
+class RepeatingTaskState;
+
+// Runs a closure on a task queue again and again, for periodic work such as
+// stats polling or RTCP. The closure returns the time until its next run, or
+// TimeDelta::PlusInfinity() to stop. Deadlines are absolute: the interval is
+// added to the previous deadline, not to the time the closure returned, so
+// the time the closure and the queue take does not add up to drift. A run
+// that is late by more than its interval moves the schedule to the present
+// instead of catching up with a burst of runs.
+//
+// The task is allocated once. Every period re-posts a pointer-sized closure,
+// which the queues keep inline in their pooled task and timer nodes, so a
+// running task does not allocate.
+class RepeatingTaskHandle {
+ public:
+  RepeatingTaskHandle() = default;
+
+  // Runs `closure` on `task_queue` right away, then as it asks. `clock`
+  // tells the time the deadlines refer to; the default is the monotonic
+  // clock of the real queues, a SimulatedTaskQueueFactory needs its Now().
+  static RepeatingTaskHandle Start(TaskQueueBase* task_queue,
+                                   absl::AnyInvocable<TimeDelta()> closure,
+                                   TaskQueueBase::DelayPrecision precision = TaskQueueBase::DelayPrecision::kLow,
+                                   std::function<Timestamp()> clock = nullptr);
+  // Same, with the first run `first_delay` from now.
+  static RepeatingTaskHandle DelayedStart(TaskQueueBase* task_queue,
+                                          TimeDelta first_delay,
+                                          absl::AnyInvocable<TimeDelta()> closure,
+                                          TaskQueueBase::DelayPrecision precision = TaskQueueBase::DelayPrecision::kLow,
+                                          std::function<Timestamp()> clock = nullptr);
+
+  // Stops the task and destroys the closure. Must be called on the task's
+  // queue, where it costs a few stores; may be called from the closure.
+  void Stop();
+  // True until the task is stopped, by Stop() or by its closure. Must be
+  // called on the task's queue.
+  bool Running() const;
+
+ private:
+  explicit RepeatingTaskHandle(rtc::scoped_refptr<RepeatingTaskState> state) : state_(std::move(state)) {}
+
+  rtc::scoped_refptr<RepeatingTaskState> state_;
+};
+
+// Shared by a RepeatingTaskHandle and the closure the task has posted.
+class RepeatingTaskState {
+ public:
+  RepeatingTaskState(TaskQueueBase* task_queue,
+                     absl::AnyInvocable<TimeDelta()> closure,
+                     TaskQueueBase::DelayPrecision precision,
+                     std::function<Timestamp()> clock);
+  RepeatingTaskState(const RepeatingTaskState&) = delete;
+  RepeatingTaskState& operator=(const RepeatingTaskState&) = delete;
+
+  void AddRef() { ref_count_.fetch_add(1, std::memory_order_relaxed); }
+  void Release() {
+    if (ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete this;
+  }
+
+  // Posts the first run for `first_run`, which is now or later.
+  void Schedule(rtc::scoped_refptr<RepeatingTaskState> self, Timestamp first_run);
+  Timestamp Now() const;
+  void Stop();
+  bool running() const { return !stopped_; }
+
+ private:
+  ~RepeatingTaskState() = default;
+
+  void Run(rtc::scoped_refptr<RepeatingTaskState> self);
+  void PostRun(rtc::scoped_refptr<RepeatingTaskState> self, TimeDelta delay);
+
+  std::atomic<int> ref_count_{0};
+  TaskQueueBase* const task_queue_;
+  // Only touched on the task's queue. The closure is destroyed on Stop(),
+  // or once it returns if it is the one that calls Stop().
+  absl::AnyInvocable<TimeDelta()> closure_;
+  bool stopped_ = false;
+  bool in_closure_ = false;
+  const TaskQueueBase::DelayPrecision precision_;
+  const std::function<Timestamp()> clock_;
+  Timestamp next_run_ = Timestamp::MinusInfinity();
+};
+
+}  // namespace webrtc
+#endif  // RTC_BASE_REPEATING_TASK_H_
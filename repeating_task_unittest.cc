@@ -0,0 +1,171 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "repeating_task.h"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "task_queue_base.h"
+#include "task_queue_simulated.h"
+#include "time_delta.h"
+#include "timestamp.h"
+
+namespace webrtc {
+namespace {
+
+constexpr TimeDelta kInterval = TimeDelta::Millis(100);
+
+// Keeps the posted tasks for the test to run, at times the test picks, on a
+// clock the test controls.
+class FakeTaskQueue final : public TaskQueueBase {
+ public:
+  void Delete() override {}
+  void PostTask(absl::AnyInvocable<void() &&> task) override { PostDelayedTaskImpl(std::move(task), TimeDelta::Zero(), DelayPrecision::kLow); }
+
+  Timestamp now() const { return now_; }
+  void AdvanceTime(TimeDelta duration) { now_ = now_ + duration; }
+  size_t posted() const { return tasks_.size(); }
+  // Delay the oldest waiting task was posted with.
+  TimeDelta next_delay() const { return tasks_.front().delay; }
+  // Runs the oldest waiting task at `now()`.
+  void RunNext() {
+    Posted posted = std::move(tasks_.front());
+    tasks_.pop_front();
+    CurrentTaskQueueSetter set_current(this);
+    std::move(posted.task)();
+  }
+  // Moves the clock to the deadline of the oldest waiting task plus
+  // `lateness` and runs it.
+  void RunNextLate(TimeDelta lateness) {
+    now_ = tasks_.front().posted_at + tasks_.front().delay + lateness;
+    RunNext();
+  }
+
+ protected:
+  void PostDelayedTaskImpl(absl::AnyInvocable<void() &&> task, TimeDelta delay, DelayPrecision precision) override {
+    tasks_.push_back({std::move(task), now_, std::max(delay, TimeDelta::Zero())});
+  }
+
+ private:
+  struct Posted {
+    absl::AnyInvocable<void() &&> task;
+    Timestamp posted_at;
+    TimeDelta delay;
+  };
+
+  Timestamp now_ = Timestamp::Seconds(1000);
+  std::deque<Posted> tasks_;
+};
+
+TEST(RepeatingTaskTest, DeadlinesDoNotDriftWithTheRunTime) {
+  FakeTaskQueue queue;
+  const Timestamp start = queue.now();
+  std::vector<Timestamp> runs;
+  RepeatingTaskHandle::Start(
+      &queue,
+      [&] {
+        runs.push_back(queue.now());
+        // The closure takes 30 ms.
+        queue.AdvanceTime(TimeDelta::Millis(30));
+        return kInterval;
+      },
+      TaskQueueBase::DelayPrecision::kLow, [&] { return queue.now(); });
+  for (int i = 0; i < 5; ++i)
+    queue.RunNextLate(TimeDelta::Zero());
+  ASSERT_EQ(runs.size(), 5u);
+  for (int i = 0; i < 5; ++i)
+    EXPECT_EQ(runs[i], start + kInterval * i) << "run " << i;
+  EXPECT_EQ(queue.next_delay(), kInterval - TimeDelta::Millis(30));
+}
+
+TEST(RepeatingTaskTest, SlightlyLateRunKeepsTheSchedule) {
+  FakeTaskQueue queue;
+  const Timestamp start = queue.now();
+  RepeatingTaskHandle::Start(
+      &queue, [] { return kInterval; }, TaskQueueBase::DelayPrecision::kLow, [&] { return queue.now(); });
+  queue.RunNext();
+  queue.RunNextLate(TimeDelta::Millis(60));
+  EXPECT_EQ(queue.now(), start + kInterval + TimeDelta::Millis(60));
+  // Still due on the original grid.
+  EXPECT_EQ(queue.next_delay(), TimeDelta::Millis(40));
+}
+
+TEST(RepeatingTaskTest, RunLateByMoreThanTheIntervalRebasesOnThePresent) {
+  FakeTaskQueue queue;
+  RepeatingTaskHandle::Start(
+      &queue, [] { return kInterval; }, TaskQueueBase::DelayPrecision::kLow, [&] { return queue.now(); });
+  queue.RunNext();
+  queue.RunNextLate(TimeDelta::Millis(250));
+  const Timestamp late_run = queue.now();
+  // The missed runs are skipped: one run now, then the interval from there.
+  ASSERT_EQ(queue.posted(), 1u);
+  EXPECT_EQ(queue.next_delay(), TimeDelta::Zero());
+  queue.RunNext();
+  ASSERT_EQ(queue.posted(), 1u);
+  EXPECT_EQ(queue.next_delay(), kInterval);
+  queue.RunNextLate(TimeDelta::Zero());
+  EXPECT_EQ(queue.now(), late_run + kInterval);
+}
+
+TEST(RepeatingTaskTest, StopsWhenTheClosureReturnsPlusInfinity) {
+  FakeTaskQueue queue;
+  int runs = 0;
+  RepeatingTaskHandle handle = RepeatingTaskHandle::Start(&queue, [&] {
+    return ++runs == 3 ? TimeDelta::PlusInfinity() : kInterval;
+  });
+  while (queue.posted() > 0)
+    queue.RunNext();
+  EXPECT_EQ(runs, 3);
+  EXPECT_FALSE(handle.Running());
+}
+
+TEST(RepeatingTaskTest, StopDestroysTheClosure) {
+  FakeTaskQueue queue;
+  auto alive = std::make_shared<int>(0);
+  std::weak_ptr<int> watch = alive;
+  RepeatingTaskHandle handle =
+      RepeatingTaskHandle::Start(&queue, [alive = std::move(alive)] { return kInterval; });
+  queue.RunNext();
+  EXPECT_TRUE(handle.Running());
+  EXPECT_FALSE(watch.expired());
+  handle.Stop();
+  EXPECT_TRUE(watch.expired());
+  EXPECT_FALSE(handle.Running());
+  // The run already posted does nothing.
+  queue.RunNext();
+  EXPECT_EQ(queue.posted(), 0u);
+}
+
+TEST(RepeatingTaskTest, RunsOnTheSimulatedClock) {
+  SimulatedTaskQueueFactory factory;
+  auto queue = factory.CreateTaskQueue("repeating", TaskQueueFactory::Priority::NORMAL);
+  const Timestamp start = factory.Now();
+  std::vector<Timestamp> runs;
+  queue->PostTask([&] {
+    RepeatingTaskHandle::DelayedStart(
+        queue.get(), kInterval,
+        [&] {
+          runs.push_back(factory.Now());
+          return kInterval;
+        },
+        TaskQueueBase::DelayPrecision::kLow, [&] { return factory.Now(); });
+  });
+  factory.AdvanceTime(TimeDelta::Seconds(1));
+  ASSERT_EQ(runs.size(), 10u);
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ(runs[i], start + kInterval * (i + 1));
+}
+
+}  // namespace
+}  // namespace webrtc
@@ -0,0 +1,48 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_RUN_LOOP_SLICE_H_
+#define RTC_BASE_RUN_LOOP_SLICE_H_
+
+#include <stdint.h>
+
+#include "task_queue_options.h"
+#include "time_utils.h"
+
+namespace webrtc {
+
+// One source's share of a loop iteration, measured against its
+// RunLoopBudget. Create it when the source starts and call Admit() before
+// each task.
+class RunLoopSlice {
+ public:
+  explicit RunLoopSlice(const RunLoopBudget& budget)
+    : budget_(budget), start_us_(budget.max_time.IsZero() ? 0 : rtc::TimeMicros()) {}
+
+  // Returns false once the budget is used up, otherwise counts one more task.
+  // The first task always fits.
+  bool Admit() {
+    if (admitted_ > 0) {
+      if (budget_.max_tasks > 0 && admitted_ >= budget_.max_tasks)
+        return false;
+      if (!budget_.max_time.IsZero() && rtc::TimeMicros() - start_us_ >= budget_.max_time.us())
+        return false;
+    }
+    ++admitted_;
+    return true;
+  }
+
+ private:
+  const RunLoopBudget budget_;
+  const int64_t start_us_;
+  int admitted_ = 0;
+};
+
+}  // namespace webrtc
+#endif  // RTC_BASE_RUN_LOOP_SLICE_H_
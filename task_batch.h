@@ -0,0 +1,62 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef API_TASK_QUEUE_TASK_BATCH_H_
+#define API_TASK_QUEUE_TASK_BATCH_H_
+
+#include <utility>
+#include <vector>
+
+#include "absl/functional/any_invocable.h"
+#include "task_queue_base.h"
+#include "time_delta.h"
+
+namespace webrtc {
+
+// Collects tasks for one queue and posts them with a single PostTasks call
+// when Post() is called or the batch goes out of scope:
+//
+//   {
+//     TaskBatch batch(queue);
+//     for (const Packet& packet : datagram)
+//       batch.Add([this, packet] { OnPacket(packet); });
+//     batch.AddDelayed([this] { OnTimeout(); }, TimeDelta::Millis(100));
+//   }  // Published here, with at most one wakeup.
+class TaskBatch {
+ public:
+  explicit TaskBatch(TaskQueueBase* queue) : queue_(queue) {}
+  TaskBatch(const TaskBatch&) = delete;
+  TaskBatch& operator=(const TaskBatch&) = delete;
+  ~TaskBatch() { Post(); }
+
+  void Add(absl::AnyInvocable<void() &&> task) {
+    tasks_.push_back({std::move(task)});
+  }
+  void AddDelayed(absl::AnyInvocable<void() &&> task, TimeDelta delay,
+                  TaskQueueBase::DelayPrecision precision = TaskQueueBase::DelayPrecision::kLow) {
+    tasks_.push_back({std::move(task), delay, precision});
+  }
+  bool empty() const { return tasks_.empty(); }
+  size_t size() const { return tasks_.size(); }
+
+  // Publishes everything added so far; the batch can then be reused.
+  void Post() {
+    if (tasks_.empty())
+      return;
+    queue_->PostTasks(std::move(tasks_));
+    tasks_.clear();
+  }
+
+ private:
+  TaskQueueBase* const queue_;
+  std::vector<TaskQueueBase::BatchedTask> tasks_;
+};
+
+}  // namespace webrtc
+#endif  // API_TASK_QUEUE_TASK_BATCH_H_
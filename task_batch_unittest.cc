@@ -0,0 +1,103 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_batch.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "event.h"
+#include "gtest/gtest.h"
+#include "task_queue_factory.h"
+#include "task_queue_for_test.h"
+#include "task_queue_pool.h"
+#include "task_queue_simulated.h"
+#include "time_delta.h"
+
+namespace webrtc {
+namespace {
+
+constexpr int kTimeoutMs = 5000;
+
+// Batches posted concurrently from several threads each run as one
+// contiguous run of tasks, in the order they were added.
+void ExpectBatchesRunUninterrupted(TaskQueueFactory& factory) {
+  constexpr int kProducers = 4;
+  constexpr int kBatches = 200;
+  constexpr int kTasksPerBatch = 16;
+  auto queue = factory.CreateTaskQueue("batch", TaskQueueFactory::Priority::NORMAL);
+  struct Ran {
+    int batch;
+    int index;
+  };
+  // Only touched on the queue.
+  std::vector<Ran> ran;
+  rtc::Event done;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&, p] {
+      for (int b = 0; b < kBatches; ++b) {
+        TaskBatch batch(queue.get());
+        for (int i = 0; i < kTasksPerBatch; ++i) {
+          batch.Add([&, batch_id = p * kBatches + b, i] {
+            ran.push_back({batch_id, i});
+            if (ran.size() == kProducers * kBatches * kTasksPerBatch)
+              done.Set();
+          });
+        }
+      }
+    });
+  }
+  for (std::thread& producer : producers)
+    producer.join();
+  ASSERT_TRUE(done.Wait(kTimeoutMs));
+  int broken = 0;
+  for (size_t i = 0; i < ran.size(); i += kTasksPerBatch) {
+    for (int j = 0; j < kTasksPerBatch; ++j) {
+      if (ran[i + j].batch != ran[i].batch || ran[i + j].index != j)
+        ++broken;
+    }
+  }
+  EXPECT_EQ(broken, 0);
+}
+
+TEST(TaskBatchTest, BatchesRunUninterrupted) {
+  auto factory = CreateNativeTaskQueueFactory();
+  ExpectBatchesRunUninterrupted(*factory);
+}
+
+TEST(TaskBatchTest, PoolBatchesRunUninterrupted) {
+  auto factory = CreateTaskQueuePoolFactory(2);
+  ExpectBatchesRunUninterrupted(*factory);
+}
+
+TEST(TaskBatchTest, DelayedTasksOfABatchWaitForTheirDelay) {
+  SimulatedTaskQueueFactory factory;
+  auto queue = factory.CreateTaskQueue("batch", TaskQueueFactory::Priority::NORMAL);
+  std::vector<int> ran;
+  {
+    TaskBatch batch(queue.get());
+    batch.AddDelayed([&] { ran.push_back(3); }, TimeDelta::Millis(20));
+    batch.Add([&] { ran.push_back(1); });
+    batch.AddDelayed([&] { ran.push_back(2); }, TimeDelta::Millis(10));
+    EXPECT_EQ(batch.size(), 3u);
+    factory.RunUntilIdle();
+    EXPECT_TRUE(ran.empty());
+  }
+  factory.RunUntilIdle();
+  EXPECT_EQ(ran, (std::vector<int>{1}));
+  factory.AdvanceTime(TimeDelta::Millis(10));
+  EXPECT_EQ(ran, (std::vector<int>{1, 2}));
+  factory.AdvanceTime(TimeDelta::Millis(10));
+  EXPECT_EQ(ran, (std::vector<int>{1, 2, 3}));
+}
+
+}  // namespace
+}  // namespace webrtc
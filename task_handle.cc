@@ -0,0 +1,41 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_handle.h"
+
+#include "delayed_task_store.h"
+#include "task_queue_base.h"
+
+namespace webrtc {
+
+bool CancelableTaskState::Run() {
+  Status expected = Status::kPending;
+  if (!status_.compare_exchange_strong(expected, Status::kRunning, std::memory_order_acq_rel))
+    return false;
+  std::move(task_)();
+  task_ = nullptr;
+  status_.store(Status::kDone, std::memory_order_release);
+  return true;
+}
+
+bool CancelableTaskState::Cancel() {
+  Status expected = Status::kPending;
+  if (!status_.compare_exchange_strong(expected, Status::kCancelled, std::memory_order_acq_rel))
+    return false;
+  // Winning the exchange gives this thread sole ownership of the closure;
+  // Run() never touches it unless it wins instead.
+  task_ = nullptr;
+  // `owner_` is only dereferenced through the store, and only when we are
+  // running on it, so a handle may safely outlive its queue.
+  if (owner_ == TaskQueueBase::Current() && store_ != nullptr)
+    store_->Remove(store_entry_);
+  return true;
+}
+
+}  // namespace webrtc
@@ -0,0 +1,90 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef API_TASK_QUEUE_TASK_HANDLE_H_
+#define API_TASK_QUEUE_TASK_HANDLE_H_
+
+#include <atomic>
+#include <utility>
+
+#include "absl/functional/any_invocable.h"
+#include "scoped_refptr.h"
+
+namespace webrtc {
+
+class DelayedTaskStore;
+class TaskQueueBase;
+
+// Control block shared by a cancelable task and its TaskHandle(s). The
+// closure lives here rather than in the queue, so whoever wins the race
+// between Run() and Cancel() owns it exclusively.
+class CancelableTaskState {
+ public:
+  CancelableTaskState(absl::AnyInvocable<void() &&> task, TaskQueueBase* owner)
+    : task_(std::move(task)), owner_(owner) {}
+  CancelableTaskState(const CancelableTaskState&) = delete;
+  CancelableTaskState& operator=(const CancelableTaskState&) = delete;
+
+  void AddRef() { ref_count_.fetch_add(1, std::memory_order_relaxed); }
+  void Release() {
+    if (ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete this;
+  }
+
+  // Runs the task unless it has been cancelled, and returns true if it did.
+  // Owning queue only.
+  bool Run();
+  bool Cancel();
+  bool IsPending() const {
+    return status_.load(std::memory_order_acquire) == Status::kPending;
+  }
+
+  // Where the task is filed while it waits in a DelayedTaskStore. Both are
+  // only touched on the owning queue.
+  void SetStoreEntry(DelayedTaskStore* store, void* entry) {
+    store_ = store;
+    store_entry_ = entry;
+  }
+
+ private:
+  enum class Status { kPending, kRunning, kDone, kCancelled };
+
+  ~CancelableTaskState() = default;
+
+  std::atomic<int> ref_count_{0};
+  std::atomic<Status> status_{Status::kPending};
+  absl::AnyInvocable<void() &&> task_;
+  TaskQueueBase* const owner_;
+  DelayedTaskStore* store_ = nullptr;
+  void* store_entry_ = nullptr;
+};
+
+// Handle to a task posted with TaskQueueBase::PostCancelableDelayedTask.
+// Cheap to copy; a default constructed handle refers to no task.
+class TaskHandle {
+ public:
+  TaskHandle() = default;
+  explicit TaskHandle(rtc::scoped_refptr<CancelableTaskState> state)
+    : state_(std::move(state)) {}
+
+  // Prevents the task from running if it has not started yet and returns
+  // true if this call did so. The closure and everything it captured are
+  // destroyed right away. Safe to call from any thread; on the queue the task
+  // was posted to, its timer entry is removed as well, elsewhere the empty
+  // entry is discarded when its deadline comes up.
+  bool Cancel() { return state_ && state_->Cancel(); }
+  // True while the task has neither started running nor been cancelled.
+  bool IsPending() const { return state_ && state_->IsPending(); }
+
+ private:
+  rtc::scoped_refptr<CancelableTaskState> state_;
+};
+
+}  // namespace webrtc
+#endif  // API_TASK_QUEUE_TASK_HANDLE_H_
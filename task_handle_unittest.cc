@@ -0,0 +1,89 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_handle.h"
+
+#include <memory>
+
+#include "gtest/gtest.h"
+#include "task_queue_factory.h"
+#include "task_queue_for_test.h"
+#include "task_queue_simulated.h"
+#include "time_delta.h"
+
+namespace webrtc {
+namespace {
+
+// Sets `*destroyed` when the closure holding it goes away.
+class DestructionFlag {
+ public:
+  explicit DestructionFlag(bool* destroyed) : destroyed_(destroyed) {}
+  DestructionFlag(DestructionFlag&& other) : destroyed_(other.destroyed_) { other.destroyed_ = nullptr; }
+  DestructionFlag(const DestructionFlag&) = delete;
+  DestructionFlag& operator=(const DestructionFlag&) = delete;
+  ~DestructionFlag() {
+    if (destroyed_)
+      *destroyed_ = true;
+  }
+
+ private:
+  bool* destroyed_;
+};
+
+TEST(TaskHandleTest, CancelFromAnotherThreadFreesTheClosureRightAway) {
+  auto factory = CreateNativeTaskQueueFactory();
+  auto queue = factory->CreateTaskQueue("cancel", TaskQueueFactory::Priority::NORMAL);
+  bool destroyed = false;
+  bool ran = false;
+  TaskHandle handle = queue->PostCancelableDelayedTask(
+      [flag = DestructionFlag(&destroyed), &ran] { ran = true; }, TimeDelta::Seconds(60));
+  EXPECT_TRUE(handle.IsPending());
+  EXPECT_FALSE(destroyed);
+  EXPECT_TRUE(handle.Cancel());
+  EXPECT_TRUE(destroyed);
+  EXPECT_FALSE(handle.IsPending());
+  EXPECT_FALSE(handle.Cancel());
+  EXPECT_FALSE(ran);
+}
+
+TEST(TaskHandleTest, CancelledTaskNeverRuns) {
+  SimulatedTaskQueueFactory factory;
+  auto queue = factory.CreateTaskQueue("cancel", TaskQueueFactory::Priority::NORMAL);
+  bool destroyed = false;
+  bool ran = false;
+  TaskHandle handle = queue->PostCancelableDelayedTask(
+      [flag = DestructionFlag(&destroyed), &ran] { ran = true; }, TimeDelta::Millis(10));
+  // Cancelled on the queue itself, which also drops the timer entry.
+  queue->PostTask([&] {
+    EXPECT_TRUE(handle.Cancel());
+    EXPECT_TRUE(destroyed);
+  });
+  factory.AdvanceTime(TimeDelta::Seconds(1));
+  EXPECT_FALSE(ran);
+}
+
+TEST(TaskHandleTest, CancelAfterTheTaskRanFails) {
+  SimulatedTaskQueueFactory factory;
+  auto queue = factory.CreateTaskQueue("cancel", TaskQueueFactory::Priority::NORMAL);
+  bool ran = false;
+  TaskHandle handle = queue->PostCancelableDelayedTask([&ran] { ran = true; }, TimeDelta::Millis(10));
+  factory.AdvanceTime(TimeDelta::Millis(10));
+  EXPECT_TRUE(ran);
+  EXPECT_FALSE(handle.IsPending());
+  EXPECT_FALSE(handle.Cancel());
+}
+
+TEST(TaskHandleTest, DefaultHandleRefersToNoTask) {
+  TaskHandle handle;
+  EXPECT_FALSE(handle.IsPending());
+  EXPECT_FALSE(handle.Cancel());
+}
+
+}  // namespace
+}  // namespace webrtc
@@ -0,0 +1,94 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_lanes.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace webrtc {
+
+void TaskLanes::Clear() {
+  for (Lane& lane : lanes_) {
+    while (Node* node = lane.head) {
+      lane.head = node->next;
+      pool_.Delete(node);
+    }
+    lane.tail = nullptr;
+  }
+  earliest_deadline_us_ = INT64_MAX;
+}
+
+void TaskLanes::Add(TaskQueueBase::TaskLane lane, QueuedClosure task, Timestamp deadline) {
+  // PlusInfinity() is INT64_MAX and so never expires.
+  const int64_t deadline_us = deadline.us();
+  Node* node = pool_.New(std::move(task), deadline_us);
+  Lane& target = lanes_[lane == TaskQueueBase::TaskLane::kIdle ? 1 : 0];
+  if (target.tail)
+    target.tail->next = node;
+  else
+    target.head = node;
+  target.tail = node;
+  earliest_deadline_us_ = std::min(earliest_deadline_us_, deadline_us);
+}
+
+bool TaskLanes::PopExpired(Timestamp now, QueuedClosure* task) {
+  if (earliest_deadline_us_ > now.us())
+    return false;
+  for (Lane& lane : lanes_) {
+    Node* previous = nullptr;
+    for (Node* node = lane.head; node != nullptr; previous = node, node = node->next) {
+      if (node->deadline_us <= now.us()) {
+        Take(lane, previous, node, task);
+        return true;
+      }
+    }
+  }
+  UpdateEarliestDeadline();
+  return false;
+}
+
+bool TaskLanes::PopLowPriority(QueuedClosure* task) {
+  if (lanes_[0].head == nullptr)
+    return false;
+  Take(lanes_[0], nullptr, lanes_[0].head, task);
+  return true;
+}
+
+bool TaskLanes::PopAny(QueuedClosure* task) {
+  if (PopLowPriority(task))
+    return true;
+  if (lanes_[1].head == nullptr)
+    return false;
+  Take(lanes_[1], nullptr, lanes_[1].head, task);
+  return true;
+}
+
+void TaskLanes::Take(Lane& lane, Node* previous, Node* node, QueuedClosure* task) {
+  if (previous)
+    previous->next = node->next;
+  else
+    lane.head = node->next;
+  if (lane.tail == node)
+    lane.tail = previous;
+  *task = std::move(node->task);
+  pool_.Delete(node);
+  if (empty())
+    earliest_deadline_us_ = INT64_MAX;
+}
+
+void TaskLanes::UpdateEarliestDeadline() {
+  earliest_deadline_us_ = INT64_MAX;
+  for (const Lane& lane : lanes_) {
+    for (const Node* node = lane.head; node != nullptr; node = node->next)
+      earliest_deadline_us_ = std::min(earliest_deadline_us_, node->deadline_us);
+  }
+}
+
+}  // namespace webrtc
@@ -0,0 +1,82 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_TASK_LANES_H_
+#define RTC_BASE_TASK_LANES_H_
+
+#include <stdint.h>
+
+#include "inline_task.h"
+#include "task_node_pool.h"
+#include "task_queue_base.h"
+#include "time_delta.h"
+#include "timestamp.h"
+
+namespace webrtc {
+
+// The low priority and idle lanes of one queue, see
+// TaskQueueBase::PostLowPriorityTask(). Each lane is FIFO. The queue decides
+// when to take tasks from them; TaskLanes only keeps the order and tracks
+// deadlines. Not thread safe, all calls are made on the queue thread.
+class TaskLanes {
+ public:
+  TaskLanes() = default;
+  TaskLanes(const TaskLanes&) = delete;
+  TaskLanes& operator=(const TaskLanes&) = delete;
+  ~TaskLanes() { Clear(); }
+
+  // Deadline of a task posted at `now` that is promoted after `delay`.
+  static Timestamp Deadline(Timestamp now, TimeDelta delay) {
+    return delay.IsPlusInfinity() ? Timestamp::PlusInfinity() : now + delay;
+  }
+
+  bool empty() const { return lanes_[0].head == nullptr && lanes_[1].head == nullptr; }
+  bool has_low_priority() const { return lanes_[0].head != nullptr; }
+  // No waiting task has an earlier deadline; PlusInfinity() if none has one.
+  // May be early after tasks were taken.
+  Timestamp earliest_deadline() const {
+    return earliest_deadline_us_ == INT64_MAX ? Timestamp::PlusInfinity() : Timestamp::Micros(earliest_deadline_us_);
+  }
+  // `lane` is kLowPriority or kIdle. A task whose `deadline` has passed is
+  // handed out by PopExpired() ahead of the lane order.
+  void Add(TaskQueueBase::TaskLane lane, QueuedClosure task, Timestamp deadline);
+  // Takes a task of either lane whose deadline is at or before `now`. Cheap
+  // while no deadline has passed.
+  bool PopExpired(Timestamp now, QueuedClosure* task);
+  // Takes the oldest low priority task.
+  bool PopLowPriority(QueuedClosure* task);
+  // Takes the oldest low priority task, or else the oldest idle task.
+  bool PopAny(QueuedClosure* task);
+  // Drops every waiting task.
+  void Clear();
+
+ private:
+  struct Node {
+    Node(QueuedClosure task, int64_t deadline_us) : task(std::move(task)), deadline_us(deadline_us) {}
+    QueuedClosure task;
+    int64_t deadline_us;
+    Node* next = nullptr;
+  };
+  struct Lane {
+    Node* head = nullptr;
+    Node* tail = nullptr;
+  };
+
+  void Take(Lane& lane, Node* previous, Node* node, QueuedClosure* task);
+  void UpdateEarliestDeadline();
+
+  Lane lanes_[2];
+  // No deadline of a waiting task is earlier; may be stale-early after a
+  // task was taken, which only costs one rescan.
+  int64_t earliest_deadline_us_ = INT64_MAX;
+  TaskNodePool<Node> pool_;
+};
+
+}  // namespace webrtc
+#endif  // RTC_BASE_TASK_LANES_H_
@@ -0,0 +1,217 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_lanes.h"
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "event.h"
+#include "gtest/gtest.h"
+#include "inline_task.h"
+#include "task_queue_base.h"
+#include "task_queue_factory.h"
+#include "task_queue_for_test.h"
+#include "task_queue_options.h"
+#include "task_queue_pool.h"
+#include "time_delta.h"
+#include "timestamp.h"
+
+namespace webrtc {
+namespace {
+
+using TaskLane = TaskQueueBase::TaskLane;
+
+constexpr int kTimeoutMs = 5000;
+const Timestamp kStart = Timestamp::Seconds(1000);
+
+// Pops with `pop` until it fails and returns the ids of the tasks, in order.
+template <typename Pop>
+std::vector<int> PopAll(std::vector<int>& ran, Pop pop) {
+  ran.clear();
+  QueuedClosure task;
+  while (pop(&task))
+    std::move(task)();
+  return ran;
+}
+
+TEST(TaskLanesTest, KeepsEachLaneInPostingOrder) {
+  TaskLanes lanes;
+  std::vector<int> ran;
+  for (int id : {1, 2, 3})
+    lanes.Add(TaskLane::kIdle, QueuedClosure([&ran, id] { ran.push_back(id); }), Timestamp::PlusInfinity());
+  for (int id : {4, 5, 6})
+    lanes.Add(TaskLane::kLowPriority, QueuedClosure([&ran, id] { ran.push_back(id); }), Timestamp::PlusInfinity());
+  EXPECT_TRUE(lanes.has_low_priority());
+  EXPECT_EQ(PopAll(ran, [&](QueuedClosure* task) { return lanes.PopLowPriority(task); }),
+            (std::vector<int>{4, 5, 6}));
+  EXPECT_FALSE(lanes.has_low_priority());
+  EXPECT_FALSE(lanes.empty());
+  EXPECT_EQ(PopAll(ran, [&](QueuedClosure* task) { return lanes.PopAny(task); }), (std::vector<int>{1, 2, 3}));
+  EXPECT_TRUE(lanes.empty());
+}
+
+TEST(TaskLanesTest, PopAnyTakesLowPriorityTasksFirst) {
+  TaskLanes lanes;
+  std::vector<int> ran;
+  lanes.Add(TaskLane::kIdle, QueuedClosure([&ran] { ran.push_back(1); }), Timestamp::PlusInfinity());
+  lanes.Add(TaskLane::kLowPriority, QueuedClosure([&ran] { ran.push_back(2); }), Timestamp::PlusInfinity());
+  EXPECT_EQ(PopAll(ran, [&](QueuedClosure* task) { return lanes.PopAny(task); }), (std::vector<int>{2, 1}));
+}
+
+TEST(TaskLanesTest, PopExpiredPromotesTasksPastTheirDeadline) {
+  TaskLanes lanes;
+  std::vector<int> ran;
+  lanes.Add(TaskLane::kLowPriority, QueuedClosure([&ran] { ran.push_back(1); }), Timestamp::PlusInfinity());
+  lanes.Add(TaskLane::kLowPriority, QueuedClosure([&ran] { ran.push_back(2); }), kStart + TimeDelta::Millis(20));
+  lanes.Add(TaskLane::kIdle, QueuedClosure([&ran] { ran.push_back(3); }), kStart + TimeDelta::Millis(10));
+  lanes.Add(TaskLane::kIdle, QueuedClosure([&ran] { ran.push_back(4); }), Timestamp::PlusInfinity());
+  EXPECT_EQ(lanes.earliest_deadline(), kStart + TimeDelta::Millis(10));
+  auto pop_expired = [&](Timestamp now) {
+    return PopAll(ran, [&](QueuedClosure* task) { return lanes.PopExpired(now, task); });
+  };
+  EXPECT_TRUE(pop_expired(kStart + TimeDelta::Millis(10) - TimeDelta::Micros(1)).empty());
+  EXPECT_EQ(pop_expired(kStart + TimeDelta::Millis(10)), (std::vector<int>{3}));
+  EXPECT_EQ(pop_expired(kStart + TimeDelta::Millis(30)), (std::vector<int>{2}));
+  EXPECT_EQ(lanes.earliest_deadline(), Timestamp::PlusInfinity());
+  // Tasks without a deadline never expire; the rest keep their order.
+  EXPECT_TRUE(pop_expired(Timestamp::Seconds(1000000)).empty());
+  EXPECT_EQ(PopAll(ran, [&](QueuedClosure* task) { return lanes.PopAny(task); }), (std::vector<int>{1, 4}));
+}
+
+struct FactoryParam {
+  std::string name;
+  std::unique_ptr<TaskQueueFactory> (*create)(const TaskQueueOptions& options);
+};
+
+void PrintTo(const FactoryParam& param, std::ostream* os) {
+  *os << param.name;
+}
+
+class TaskLanesQueueTest : public ::testing::TestWithParam<FactoryParam> {
+ protected:
+  std::unique_ptr<TaskQueueFactory> CreateFactory(const TaskQueueOptions& options = TaskQueueOptions()) {
+    return GetParam().create(options);
+  }
+};
+
+// Keeps `queue` busy with a chain of normal tasks, each posting the next,
+// until Stop(). Only touched on the queue. The chain holds the state, so the
+// task left after Stop() may run once the Flood is gone.
+class Flood {
+ public:
+  explicit Flood(TaskQueueBase* queue) : state_(std::make_shared<State>()) { Next(queue, state_); }
+  void Stop() { state_->stopped = true; }
+  bool stopped() const { return state_->stopped; }
+  int tasks_run() const { return state_->tasks_run; }
+
+ private:
+  struct State {
+    bool stopped = false;
+    int tasks_run = 0;
+  };
+
+  static void Next(TaskQueueBase* queue, std::shared_ptr<State> state) {
+    queue->PostTask([queue, state] {
+      ++state->tasks_run;
+      if (!state->stopped)
+        Next(queue, state);
+    });
+  }
+
+  const std::shared_ptr<State> state_;
+};
+
+TEST_P(TaskLanesQueueTest, RunsEachLaneInPostingOrder) {
+  auto factory = CreateFactory();
+  auto queue = factory->CreateTaskQueue("lanes", TaskQueueFactory::Priority::NORMAL);
+  std::vector<int> ran;
+  rtc::Event done;
+  queue->PostTask([&] {
+    for (int id : {1, 2, 3})
+      queue->PostIdleTask([&ran, &done, id] {
+        ran.push_back(id);
+        if (id == 3)
+          done.Set();
+      });
+    for (int id : {4, 5, 6})
+      queue->PostLowPriorityTask([&ran, id] { ran.push_back(id); });
+  });
+  ASSERT_TRUE(done.Wait(kTimeoutMs));
+  EXPECT_EQ(ran, (std::vector<int>{4, 5, 6, 1, 2, 3}));
+}
+
+// The budgeted slice lets low priority tasks through a queue that never runs
+// out of normal tasks.
+TEST_P(TaskLanesQueueTest, LowPriorityTasksRunDuringAFlood) {
+  auto factory = CreateFactory();
+  auto queue = factory->CreateTaskQueue("lanes", TaskQueueFactory::Priority::NORMAL);
+  Flood flood(queue.get());
+  rtc::Event done;
+  bool flooding = false;
+  queue->PostLowPriorityTask([&] {
+    flooding = !flood.stopped();
+    flood.Stop();
+    done.Set();
+  });
+  ASSERT_TRUE(done.Wait(kTimeoutMs));
+  EXPECT_TRUE(flooding);
+}
+
+// Idle tasks do not get a slice, but are promoted once their deadline passes.
+TEST_P(TaskLanesQueueTest, IdleTaskRunsAtItsDeadlineDuringAFlood) {
+  auto factory = CreateFactory();
+  auto queue = factory->CreateTaskQueue("lanes", TaskQueueFactory::Priority::NORMAL);
+  Flood flood(queue.get());
+  rtc::Event done;
+  bool flooding = false;
+  int flood_tasks = 0;
+  queue->PostIdleTask(
+      [&] {
+        flooding = !flood.stopped();
+        flood_tasks = flood.tasks_run();
+        flood.Stop();
+        done.Set();
+      },
+      TimeDelta::Millis(20));
+  ASSERT_TRUE(done.Wait(kTimeoutMs));
+  EXPECT_TRUE(flooding);
+  EXPECT_GT(flood_tasks, 1);
+}
+
+// With a zero budget low priority tasks wait for the flood to end, and then
+// run.
+TEST_P(TaskLanesQueueTest, ZeroBudgetRunsLowPriorityTasksOnceIdle) {
+  auto factory = CreateFactory(TaskQueueOptions().SetLowPriorityBudget(TimeDelta::Zero()));
+  auto queue = factory->CreateTaskQueue("lanes", TaskQueueFactory::Priority::NORMAL);
+  Flood flood(queue.get());
+  rtc::Event done;
+  bool flooding = true;
+  queue->PostLowPriorityTask([&] {
+    flooding = !flood.stopped();
+    done.Set();
+  });
+  queue->PostDelayedTask([&] { flood.Stop(); }, TimeDelta::Millis(20));
+  ASSERT_TRUE(done.Wait(kTimeoutMs));
+  EXPECT_FALSE(flooding);
+}
+
+INSTANTIATE_TEST_SUITE_P(Factories,
+                         TaskLanesQueueTest,
+                         ::testing::Values(FactoryParam{"Native", &CreateNativeTaskQueueFactory},
+                                           FactoryParam{"Pool",
+                                                        [](const TaskQueueOptions& options) {
+                                                          return CreateTaskQueuePoolFactory(2, options);
+                                                        }}),
+                         [](const ::testing::TestParamInfo<FactoryParam>& info) { return info.param.name; });
+
+}  // namespace
+}  // namespace webrtc
@@ -0,0 +1,130 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_TASK_NODE_POOL_H_
+#define RTC_BASE_TASK_NODE_POOL_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace webrtc {
+
+// Per-queue slab allocator for task nodes. Nodes are carved out of slabs of
+// kSlabSize and go back onto the pool's lock-free free list when the queue
+// thread is done with them, so in steady state posting a task neither calls
+// malloc nor frees memory on a thread other than the one that allocated it.
+//
+// New() may be called from any thread, Delete() from any thread. Every node
+// must be returned before the pool is destroyed.
+template <typename T>
+class TaskNodePool {
+ public:
+  TaskNodePool() = default;
+  TaskNodePool(const TaskNodePool&) = delete;
+  TaskNodePool& operator=(const TaskNodePool&) = delete;
+  ~TaskNodePool() {
+    for (uint32_t i = 0; i < slab_count_; ++i)
+      delete[] slabs_[i].load(std::memory_order_relaxed);
+  }
+
+  template <typename... Args>
+  T* New(Args&&... args) {
+    Slot* slot = Pop();
+    if (slot == nullptr)
+      slot = Grow();
+    return new (slot->storage) T(std::forward<Args>(args)...);
+  }
+
+  void Delete(T* node) {
+    node->~T();
+    Slot* slot = reinterpret_cast<Slot*>(node);
+    if (slot->index == kHeapIndex) {
+      delete slot;
+      return;
+    }
+    PushChain(slot, slot);
+  }
+
+ private:
+  static constexpr uint32_t kSlabSize = 256;
+  // Caps the pool at 64k nodes; beyond that nodes come from the heap.
+  static constexpr uint32_t kMaxSlabs = 256;
+  static constexpr uint32_t kHeapIndex = UINT32_MAX;
+
+  struct Slot {
+    alignas(T) unsigned char storage[sizeof(T)];
+    uint32_t index = kHeapIndex;
+    // Free list link: index + 1 of the next free slot, 0 ends the list.
+    std::atomic<uint32_t> next{0};
+  };
+
+  Slot* SlotAt(uint32_t index) const {
+    return slabs_[index / kSlabSize].load(std::memory_order_acquire) + index % kSlabSize;
+  }
+
+  // The free list head packs a modification tag (high 32 bits) with index + 1
+  // of the first free slot (low 32 bits). The tag changes on every update, so
+  // a pop that raced with a pop and re-push of the same slot fails its CAS
+  // instead of installing a stale link (the ABA problem).
+  Slot* Pop() {
+    uint64_t head = free_head_.load(std::memory_order_acquire);
+    while (static_cast<uint32_t>(head) != 0) {
+      Slot* slot = SlotAt(static_cast<uint32_t>(head) - 1);
+      const uint64_t next = (((head >> 32) + 1) << 32) | slot->next.load(std::memory_order_relaxed);
+      if (free_head_.compare_exchange_weak(head, next, std::memory_order_acquire,
+                                           std::memory_order_acquire)) {
+        return slot;
+      }
+    }
+    return nullptr;
+  }
+
+  // Pushes slots already linked from `first` to `last`.
+  void PushChain(Slot* first, Slot* last) {
+    uint64_t head = free_head_.load(std::memory_order_relaxed);
+    uint64_t next;
+    do {
+      last->next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+      next = (((head >> 32) + 1) << 32) | (first->index + 1);
+    } while (!free_head_.compare_exchange_weak(head, next, std::memory_order_release,
+                                               std::memory_order_relaxed));
+  }
+
+  Slot* Grow() {
+    std::lock_guard<std::mutex> lock(grow_mutex_);
+    // Someone else may have grown the pool while we waited.
+    if (Slot* slot = Pop())
+      return slot;
+    if (slab_count_ == kMaxSlabs)
+      return new Slot;
+    Slot* slab = new Slot[kSlabSize];
+    const uint32_t base = slab_count_ * kSlabSize;
+    for (uint32_t i = 0; i < kSlabSize; ++i) {
+      slab[i].index = base + i;
+      slab[i].next.store(i + 1 < kSlabSize ? base + i + 2 : 0, std::memory_order_relaxed);
+    }
+    slabs_[slab_count_].store(slab, std::memory_order_release);
+    ++slab_count_;
+    // Keep the first slot for the caller and publish the rest.
+    PushChain(&slab[1], &slab[kSlabSize - 1]);
+    return &slab[0];
+  }
+
+  std::atomic<uint64_t> free_head_{0};
+  std::mutex grow_mutex_;
+  uint32_t slab_count_ = 0;
+  std::atomic<Slot*> slabs_[kMaxSlabs] = {};
+};
+
+}  // namespace webrtc
+#endif  // RTC_BASE_TASK_NODE_POOL_H_
@@ -9,13 +9,61 @@
  */
 #include "task_queue_base.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mutex>
+#include <unordered_map>
+
 #include "absl/base/attributes.h"
 #include "absl/base/config.h"
 #include "absl/functional/any_invocable.h"
+#include "event.h"
+#include "task_queue_limiter.h"
 
 namespace webrtc {
 namespace {
 ABSL_CONST_INIT thread_local TaskQueueBase* current = nullptr;
+
+// Wait primitive of the calling thread, shared by all its blocking calls.
+rtc::Event& BlockingCallEvent() {
+  thread_local rtc::Event event;
+  return event;
+}
+
+#if !defined(NDEBUG)
+// Which queue each queue is blocked on, to catch cycles before they hang.
+class BlockingCallGraph {
+ public:
+  static BlockingCallGraph& Get() {
+    static BlockingCallGraph* const graph = new BlockingCallGraph();
+    return *graph;
+  }
+
+  void Enter(const TaskQueueBase* caller, const TaskQueueBase* target) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const TaskQueueBase* queue = target; queue != nullptr;) {
+      if (queue == caller) {
+        fprintf(stderr, "BlockingCall from queue %p to %p deadlocks: the target already waits on the caller.\n",
+                static_cast<const void*>(caller), static_cast<const void*>(target));
+        abort();
+      }
+      auto it = waiting_on_.find(queue);
+      queue = it == waiting_on_.end() ? nullptr : it->second;
+    }
+    waiting_on_[caller] = target;
+  }
+
+  void Leave(const TaskQueueBase* caller) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    waiting_on_.erase(caller);
+  }
+
+ private:
+  std::mutex mutex_;
+  std::unordered_map<const TaskQueueBase*, const TaskQueueBase*> waiting_on_;
+};
+#endif
 }  // namespace
 
 TaskQueueBase* TaskQueueBase::Current() {
@@ -35,8 +83,95 @@ TaskQueueBase::CurrentTaskQueueSetter::~CurrentTaskQueueSetter() {
 namespace webrtc {
 void TaskQueueBase::PostTask(absl::AnyInvocable<void() &&> task) {
 }
-void TaskQueueBase::PostDelayedTask(absl::AnyInvocable<void() &&> task, int ms) {
+void TaskQueueBase::PostDelayedTaskImpl(absl::AnyInvocable<void() &&> task, TimeDelta delay, DelayPrecision precision) {
+}
+
+TaskHandle TaskQueueBase::PostCancelableDelayedTask(absl::AnyInvocable<void() &&> task, TimeDelta delay, DelayPrecision precision) {
+  rtc::scoped_refptr<CancelableTaskState> state(new CancelableTaskState(std::move(task), this));
+  PostCancelableDelayedTaskImpl(state, delay, precision);
+  return TaskHandle(std::move(state));
+}
+
+void TaskQueueBase::PostCancelableDelayedTaskImpl(rtc::scoped_refptr<CancelableTaskState> task, TimeDelta delay, DelayPrecision precision) {
+  PostDelayedTaskImpl([task = std::move(task)] { task->Run(); }, delay, precision);
+}
+
+void TaskQueueBase::PostQueuedClosureImpl(QueuedClosure task) {
+  PostTask(absl::AnyInvocable<void() &&>(std::move(task)));
+}
+
+void TaskQueueBase::BlockingCallImpl(absl::FunctionRef<void()> functor) {
+  if (IsCurrent()) {
+    functor();
+    return;
+  }
+#if !defined(NDEBUG)
+  // Plain threads cannot be waited on, so only queues are tracked.
+  TaskQueueBase* const caller = Current();
+  if (caller)
+    BlockingCallGraph::Get().Enter(caller, this);
+#endif
+  rtc::Event& done = BlockingCallEvent();
+  {
+    // The caller waits for the task, so a full queue must not drop it.
+    TaskQueueLimiter::MustPost must_post;
+    PostTask([functor, &done] {
+      functor();
+      done.Set();
+    });
+  }
+  done.Wait(rtc::Event::kForever);
+#if !defined(NDEBUG)
+  if (caller)
+    BlockingCallGraph::Get().Leave(caller);
+#endif
+}
+
+void TaskQueueBase::PostLaneTaskImpl(TaskLane lane, absl::AnyInvocable<void() &&> task, TimeDelta deadline) {
+  PostTask(std::move(task));
+}
+
+bool TaskQueueBase::TryPostTaskImpl(absl::AnyInvocable<void() &&> task) {
+  PostTask(std::move(task));
+  return true;
+}
+
+void TaskQueueBase::PostDroppableTaskImpl(absl::AnyInvocable<void() &&> task) {
+  PostTask(std::move(task));
+}
+
+bool TaskQueueBase::RegisterFd(NativeFd fd, int events, absl::AnyInvocable<void(int events)> callback) {
+  if (IsCurrent())
+    return RegisterFdImpl(fd, events, std::move(callback));
+  return BlockingCall([&] { return RegisterFdImpl(fd, events, std::move(callback)); });
+}
+
+void TaskQueueBase::UnregisterFd(NativeFd fd) {
+  if (IsCurrent())
+    UnregisterFdImpl(fd);
+  else
+    BlockingCall([&] { UnregisterFdImpl(fd); });
+}
+
+bool TaskQueueBase::RegisterFdImpl(NativeFd fd, int events, absl::AnyInvocable<void(int events)> callback) {
+  return false;
+}
+
+void TaskQueueBase::UnregisterFdImpl(NativeFd fd) {}
+
+void TaskQueueBase::PostTasks(std::vector<absl::AnyInvocable<void() &&>> tasks) {
+  std::vector<BatchedTask> batch(tasks.size());
+  for (size_t i = 0; i < tasks.size(); ++i)
+    batch[i].task = std::move(tasks[i]);
+  PostTasksImpl(std::move(batch));
 }
-void TaskQueueBase::PostDelayedHighPrecisionTask(absl::AnyInvocable<void() &&> task, int ms) {
+
+void TaskQueueBase::PostTasksImpl(std::vector<BatchedTask> tasks) {
+  for (BatchedTask& task : tasks) {
+    if (task.delay <= TimeDelta::Zero())
+      PostTask(std::move(task.task));
+    else
+      PostDelayedTaskImpl(std::move(task.task), task.delay, task.precision);
+  }
 }
 }  // namespace webrtc
@@ -10,11 +10,24 @@
 #ifndef API_TASK_QUEUE_TASK_QUEUE_BASE_H_
 #define API_TASK_QUEUE_TASK_QUEUE_BASE_H_
 
+#include <stdint.h>
+
 #include <memory>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/functional/any_invocable.h"
+#include "absl/functional/function_ref.h"
+#include "absl/types/optional.h"
+#include "inline_task.h"
+#include "location.h"
 #include "queued_task.h"
+#include "scoped_refptr.h"
+#include "task_handle.h"
+#include "task_queue_stats.h"
+#include "task_trace.h"
+#include "time_delta.h"
 
 namespace webrtc {
 class TaskQueueBase {
@@ -24,23 +37,180 @@ class TaskQueueBase {
     kHigh,
   };
 
+  // Lanes of one queue, see PostLowPriorityTask().
+  enum class TaskLane {
+    kNormal,
+    kLowPriority,
+    kIdle,
+  };
+
+  // Descriptor RegisterFd() watches: a socket on Windows, any pollable file
+  // descriptor elsewhere.
+#if defined(_WIN32)
+  using NativeFd = uintptr_t;
+#else
+  using NativeFd = int;
+#endif
+
+  // Readiness RegisterFd() watches for, as a bit mask. Errors and hangups
+  // are reported as kFdReadable, so that the next read returns them.
+  enum FdEvent : int {
+    kFdReadable = 1 << 0,
+    kFdWritable = 1 << 1,
+  };
+
+  // One task of a batch posted with PostTasks. A zero delay makes it an
+  // immediate task.
+  struct BatchedTask {
+    absl::AnyInvocable<void() &&> task;
+    TimeDelta delay = TimeDelta::Zero();
+    DelayPrecision precision = DelayPrecision::kLow;
+  };
+
   virtual void Delete() = 0;
   virtual void PostTask(absl::AnyInvocable<void() &&> task); // override
-  virtual void PostDelayedTask(absl::AnyInvocable<void() &&> task, int ms); // override
-  virtual void PostDelayedHighPrecisionTask(absl::AnyInvocable<void() &&> task, int ms); // override
+  // Posts a lambda or other closure without wrapping it in AnyInvocable.
+  // Captures of up to WEBRTC_TASK_INLINE_CAPACITY bytes are stored inside the
+  // queue's pooled task node, so posting them does not allocate; larger ones
+  // spill to the heap and are counted by InlineTaskHeapSpillCount().
+  template <typename Closure,
+            typename = typename std::enable_if<!std::is_same<typename std::decay<Closure>::type,
+                                                             absl::AnyInvocable<void() &&>>::value>::type>
+  void PostTask(Closure&& closure) {
+    PostQueuedClosureImpl(QueuedClosure(std::forward<Closure>(closure)));
+  }
+  // Posts `tasks` as one unit: immediate tasks run in order with no other
+  // producer's task between them, the queue is woken at most once, and the
+  // delayed ones re-arm the queue timer at most once. See also TaskBatch.
+  void PostTasks(std::vector<BatchedTask> tasks) {
+    PostTasksImpl(std::move(tasks));
+  }
+  void PostTasks(std::vector<absl::AnyInvocable<void() &&>> tasks);
+  // Delays are measured on the monotonic clock with microsecond resolution.
+  // A task never runs before its delay has elapsed; low precision tasks may
+  // run up to TaskQueueOptions::low_precision_slack late so that their timers
+  // can share wakeups, high precision tasks are released as close to their
+  // deadline as the platform timer allows.
+  void PostDelayedTask(absl::AnyInvocable<void() &&> task, TimeDelta delay) {
+    PostDelayedTaskImpl(std::move(task), delay, DelayPrecision::kLow);
+  }
+  void PostDelayedHighPrecisionTask(absl::AnyInvocable<void() &&> task, TimeDelta delay) {
+    PostDelayedTaskImpl(std::move(task), delay, DelayPrecision::kHigh);
+  }
+  void PostDelayedTaskWithPrecision(DelayPrecision precision, absl::AnyInvocable<void() &&> task, TimeDelta delay) {
+    PostDelayedTaskImpl(std::move(task), delay, precision);
+  }
+  void PostDelayedTask(absl::AnyInvocable<void() &&> task, int ms) {
+    PostDelayedTask(std::move(task), TimeDelta::Millis(ms));
+  }
+  void PostDelayedHighPrecisionTask(absl::AnyInvocable<void() &&> task, int ms) {
+    PostDelayedHighPrecisionTask(std::move(task), TimeDelta::Millis(ms));
+  }
   void PostDelayedTaskWithPrecision(DelayPrecision precision, absl::AnyInvocable<void() &&> task, int ms) {
-    switch (precision) {
-      case DelayPrecision::kLow:
-        PostDelayedTask(std::move(task), ms);
-        break;
-      case DelayPrecision::kHigh:
-        PostDelayedHighPrecisionTask(std::move(task), ms);
-        break;
+    PostDelayedTaskWithPrecision(precision, std::move(task), TimeDelta::Millis(ms));
+  }
+  // Same as the above, with the post site shown by TaskTrace, e.g.
+  //   queue->PostTask(std::move(task), Location::Current());
+  void PostTask(absl::AnyInvocable<void() &&> task, const Location& location) {
+    TaskTrace::PostSite site(location);
+    PostTask(std::move(task));
+  }
+  void PostDelayedTask(absl::AnyInvocable<void() &&> task, TimeDelta delay, const Location& location) {
+    TaskTrace::PostSite site(location);
+    PostDelayedTask(std::move(task), delay);
+  }
+  void PostDelayedHighPrecisionTask(absl::AnyInvocable<void() &&> task, TimeDelta delay, const Location& location) {
+    TaskTrace::PostSite site(location);
+    PostDelayedHighPrecisionTask(std::move(task), delay);
+  }
+  // Like PostDelayedTaskWithPrecision, but the returned handle can cancel the
+  // task until it starts running. Cancelling frees the closure immediately
+  // instead of keeping it alive until the deadline.
+  TaskHandle PostCancelableDelayedTask(absl::AnyInvocable<void() &&> task, TimeDelta delay,
+                                       DelayPrecision precision = DelayPrecision::kLow);
+  // Lower priority lanes of the same queue, for housekeeping that must not
+  // delay latency-critical tasks. A low priority task runs once no normal task
+  // or due timer is waiting, and in a bounded slice of every loop iteration
+  // (TaskQueueOptions::low_priority_budget) so that a busy queue cannot starve
+  // it. An idle task runs only when the queue has nothing else to do. Once
+  // `deadline` has passed, either kind is promoted and runs ahead of its lane.
+  // Each lane runs in posting order. Queues without lanes run them as normal
+  // tasks.
+  void PostLowPriorityTask(absl::AnyInvocable<void() &&> task, TimeDelta deadline = TimeDelta::PlusInfinity()) {
+    PostLaneTaskImpl(TaskLane::kLowPriority, std::move(task), deadline);
+  }
+  void PostIdleTask(absl::AnyInvocable<void() &&> task, TimeDelta deadline = TimeDelta::PlusInfinity()) {
+    PostLaneTaskImpl(TaskLane::kIdle, std::move(task), deadline);
+  }
+  // For queues bounded by TaskQueueOptions::capacity: posts `task` if the
+  // queue has room, otherwise drops it and returns false. Never waits or
+  // sheds other tasks, whatever the overflow policy. Unbounded queues always
+  // accept.
+  bool TryPostTask(absl::AnyInvocable<void() &&> task) {
+    return TryPostTaskImpl(std::move(task));
+  }
+  // Posts a task that a full queue with OverflowPolicy::kDropOldestDroppable
+  // may drop, before it starts, to make room for a newer task; for work
+  // superseded by later posts, such as a stale frame. A normal task
+  // otherwise.
+  void PostDroppableTask(absl::AnyInvocable<void() &&> task) {
+    PostDroppableTaskImpl(std::move(task));
+  }
+  // Calls `callback` on this queue whenever `fd` is ready for any of
+  // `events`, with the events that are ready. Readiness comes from the same
+  // wait that services the queue's tasks and timers, so I/O is handled
+  // without a thread hop. Level triggered: the callback runs again on the
+  // next iteration while `fd` stays ready, so it should read until the
+  // descriptor would block; `fd` must be non-blocking. On Windows,
+  // kFdWritable follows WSAEventSelect() and is reported once after a send
+  // failed with WSAEWOULDBLOCK. Returns false if `fd` is already watched or
+  // cannot be; only the Linux and Windows queues watch descriptors, the
+  // latter up to 61 sockets. Called from another thread, this waits for the
+  // queue to register `fd`.
+  bool RegisterFd(NativeFd fd, int events, absl::AnyInvocable<void(int events)> callback);
+  // Stops watching `fd` and destroys its callback. No call follows once this
+  // returns, even for readiness already seen; may be called from a callback.
+  // Must be called before `fd` is closed.
+  void UnregisterFd(NativeFd fd);
+  // Statistics of a queue created with TaskQueueOptions::enable_metrics, or
+  // nullopt. Safe to poll from any thread.
+  virtual absl::optional<TaskQueueStats> GetStats() const { return absl::nullopt; }
+  // Runs `functor` on this queue and returns its result once it has run, or
+  // runs it inline when called on the queue itself. The caller waits on an
+  // event of its thread, reused by all its calls, and the result is passed
+  // back through the caller's stack, so a call does not allocate. Debug
+  // builds abort on a call that would close a cycle of queues waiting for
+  // each other. The queue must not be deleted before it runs `functor`. A
+  // pool queue blocks its worker thread for the duration of the call.
+  template <typename Functor, typename ReturnT = std::invoke_result_t<Functor>>
+  ReturnT BlockingCall(Functor&& functor) {
+    if constexpr (std::is_void_v<ReturnT>) {
+      BlockingCallImpl(functor);
+    } else {
+      absl::optional<ReturnT> result;
+      BlockingCallImpl([&] { result.emplace(std::forward<Functor>(functor)()); });
+      return std::move(*result);
     }
   }
   static TaskQueueBase* Current();
   bool IsCurrent() const { return Current() == this; }
  protected:
+  virtual void PostDelayedTaskImpl(absl::AnyInvocable<void() &&> task, TimeDelta delay, DelayPrecision precision); // override
+  // The default posts a plain delayed task that skips the cancelled closure;
+  // queues with a DelayedTaskStore override it to drop the entry as well.
+  virtual void PostCancelableDelayedTaskImpl(rtc::scoped_refptr<CancelableTaskState> task, TimeDelta delay, DelayPrecision precision);
+  // The default posts the tasks one by one.
+  virtual void PostTasksImpl(std::vector<BatchedTask> tasks);
+  // The default hands the closure to PostTask(AnyInvocable), which allocates.
+  virtual void PostQueuedClosureImpl(QueuedClosure task);
+  // The defaults post a normal task, for queues without a capacity limit.
+  virtual bool TryPostTaskImpl(absl::AnyInvocable<void() &&> task);
+  virtual void PostDroppableTaskImpl(absl::AnyInvocable<void() &&> task);
+  // Called on the queue. The defaults watch nothing.
+  virtual bool RegisterFdImpl(NativeFd fd, int events, absl::AnyInvocable<void(int events)> callback);
+  virtual void UnregisterFdImpl(NativeFd fd);
+  // The default posts a normal task.
+  virtual void PostLaneTaskImpl(TaskLane lane, absl::AnyInvocable<void() &&> task, TimeDelta deadline);
   class CurrentTaskQueueSetter {
    public:
     explicit CurrentTaskQueueSetter(TaskQueueBase* task_queue);
@@ -50,6 +220,8 @@ class TaskQueueBase {
    private:
     TaskQueueBase* const previous_;
   };
+  // The default posts `functor` and waits for the queue's thread to run it.
+  virtual void BlockingCallImpl(absl::FunctionRef<void()> functor);
   virtual ~TaskQueueBase() = default;
 };
 
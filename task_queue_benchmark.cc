@@ -0,0 +1,390 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+// Task queue benchmarks. Every scenario runs against every factory and
+// prints one JSON object per line:
+//
+//   {"factory":"linux","scenario":"ping_pong","unit":"us","count":10000,
+//    "mean":12.3,"p50":11,"p90":14,"p99":25,"p999":60,"max":130}
+//
+// Scenarios that measure throughput add "throughput_per_s". Flags:
+//   --quick             fewer iterations, for smoke testing
+//   --factory=<name>    only run factories whose name contains <name>
+//   --scenario=<name>   only run scenarios whose name contains <name>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "event.h"
+#include "task_queue_factory.h"
+#include "task_queue_options.h"
+#include "task_queue_pool.h"
+#include "time_utils.h"
+#if defined(_WIN32)
+#include "task_queue_win.h"
+#else
+#include "task_queue_linux.h"
+#endif
+
+namespace webrtc {
+namespace {
+
+using TaskQueuePtr = std::unique_ptr<TaskQueueBase, TaskQueueDeleter>;
+
+struct Config {
+  bool quick = false;
+  std::string factory_filter;
+  std::string scenario_filter;
+};
+
+struct NamedFactory {
+  std::string name;
+  std::unique_ptr<TaskQueueFactory> factory;
+};
+
+std::vector<NamedFactory> CreateFactories() {
+  const TaskQueueOptions wheel = TaskQueueOptions().SetDelayedTaskPolicy(DelayedTaskPolicy::kTimingWheel);
+  const TaskQueueOptions spin = TaskQueueOptions().SetHighPrecisionSpin(TimeDelta::Millis(1), 0.2);
+  const TaskQueueOptions cache = TaskQueueOptions().SetThreadCacheSize(4);
+  std::vector<NamedFactory> factories;
+#if defined(_WIN32)
+  factories.push_back({"win", CreateTaskQueueWinFactory()});
+  factories.push_back({"win_wheel", CreateTaskQueueWinFactory(wheel)});
+  factories.push_back({"win_spin", CreateTaskQueueWinFactory(spin)});
+  factories.push_back({"win_cache", CreateTaskQueueWinFactory(cache)});
+#else
+  factories.push_back({"linux", CreateTaskQueueLinuxFactory()});
+  factories.push_back({"linux_wheel", CreateTaskQueueLinuxFactory(wheel)});
+  factories.push_back({"linux_spin", CreateTaskQueueLinuxFactory(spin)});
+  factories.push_back({"linux_cache", CreateTaskQueueLinuxFactory(cache)});
+#endif
+  factories.push_back({"pool", CreateTaskQueuePoolFactory()});
+  factories.push_back({"pool_wheel", CreateTaskQueuePoolFactory(0, wheel)});
+  return factories;
+}
+
+// Nearest-rank percentile of sorted `samples`.
+double Percentile(const std::vector<double>& samples, double fraction) {
+  if (samples.empty())
+    return 0;
+  size_t rank = static_cast<size_t>(fraction * samples.size() + 0.999999);
+  rank = std::min(std::max<size_t>(rank, 1), samples.size());
+  return samples[rank - 1];
+}
+
+void Report(const std::string& factory, const std::string& scenario, const char* unit,
+            std::vector<double> samples, double throughput_per_s = -1) {
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (double sample : samples)
+    sum += sample;
+  printf("{\"factory\":\"%s\",\"scenario\":\"%s\",\"unit\":\"%s\",\"count\":%zu,"
+         "\"mean\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"p999\":%.3f,\"max\":%.3f",
+         factory.c_str(), scenario.c_str(), unit, samples.size(),
+         samples.empty() ? 0.0 : sum / samples.size(), Percentile(samples, 0.5),
+         Percentile(samples, 0.9), Percentile(samples, 0.99), Percentile(samples, 0.999),
+         samples.empty() ? 0.0 : samples.back());
+  if (throughput_per_s >= 0)
+    printf(",\"throughput_per_s\":%.1f", throughput_per_s);
+  printf("}\n");
+  fflush(stdout);
+}
+
+// Posts tasks from `producers` threads at once. Samples are the cost of one
+// PostTask call, averaged over chunks of kChunk posts; the throughput covers
+// the time until the queue has run the last task.
+void PostThroughput(const NamedFactory& factory, const Config& config, int producers) {
+  constexpr int kChunk = 1000;
+  const int per_producer = (config.quick ? 20000 : 1000000) / producers;
+  TaskQueuePtr queue = factory.factory->CreateTaskQueue("bench", TaskQueueFactory::Priority::NORMAL);
+  std::atomic<int> remaining(per_producer * producers);
+  rtc::Event done;
+  std::vector<std::vector<double>> samples(producers);
+  std::atomic<int> ready(0);
+  std::atomic<bool> go(false);
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      ready.fetch_add(1);
+      while (!go.load(std::memory_order_acquire)) {
+      }
+      for (int posted = 0; posted < per_producer; posted += kChunk) {
+        const int64_t start = rtc::TimeMicros();
+        for (int i = 0; i < kChunk; ++i) {
+          queue->PostTask([&] {
+            if (remaining.fetch_sub(1, std::memory_order_relaxed) == 1)
+              done.Set();
+          });
+        }
+        samples[p].push_back((rtc::TimeMicros() - start) * 1000.0 / kChunk);
+      }
+    });
+  }
+  while (ready.load() < producers) {
+  }
+  const int64_t start = rtc::TimeMicros();
+  go.store(true, std::memory_order_release);
+  done.Wait(rtc::Event::kForever);
+  const int64_t elapsed_us = std::max<int64_t>(rtc::TimeMicros() - start, 1);
+  for (auto& thread : threads)
+    thread.join();
+  std::vector<double> all;
+  for (auto& producer_samples : samples)
+    all.insert(all.end(), producer_samples.begin(), producer_samples.end());
+  Report(factory.name, "post_throughput_" + std::to_string(producers) + "p", "ns_per_post", std::move(all),
+         per_producer * producers * 1e6 / elapsed_us);
+}
+
+// A task bounces between two queues; each sample is one round trip.
+void PingPong(const NamedFactory& factory, const Config& config) {
+  const int rounds = config.quick ? 1000 : 20000;
+  TaskQueuePtr ping = factory.factory->CreateTaskQueue("ping", TaskQueueFactory::Priority::NORMAL);
+  TaskQueuePtr pong = factory.factory->CreateTaskQueue("pong", TaskQueueFactory::Priority::NORMAL);
+  std::vector<double> samples;
+  samples.reserve(rounds);
+  rtc::Event done;
+  int64_t round_start = 0;
+  std::function<void()> serve;
+  serve = [&] {
+    round_start = rtc::TimeMicros();
+    pong->PostTask([&] {
+      ping->PostTask([&] {
+        samples.push_back(static_cast<double>(rtc::TimeMicros() - round_start));
+        if (static_cast<int>(samples.size()) == rounds)
+          done.Set();
+        else
+          serve();
+      });
+    });
+  };
+  ping->PostTask([&] { serve(); });
+  done.Wait(rtc::Event::kForever);
+  Report(factory.name, "ping_pong", "us", std::move(samples));
+}
+
+// BlockingCall round trips from a plain thread to an idle queue.
+void BlockingCall(const NamedFactory& factory, const Config& config) {
+  const int calls = config.quick ? 1000 : 20000;
+  TaskQueuePtr queue = factory.factory->CreateTaskQueue("callee", TaskQueueFactory::Priority::NORMAL);
+  std::vector<double> samples;
+  samples.reserve(calls);
+  for (int i = 0; i < calls; ++i) {
+    const int64_t start = rtc::TimeMicros();
+    queue->BlockingCall([i] { return i; });
+    samples.push_back(static_cast<double>(rtc::TimeMicros() - start));
+  }
+  Report(factory.name, "blocking_call", "us", std::move(samples));
+}
+
+// Lateness of a delayed task posted to an idle queue, one timer at a time.
+void TimerAccuracy(const NamedFactory& factory, const Config& config, int delay_ms,
+                   TaskQueueBase::DelayPrecision precision) {
+  const int budget_ms = config.quick ? 100 : 2000;
+  const int iterations = std::max(5, std::min(200, budget_ms / delay_ms));
+  TaskQueuePtr queue = factory.factory->CreateTaskQueue("timer", TaskQueueFactory::Priority::NORMAL);
+  std::vector<double> samples;
+  rtc::Event fired;
+  for (int i = 0; i < iterations; ++i) {
+    int64_t ran_at = 0;
+    const int64_t posted_at = rtc::TimeMicros();
+    queue->PostDelayedTaskWithPrecision(precision, [&] {
+      ran_at = rtc::TimeMicros();
+      fired.Set();
+    }, TimeDelta::Millis(delay_ms));
+    fired.Wait(rtc::Event::kForever);
+    samples.push_back(static_cast<double>(ran_at - posted_at - delay_ms * 1000));
+  }
+  Report(factory.name,
+         "timer_" + std::to_string(delay_ms) + "ms_" +
+             (precision == TaskQueueBase::DelayPrecision::kHigh ? "high" : "low"),
+         "us_late", std::move(samples));
+}
+
+// CPU time of the whole process so far.
+int64_t ProcessCpuTimeUs() {
+#if defined(_WIN32)
+  FILETIME creation, exit, kernel, user;
+  ::GetProcessTimes(::GetCurrentProcess(), &creation, &exit, &kernel, &user);
+  auto us = [](const FILETIME& time) {
+    return ((static_cast<int64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 10;
+  };
+  return us(kernel) + us(user);
+#else
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+// High precision timers back to back, each posted by the previous one, as a
+// periodic media task would. Reports their lateness and the CPU the process
+// used meanwhile as a share of one core; with a spinning factory the latter
+// shows the spin budget at work.
+void HighPrecisionTrain(const NamedFactory& factory, const Config& config, int delay_ms) {
+  const int iterations = (config.quick ? 200 : 2000) / delay_ms;
+  TaskQueuePtr queue = factory.factory->CreateTaskQueue("train", TaskQueueFactory::Priority::NORMAL);
+  std::vector<double> samples;
+  samples.reserve(iterations);
+  rtc::Event done;
+  int64_t due_us = 0;
+  std::function<void()> next;
+  next = [&] {
+    due_us = rtc::TimeMicros() + delay_ms * 1000;
+    queue->PostDelayedHighPrecisionTask([&] {
+      samples.push_back(static_cast<double>(rtc::TimeMicros() - due_us));
+      if (static_cast<int>(samples.size()) == iterations)
+        done.Set();
+      else
+        next();
+    }, TimeDelta::Millis(delay_ms));
+  };
+  const int64_t start_us = rtc::TimeMicros();
+  const int64_t start_cpu_us = ProcessCpuTimeUs();
+  queue->PostTask([&] { next(); });
+  done.Wait(rtc::Event::kForever);
+  const double cpu_percent =
+      100.0 * (ProcessCpuTimeUs() - start_cpu_us) / std::max<int64_t>(rtc::TimeMicros() - start_us, 1);
+  const std::string name = "high_precision_train_" + std::to_string(delay_ms) + "ms";
+  Report(factory.name, name, "us_late", std::move(samples));
+  Report(factory.name, name + "_cpu", "percent", {cpu_percent});
+}
+
+// Cost of CreateTaskQueue() plus Delete() of a queue that ran one task.
+void CreateDelete(const NamedFactory& factory, const Config& config) {
+  const int iterations = config.quick ? 50 : 500;
+  std::vector<double> create_samples;
+  std::vector<double> delete_samples;
+  for (int i = 0; i < iterations; ++i) {
+    int64_t start = rtc::TimeMicros();
+    TaskQueuePtr queue = factory.factory->CreateTaskQueue("short", TaskQueueFactory::Priority::NORMAL);
+    create_samples.push_back(static_cast<double>(rtc::TimeMicros() - start));
+    rtc::Event ran;
+    queue->PostTask([&] { ran.Set(); });
+    ran.Wait(rtc::Event::kForever);
+    start = rtc::TimeMicros();
+    queue = nullptr;
+    delete_samples.push_back(static_cast<double>(rtc::TimeMicros() - start));
+  }
+  Report(factory.name, "create_queue", "us", std::move(create_samples));
+  Report(factory.name, "delete_queue", "us", std::move(delete_samples));
+}
+
+// 10k delayed tasks spread over one second are outstanding at once. Reports
+// the cost of posting them, per post averaged over chunks, and how late each
+// one fires.
+void OutstandingTimers(const NamedFactory& factory, const Config& config) {
+  const int timers = config.quick ? 2000 : 10000;
+  const int spread_ms = config.quick ? 200 : 1000;
+  TaskQueuePtr queue = factory.factory->CreateTaskQueue("timers", TaskQueueFactory::Priority::NORMAL);
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> delay_us(10000, 10000 + spread_ms * 1000);
+  std::vector<int64_t> due(timers);
+  std::vector<int64_t> ran(timers);
+  std::atomic<int> remaining(timers);
+  rtc::Event done;
+  // rtc::TimeMicros() is too coarse to time a single post.
+  constexpr int kChunk = 100;
+  std::vector<double> post_samples;
+  for (int first = 0; first < timers; first += kChunk) {
+    const int64_t start = rtc::TimeMicros();
+    for (int i = first; i < first + kChunk && i < timers; ++i) {
+      const TimeDelta delay = TimeDelta::Micros(delay_us(random));
+      due[i] = rtc::TimeMicros() + delay.us();
+      queue->PostDelayedHighPrecisionTask([&, i] {
+        ran[i] = rtc::TimeMicros();
+        if (remaining.fetch_sub(1) == 1)
+          done.Set();
+      }, delay);
+    }
+    post_samples.push_back((rtc::TimeMicros() - start) * 1000.0 / kChunk);
+  }
+  done.Wait(rtc::Event::kForever);
+  std::vector<double> late_samples(timers);
+  for (int i = 0; i < timers; ++i)
+    late_samples[i] = static_cast<double>(ran[i] - due[i]);
+  Report(factory.name, "outstanding_timers_post", "ns_per_post", std::move(post_samples));
+  Report(factory.name, "outstanding_timers_late", "us_late", std::move(late_samples));
+}
+
+struct Scenario {
+  std::string name;
+  std::function<void(const NamedFactory&, const Config&)> run;
+};
+
+std::vector<Scenario> Scenarios() {
+  const int producers = std::max(2u, std::thread::hardware_concurrency());
+  std::vector<Scenario> scenarios = {
+    {"post_throughput_1p", [](const NamedFactory& f, const Config& c) { PostThroughput(f, c, 1); }},
+    {"post_throughput_np", [producers](const NamedFactory& f, const Config& c) { PostThroughput(f, c, producers); }},
+    {"ping_pong", &PingPong},
+    {"blocking_call", &BlockingCall},
+    {"create_delete", &CreateDelete},
+    {"outstanding_timers", &OutstandingTimers},
+  };
+  // With a 1 ms guard, 10 ms timers ask for about a tenth of a core of
+  // spinning and 2 ms timers for half, more than the default budget.
+  for (int delay_ms : {2, 10}) {
+    scenarios.push_back({"high_precision_train_" + std::to_string(delay_ms) + "ms",
+                         [delay_ms](const NamedFactory& f, const Config& c) { HighPrecisionTrain(f, c, delay_ms); }});
+  }
+  for (int delay_ms : {1, 5, 100}) {
+    for (auto precision : {TaskQueueBase::DelayPrecision::kLow, TaskQueueBase::DelayPrecision::kHigh}) {
+      const char* suffix = precision == TaskQueueBase::DelayPrecision::kHigh ? "high" : "low";
+      scenarios.push_back({"timer_" + std::to_string(delay_ms) + "ms_" + suffix, [delay_ms, precision](const NamedFactory& f, const Config& c) {
+        TimerAccuracy(f, c, delay_ms, precision);
+      }});
+    }
+  }
+  return scenarios;
+}
+
+}  // namespace
+}  // namespace webrtc
+
+int main(int argc, char* argv[]) {
+  webrtc::Config config;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--quick") == 0) {
+      config.quick = true;
+    } else if (strncmp(argv[i], "--factory=", 10) == 0) {
+      config.factory_filter = argv[i] + 10;
+    } else if (strncmp(argv[i], "--scenario=", 11) == 0) {
+      config.scenario_filter = argv[i] + 11;
+    } else {
+      fprintf(stderr, "usage: %s [--quick] [--factory=<name>] [--scenario=<name>]\n", argv[0]);
+      return 1;
+    }
+  }
+  for (const webrtc::NamedFactory& factory : webrtc::CreateFactories()) {
+    if (factory.name.find(config.factory_filter) == std::string::npos)
+      continue;
+    for (const webrtc::Scenario& scenario : webrtc::Scenarios()) {
+      if (scenario.name.find(config.scenario_filter) == std::string::npos)
+        continue;
+      scenario.run(factory, config);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_queue_coroutine.h"
+
+#include <stddef.h>
+
+#include <new>
+
+#include "task_node_pool.h"
+
+namespace webrtc {
+namespace coroutine_internal {
+namespace {
+
+template <size_t N>
+struct FrameBlock {
+  alignas(std::max_align_t) unsigned char bytes[N];
+};
+
+// Frames can outlive the queue that created them and are often freed on
+// another queue's thread, so the pools are process-wide rather than per queue.
+// They are never destroyed, which keeps frames freed during static
+// destruction valid.
+template <size_t N>
+TaskNodePool<FrameBlock<N>>& FramePool() {
+  static auto* const pool = new TaskNodePool<FrameBlock<N>>();
+  return *pool;
+}
+
+// Fire-and-forget wrapper for RunDetached: starts right away and frees its
+// frame when it runs off the end.
+struct Detached {
+  struct promise_type : PooledFrame {
+    Detached get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+Detached Await(Task<> task) {
+  co_await std::move(task);
+}
+
+}  // namespace
+
+void* AllocateCoroutineFrame(size_t size) {
+  if (size <= 128)
+    return FramePool<128>().New();
+  if (size <= 256)
+    return FramePool<256>().New();
+  if (size <= 512)
+    return FramePool<512>().New();
+  if (size <= 1024)
+    return FramePool<1024>().New();
+  return ::operator new(size);
+}
+
+void FreeCoroutineFrame(void* frame, size_t size) {
+  if (size <= 128)
+    FramePool<128>().Delete(static_cast<FrameBlock<128>*>(frame));
+  else if (size <= 256)
+    FramePool<256>().Delete(static_cast<FrameBlock<256>*>(frame));
+  else if (size <= 512)
+    FramePool<512>().Delete(static_cast<FrameBlock<512>*>(frame));
+  else if (size <= 1024)
+    FramePool<1024>().Delete(static_cast<FrameBlock<1024>*>(frame));
+  else
+    ::operator delete(frame);
+}
+
+}  // namespace coroutine_internal
+
+void RunDetached(TaskQueueBase* queue, Task<> task) {
+  queue->PostTask([task = std::move(task)]() mutable { coroutine_internal::Await(std::move(task)); });
+}
+
+}  // namespace webrtc
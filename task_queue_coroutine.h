@@ -0,0 +1,207 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_TASK_QUEUE_COROUTINE_H_
+#define RTC_BASE_TASK_QUEUE_COROUTINE_H_
+
+#include <stddef.h>
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+#include "absl/types/optional.h"
+#include "task_queue_base.h"
+#include "time_delta.h"
+
+// C++20 coroutines on top of TaskQueueBase.
+//
+//   Task<int> FetchCount(TaskQueueBase* worker) {
+//     co_await SwitchTo(worker);            // now running on `worker`
+//     co_await SleepFor(TimeDelta::Millis(10));
+//     co_return 42;
+//   }
+//
+//   Task<> Signaling::Negotiate() {
+//     int count = co_await FetchCount(worker_);  // back on the caller's queue
+//     ...
+//   }
+//
+//   RunDetached(signaling_queue, signaling->Negotiate());
+//
+// Every hop between queues is a single PostTask of a closure that only holds
+// the coroutine handle, so it takes a node from the queue's node pool and does
+// not allocate. Coroutine frames come from process-wide size class pools, see
+// AllocateCoroutineFrame().
+//
+// A coroutine suspended on a queue that is deleted before the hop runs is
+// never resumed and its frame is not released; as with tasks capturing
+// `this`, code must keep its queues alive while coroutines await on them.
+
+namespace webrtc {
+namespace coroutine_internal {
+
+// Frames of at most 1 KiB are carved out of per-size-class node pools; larger
+// frames come from the heap. Thread safe.
+void* AllocateCoroutineFrame(size_t size);
+void FreeCoroutineFrame(void* frame, size_t size);
+
+// Promise mixin that routes frame allocation through the pools.
+struct PooledFrame {
+  static void* operator new(size_t size) { return AllocateCoroutineFrame(size); }
+  static void operator delete(void* frame, size_t size) { FreeCoroutineFrame(frame, size); }
+};
+
+// The task posted for a hop; fits the inline buffer of QueuedClosure.
+struct Resume {
+  std::coroutine_handle<> handle;
+  void operator()() const { handle.resume(); }
+};
+
+class TaskPromiseBase : public PooledFrame {
+ public:
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  auto final_suspend() noexcept { return FinalAwaiter(); }
+  // Built without exceptions like the rest of the task queue code.
+  void unhandled_exception() noexcept { std::terminate(); }
+
+  void SetCaller(std::coroutine_handle<> caller, TaskQueueBase* queue) {
+    caller_ = caller;
+    caller_queue_ = queue;
+  }
+
+ private:
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> finished) noexcept {
+      // Once the hop is posted the caller may resume and destroy this frame
+      // on its queue, so nothing here may be touched afterwards.
+      TaskPromiseBase& promise = finished.promise();
+      std::coroutine_handle<> caller = promise.caller_;
+      TaskQueueBase* queue = promise.caller_queue_;
+      if (queue == nullptr || queue->IsCurrent())
+        return caller;
+      queue->PostTask(Resume{caller});
+      return std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+
+  std::coroutine_handle<> caller_;
+  TaskQueueBase* caller_queue_ = nullptr;
+};
+
+template <typename T>
+class TaskPromise;
+
+}  // namespace coroutine_internal
+
+// A lazily started coroutine producing a T. It starts when awaited, and the
+// awaiting coroutine resumes on the queue it was running on when it awaited
+// (TaskQueueBase::Current()), wherever the task finished. Owns its frame.
+template <typename T = void>
+class [[nodiscard]] Task {
+ public:
+  using promise_type = coroutine_internal::TaskPromise<T>;
+
+  Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      if (handle_)
+        handle_.destroy();
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+  ~Task() {
+    if (handle_)
+      handle_.destroy();
+  }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+    handle_.promise().SetCaller(caller, TaskQueueBase::Current());
+    return handle_;
+  }
+  T await_resume() { return handle_.promise().TakeResult(); }
+
+ private:
+  friend promise_type;
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+namespace coroutine_internal {
+
+template <typename T>
+class TaskPromise : public TaskPromiseBase {
+ public:
+  Task<T> get_return_object() { return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this)); }
+  template <typename U>
+  void return_value(U&& value) {
+    result_.emplace(std::forward<U>(value));
+  }
+  T TakeResult() { return std::move(*result_); }
+
+ private:
+  absl::optional<T> result_;
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase {
+ public:
+  Task<void> get_return_object() { return Task<void>(std::coroutine_handle<TaskPromise>::from_promise(*this)); }
+  void return_void() {}
+  void TakeResult() {}
+};
+
+}  // namespace coroutine_internal
+
+// co_await SwitchTo(queue) continues the coroutine on `queue`. Completes
+// without a hop if the coroutine already runs there.
+class SwitchTo {
+ public:
+  explicit SwitchTo(TaskQueueBase* queue) : queue_(queue) {}
+  bool await_ready() const { return queue_->IsCurrent(); }
+  void await_suspend(std::coroutine_handle<> handle) { queue_->PostTask(coroutine_internal::Resume{handle}); }
+  void await_resume() {}
+
+ private:
+  TaskQueueBase* const queue_;
+};
+
+// co_await SleepFor(delay) suspends the coroutine for `delay` through
+// PostDelayedTaskWithPrecision on the current queue; it must be awaited on a
+// task queue.
+class SleepFor {
+ public:
+  explicit SleepFor(TimeDelta delay,
+                    TaskQueueBase::DelayPrecision precision = TaskQueueBase::DelayPrecision::kLow)
+    : delay_(delay), precision_(precision) {}
+  bool await_ready() const { return delay_ <= TimeDelta::Zero(); }
+  void await_suspend(std::coroutine_handle<> handle) {
+    TaskQueueBase::Current()->PostDelayedTaskWithPrecision(precision_, coroutine_internal::Resume{handle}, delay_);
+  }
+  void await_resume() {}
+
+ private:
+  const TimeDelta delay_;
+  const TaskQueueBase::DelayPrecision precision_;
+};
+
+// Starts `task` on `queue` without waiting for it. Its frame, and the frames
+// of the tasks it awaits, are released when it completes.
+void RunDetached(TaskQueueBase* queue, Task<> task);
+
+}  // namespace webrtc
+#endif  // RTC_BASE_TASK_QUEUE_COROUTINE_H_
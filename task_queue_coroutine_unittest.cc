@@ -0,0 +1,146 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_queue_coroutine.h"
+
+#include <coroutine>
+#include <memory>
+#include <set>
+
+#include "event.h"
+#include "gtest/gtest.h"
+#include "task_queue_base.h"
+#include "task_queue_factory.h"
+#include "task_queue_for_test.h"
+#include "time_delta.h"
+#include "time_utils.h"
+#include "timestamp.h"
+
+namespace webrtc {
+namespace {
+
+constexpr int kTimeoutMs = 5000;
+
+// Waits for the tasks already posted to `queue` to run.
+void Flush(TaskQueueBase* queue) {
+  rtc::Event done;
+  queue->PostTask([&done] { done.Set(); });
+  ASSERT_TRUE(done.Wait(kTimeoutMs));
+}
+
+struct Result {
+  bool on_start_queue = false;
+  bool on_target_queue = false;
+  int value = 0;
+  TimeDelta slept = TimeDelta::Zero();
+  rtc::Event done;
+};
+
+Task<> SwitchBetween(TaskQueueBase* start, TaskQueueBase* target, Result* result) {
+  result->on_start_queue = start->IsCurrent();
+  co_await SwitchTo(target);
+  result->on_target_queue = target->IsCurrent() && !start->IsCurrent();
+  result->done.Set();
+}
+
+TEST(TaskQueueCoroutineTest, SwitchToContinuesOnTheTargetQueue) {
+  auto factory = CreateNativeTaskQueueFactory();
+  auto start = factory->CreateTaskQueue("start", TaskQueueFactory::Priority::NORMAL);
+  auto target = factory->CreateTaskQueue("target", TaskQueueFactory::Priority::NORMAL);
+  Result result;
+  RunDetached(start.get(), SwitchBetween(start.get(), target.get(), &result));
+  ASSERT_TRUE(result.done.Wait(kTimeoutMs));
+  EXPECT_TRUE(result.on_start_queue);
+  EXPECT_TRUE(result.on_target_queue);
+}
+
+Task<int> AnswerOn(TaskQueueBase* worker) {
+  co_await SwitchTo(worker);
+  co_return worker->IsCurrent() ? 42 : -1;
+}
+
+Task<> AwaitAnswer(TaskQueueBase* caller, TaskQueueBase* worker, Result* result) {
+  result->value = co_await AnswerOn(worker);
+  result->on_start_queue = caller->IsCurrent() && !worker->IsCurrent();
+  result->done.Set();
+}
+
+TEST(TaskQueueCoroutineTest, AwaitedTaskResumesTheCallerOnItsQueue) {
+  auto factory = CreateNativeTaskQueueFactory();
+  auto caller = factory->CreateTaskQueue("caller", TaskQueueFactory::Priority::NORMAL);
+  auto worker = factory->CreateTaskQueue("worker", TaskQueueFactory::Priority::NORMAL);
+  Result result;
+  RunDetached(caller.get(), AwaitAnswer(caller.get(), worker.get(), &result));
+  ASSERT_TRUE(result.done.Wait(kTimeoutMs));
+  EXPECT_EQ(result.value, 42);
+  EXPECT_TRUE(result.on_start_queue);
+}
+
+Task<> Sleep(TaskQueueBase* queue, TimeDelta delay, Result* result) {
+  const Timestamp start = rtc::CurrentTimestamp();
+  co_await SleepFor(delay);
+  result->slept = rtc::CurrentTimestamp() - start;
+  result->on_start_queue = queue->IsCurrent();
+  result->done.Set();
+}
+
+TEST(TaskQueueCoroutineTest, SleepForWaitsAtLeastItsDelay) {
+  constexpr TimeDelta kDelay = TimeDelta::Millis(20);
+  auto factory = CreateNativeTaskQueueFactory();
+  auto queue = factory->CreateTaskQueue("sleeper", TaskQueueFactory::Priority::NORMAL);
+  Result result;
+  RunDetached(queue.get(), Sleep(queue.get(), kDelay, &result));
+  ASSERT_TRUE(result.done.Wait(kTimeoutMs));
+  EXPECT_GE(result.slept, kDelay);
+  EXPECT_TRUE(result.on_start_queue);
+}
+
+// Stores the address of the awaiting coroutine's frame, without suspending.
+struct FrameAddress {
+  void** address;
+  bool await_ready() const { return false; }
+  bool await_suspend(std::coroutine_handle<> handle) {
+    *address = handle.address();
+    return false;
+  }
+  void await_resume() {}
+};
+
+// `alive` lives in the frame, as a copy of the argument.
+Task<> HoldUntilDone(std::shared_ptr<int> alive, TaskQueueBase* worker, void** frame) {
+  co_await FrameAddress{frame};
+  co_await SwitchTo(worker);
+}
+
+TEST(TaskQueueCoroutineTest, FramesGoBackToThePoolWhenDone) {
+  auto factory = CreateNativeTaskQueueFactory();
+  auto queue = factory->CreateTaskQueue("frames", TaskQueueFactory::Priority::NORMAL);
+  auto worker = factory->CreateTaskQueue("worker", TaskQueueFactory::Priority::NORMAL);
+  std::set<void*> frames;
+  for (int i = 0; i < 20; ++i) {
+    auto alive = std::make_shared<int>(0);
+    std::weak_ptr<int> watch = alive;
+    void* frame = nullptr;
+    RunDetached(queue.get(), HoldUntilDone(std::move(alive), worker.get(), &frame));
+    // The task finishes on `worker` and hops back to `queue`, where its frame
+    // and the frame awaiting it are released.
+    Flush(queue.get());
+    Flush(worker.get());
+    Flush(queue.get());
+    EXPECT_TRUE(watch.expired());
+    ASSERT_NE(frame, nullptr);
+    frames.insert(frame);
+  }
+  // The pool hands out the frames it got back rather than new ones: the
+  // task's and, at most, the one of RunDetached's wrapper.
+  EXPECT_LE(frames.size(), 2u);
+}
+
+}  // namespace
+}  // namespace webrtc
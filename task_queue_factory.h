@@ -13,6 +13,7 @@
 #include <memory>
 
 #include "absl/strings/string_view.h"
+#include "platform_thread.h"
 #include "task_queue_base.h"
 
 namespace webrtc {
@@ -23,6 +24,16 @@ class TaskQueueFactory {
   virtual std::unique_ptr<TaskQueueBase, TaskQueueDeleter> CreateTaskQueue(
       absl::string_view name,
       Priority priority) const = 0;
+  // Also places and schedules the queue's thread as `attributes` say: CPU
+  // set, NUMA node and scheduling class. The thread priority still follows
+  // `priority`, unless an explicit scheduling policy overrides it. Factories
+  // whose queues have no thread of their own ignore `attributes`.
+  virtual std::unique_ptr<TaskQueueBase, TaskQueueDeleter> CreateTaskQueue(
+      absl::string_view name,
+      Priority priority,
+      const rtc::ThreadAttributes& attributes) const {
+    return CreateTaskQueue(name, priority);
+  }
 };
 }  // namespace webrtc
 #endif  // API_TASK_QUEUE_TASK_QUEUE_FACTORY_H_
\ No newline at end of file
@@ -0,0 +1,39 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_TASK_QUEUE_FOR_TEST_H_
+#define RTC_BASE_TASK_QUEUE_FOR_TEST_H_
+
+#include <memory>
+
+#include "task_queue_factory.h"
+#include "task_queue_options.h"
+#if defined(_WIN32)
+#include "task_queue_win.h"
+#else
+#include "task_queue_linux.h"
+#endif
+
+namespace webrtc {
+
+// Factory of the platform's own queues, one thread per queue, for tests.
+inline std::unique_ptr<TaskQueueFactory> CreateNativeTaskQueueFactory(const TaskQueueOptions& options) {
+#if defined(_WIN32)
+  return CreateTaskQueueWinFactory(options);
+#else
+  return CreateTaskQueueLinuxFactory(options);
+#endif
+}
+
+inline std::unique_ptr<TaskQueueFactory> CreateNativeTaskQueueFactory() {
+  return CreateNativeTaskQueueFactory(TaskQueueOptions());
+}
+
+}  // namespace webrtc
+#endif  // RTC_BASE_TASK_QUEUE_FOR_TEST_H_
@@ -0,0 +1,160 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_queue_limiter.h"
+
+#include <utility>
+
+#include "absl/base/attributes.h"
+
+namespace webrtc {
+namespace {
+ABSL_CONST_INIT thread_local bool must_post = false;
+}  // namespace
+
+TaskQueueLimiter::MustPost::MustPost() : previous_(must_post) {
+  must_post = true;
+}
+
+TaskQueueLimiter::MustPost::~MustPost() {
+  must_post = previous_;
+}
+
+std::unique_ptr<TaskQueueLimiter> TaskQueueLimiter::Create(const TaskQueueCapacity& capacity,
+                                                           absl::string_view queue_name) {
+  if (capacity.max_tasks <= 0 && capacity.max_bytes == 0)
+    return nullptr;
+  return std::make_unique<TaskQueueLimiter>(capacity, queue_name);
+}
+
+TaskQueueLimiter::TaskQueueLimiter(const TaskQueueCapacity& capacity, absl::string_view queue_name)
+  : max_tasks_(capacity.max_tasks > 0 ? capacity.max_tasks : 0),
+    max_bytes_(capacity.max_bytes),
+    policy_(capacity.policy),
+    on_overflow_(capacity.on_overflow),
+    queue_name_(queue_name) {}
+
+bool TaskQueueLimiter::Admit(size_t charge, bool on_queue) {
+  if (closed_.load(std::memory_order_acquire))
+    return false;
+  if (Reserve(charge))
+    return true;
+  if (must_post) {
+    ForceReserve(charge);
+    return true;
+  }
+  switch (policy_) {
+    case OverflowPolicy::kBlock: {
+      if (on_queue) {
+        ForceReserve(charge);
+        return true;
+      }
+      // Release() notifies under the mutex once it sees a waiter, so room
+      // made between a failed Reserve() and the wait is not missed.
+      waiters_.fetch_add(1, std::memory_order_seq_cst);
+      std::unique_lock<std::mutex> lock(mutex_);
+      room_.wait(lock, [this, charge] { return closed_.load(std::memory_order_relaxed) || Reserve(charge); });
+      // Under the mutex, so Close() sees the count drop.
+      const bool closed = closed_.load(std::memory_order_relaxed);
+      if (waiters_.fetch_sub(1, std::memory_order_relaxed) == 1 && closed)
+        room_.notify_all();
+      return !closed;
+    }
+    case OverflowPolicy::kDropNewest:
+      return false;
+    case OverflowPolicy::kDropOldestDroppable:
+      while (DropOldestDroppable()) {
+        if (Reserve(charge))
+          return true;
+      }
+      return false;
+    case OverflowPolicy::kCallback:
+      if (on_overflow_)
+        on_overflow_(queue_name_);
+      return false;
+  }
+  return false;
+}
+
+void TaskQueueLimiter::Close() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  closed_.store(true, std::memory_order_release);
+  room_.notify_all();
+  room_.wait(lock, [this] { return waiters_.load(std::memory_order_relaxed) == 0; });
+}
+
+bool TaskQueueLimiter::TryAdmit(size_t charge) {
+  if (closed_.load(std::memory_order_acquire))
+    return false;
+  if (Reserve(charge))
+    return true;
+  if (must_post) {
+    ForceReserve(charge);
+    return true;
+  }
+  return false;
+}
+
+QueuedClosure TaskQueueLimiter::AdmitDroppable(absl::AnyInvocable<void() &&> task,
+                                               TaskQueueBase* owner,
+                                               size_t node_size,
+                                               bool on_queue) {
+  const size_t charge = node_size + sizeof(CancelableTaskState);
+  if (!Admit(charge, on_queue))
+    return QueuedClosure();
+  rtc::scoped_refptr<CancelableTaskState> state(new CancelableTaskState(std::move(task), owner));
+  {
+    std::lock_guard<std::mutex> lock(droppable_mutex_);
+    while (!droppable_.empty() && !droppable_.front().state->IsPending())
+      droppable_.pop_front();
+    droppable_.push_back({state, charge});
+  }
+  // Whichever of Run() and Cancel() wins credits the task.
+  return QueuedClosure([this, state = std::move(state), charge] {
+    if (state->Run())
+      Release(charge);
+  });
+}
+
+bool TaskQueueLimiter::Reserve(size_t charge) {
+  const int tasks = tasks_.fetch_add(1, std::memory_order_relaxed) + 1;
+  const size_t bytes = bytes_.fetch_add(charge, std::memory_order_relaxed) + charge;
+  if (tasks == 1 || ((max_tasks_ == 0 || tasks <= max_tasks_) && (max_bytes_ == 0 || bytes <= max_bytes_)))
+    return true;
+  // Concurrent posters may see each other's reservation and both fail; one
+  // of the tasks they saw is real, so its Release() wakes any waiter.
+  tasks_.fetch_sub(1, std::memory_order_relaxed);
+  bytes_.fetch_sub(charge, std::memory_order_relaxed);
+  return false;
+}
+
+void TaskQueueLimiter::ForceReserve(size_t charge) {
+  tasks_.fetch_add(1, std::memory_order_relaxed);
+  bytes_.fetch_add(charge, std::memory_order_relaxed);
+}
+
+bool TaskQueueLimiter::DropOldestDroppable() {
+  while (true) {
+    Droppable oldest;
+    {
+      std::lock_guard<std::mutex> lock(droppable_mutex_);
+      if (droppable_.empty())
+        return false;
+      oldest = std::move(droppable_.front());
+      droppable_.pop_front();
+    }
+    // Destroys the closure; the wrapper left in the queue runs empty.
+    if (oldest.state->Cancel()) {
+      Release(oldest.charge);
+      return true;
+    }
+  }
+}
+
+}  // namespace webrtc
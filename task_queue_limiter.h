@@ -0,0 +1,127 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_TASK_QUEUE_LIMITER_H_
+#define RTC_BASE_TASK_QUEUE_LIMITER_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "absl/functional/any_invocable.h"
+#include "absl/strings/string_view.h"
+#include "inline_task.h"
+#include "scoped_refptr.h"
+#include "task_handle.h"
+#include "task_queue_options.h"
+
+namespace webrtc {
+
+class TaskQueueBase;
+
+// Capacity accounting of a queue created with a TaskQueueCapacity. A task is
+// charged when it is posted and credited once it runs or is dropped; the
+// queue carries the charge with the task in between, in its task node or
+// DelayedTaskStore entry. Queues without a limit keep a null pointer and
+// skip every hook.
+class TaskQueueLimiter {
+ public:
+  // Posts made by this thread while a MustPost lives are let through a full
+  // queue, for posters that cannot cope with a dropped task, such as
+  // BlockingCall().
+  class MustPost {
+   public:
+    MustPost();
+    MustPost(const MustPost&) = delete;
+    MustPost& operator=(const MustPost&) = delete;
+    ~MustPost();
+
+   private:
+    const bool previous_;
+  };
+
+  // Null if `capacity` sets no limit.
+  static std::unique_ptr<TaskQueueLimiter> Create(const TaskQueueCapacity& capacity, absl::string_view queue_name);
+
+  TaskQueueLimiter(const TaskQueueCapacity& capacity, absl::string_view queue_name);
+  TaskQueueLimiter(const TaskQueueLimiter&) = delete;
+  TaskQueueLimiter& operator=(const TaskQueueLimiter&) = delete;
+
+  // Charge of a task held in a node of `node_size` bytes.
+  static size_t Charge(size_t node_size, const QueuedClosure& task) { return node_size + task.heap_size(); }
+
+  // Charges a task, applying the overflow policy while the queue is full.
+  // Returns false if the task must be dropped, as it always is once the
+  // limiter is closed. `on_queue` is true for posts from the queue itself,
+  // which never wait.
+  bool Admit(size_t charge, bool on_queue);
+  // Charges a task if the queue has room, for TryPostTask().
+  bool TryAdmit(size_t charge);
+  // Credits a task taken off the queue to run, or dropped.
+  void Release(size_t charge) {
+    if (charge == 0)
+      return;
+    tasks_.fetch_sub(1, std::memory_order_relaxed);
+    bytes_.fetch_sub(charge, std::memory_order_relaxed);
+    if (waiters_.load(std::memory_order_seq_cst) > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      room_.notify_all();
+    }
+  }
+  // Admits a task posted with PostDroppableTask() to a queue whose nodes are
+  // `node_size` bytes, and returns the closure to post in its place, which
+  // carries no charge of its own: the task is credited when it runs or is
+  // dropped to make room. Empty if the task itself was dropped.
+  QueuedClosure AdmitDroppable(absl::AnyInvocable<void() &&> task,
+                               TaskQueueBase* owner,
+                               size_t node_size,
+                               bool on_queue);
+  // Called by Delete() before the limiter goes away. Producers waiting for
+  // room drop their tasks, and are out of the wait when this returns.
+  void Close();
+
+ private:
+  struct Droppable {
+    rtc::scoped_refptr<CancelableTaskState> state;
+    size_t charge = 0;
+  };
+
+  bool Reserve(size_t charge);
+  void ForceReserve(size_t charge);
+  // Drops the oldest droppable task that has not started. Returns false if
+  // there is none.
+  bool DropOldestDroppable();
+
+  const int max_tasks_;
+  const size_t max_bytes_;
+  const OverflowPolicy policy_;
+  const std::function<void(const std::string&)> on_overflow_;
+  const std::string queue_name_;
+  std::atomic<int> tasks_{0};
+  std::atomic<size_t> bytes_{0};
+  // Producers waiting for room under OverflowPolicy::kBlock.
+  std::atomic<int> waiters_{0};
+  std::atomic<bool> closed_{false};
+  std::mutex mutex_;
+  // Signalled when room is made, on Close(), and when the last producer
+  // leaves the wait after it.
+  std::condition_variable room_;
+  // Droppable tasks in posting order. Entries that have run are pruned as
+  // new ones arrive.
+  std::mutex droppable_mutex_;
+  std::deque<Droppable> droppable_;
+};
+
+}  // namespace webrtc
+#endif  // RTC_BASE_TASK_QUEUE_LIMITER_H_
@@ -0,0 +1,192 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_queue_limiter.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "event.h"
+#include "gtest/gtest.h"
+#include "task_queue_factory.h"
+#include "task_queue_for_test.h"
+#include "task_queue_options.h"
+#include "task_queue_pool.h"
+
+namespace webrtc {
+namespace {
+
+constexpr int kTimeoutMs = 5000;
+
+TaskQueueOptions Bounded(OverflowPolicy policy, int max_tasks = 2) {
+  TaskQueueCapacity capacity;
+  capacity.max_tasks = max_tasks;
+  capacity.policy = policy;
+  return TaskQueueOptions().SetCapacity(std::move(capacity));
+}
+
+// Holds the queue in a task until Open(), so that posts pile up. A running
+// task no longer counts against the capacity.
+class Gate {
+ public:
+  explicit Gate(TaskQueueBase* queue) {
+    queue->PostTask([this] {
+      entered_.Set();
+      open_.Wait(rtc::Event::kForever);
+    });
+    entered_.Wait(rtc::Event::kForever);
+  }
+  void Open() { open_.Set(); }
+
+ private:
+  rtc::Event entered_;
+  rtc::Event open_;
+};
+
+// Records the order tasks run in.
+class Log {
+ public:
+  absl::AnyInvocable<void() &&> Task(int id) {
+    return [this, id] {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ran_.push_back(id);
+    };
+  }
+  // Waits for everything posted to `queue` so far. BlockingCall() gets
+  // through a full queue.
+  std::vector<int> Drain(TaskQueueBase* queue) {
+    queue->BlockingCall([] {});
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ran_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<int> ran_;
+};
+
+TEST(TaskQueueLimiterTest, CreatesNoLimiterWithoutLimit) {
+  EXPECT_EQ(TaskQueueLimiter::Create(TaskQueueCapacity(), "queue"), nullptr);
+}
+
+TEST(TaskQueueLimiterTest, DropNewestDropsTasksPostedToAFullQueue) {
+  auto factory = CreateNativeTaskQueueFactory(Bounded(OverflowPolicy::kDropNewest));
+  auto queue = factory->CreateTaskQueue("bounded", TaskQueueFactory::Priority::NORMAL);
+  Log log;
+  Gate gate(queue.get());
+  queue->PostTask(log.Task(1));
+  queue->PostTask(log.Task(2));
+  queue->PostTask(log.Task(3));
+  gate.Open();
+  EXPECT_EQ(log.Drain(queue.get()), (std::vector<int>{1, 2}));
+}
+
+TEST(TaskQueueLimiterTest, CallbackReportsTheQueueAndDropsTheTask) {
+  std::vector<std::string> reported;
+  TaskQueueOptions options = Bounded(OverflowPolicy::kCallback);
+  options.capacity.on_overflow = [&reported](const std::string& name) { reported.push_back(name); };
+  auto factory = CreateNativeTaskQueueFactory(options);
+  auto queue = factory->CreateTaskQueue("bounded", TaskQueueFactory::Priority::NORMAL);
+  Log log;
+  Gate gate(queue.get());
+  queue->PostTask(log.Task(1));
+  queue->PostTask(log.Task(2));
+  queue->PostTask(log.Task(3));
+  EXPECT_EQ(reported, (std::vector<std::string>{"bounded"}));
+  gate.Open();
+  EXPECT_EQ(log.Drain(queue.get()), (std::vector<int>{1, 2}));
+}
+
+TEST(TaskQueueLimiterTest, DropOldestDroppableMakesRoomForNewerTasks) {
+  auto factory = CreateNativeTaskQueueFactory(Bounded(OverflowPolicy::kDropOldestDroppable));
+  auto queue = factory->CreateTaskQueue("bounded", TaskQueueFactory::Priority::NORMAL);
+  Log log;
+  Gate gate(queue.get());
+  queue->PostDroppableTask(log.Task(1));
+  queue->PostTask(log.Task(2));
+  queue->PostTask(log.Task(3));
+  // Nothing droppable is left to shed.
+  queue->PostTask(log.Task(4));
+  gate.Open();
+  EXPECT_EQ(log.Drain(queue.get()), (std::vector<int>{2, 3}));
+}
+
+TEST(TaskQueueLimiterTest, BlockWaitsForRoom) {
+  auto factory = CreateNativeTaskQueueFactory(Bounded(OverflowPolicy::kBlock));
+  auto queue = factory->CreateTaskQueue("bounded", TaskQueueFactory::Priority::NORMAL);
+  Log log;
+  Gate gate(queue.get());
+  queue->PostTask(log.Task(1));
+  queue->PostTask(log.Task(2));
+  rtc::Event posted;
+  std::thread producer([&] {
+    queue->PostTask(log.Task(3));
+    posted.Set();
+  });
+  EXPECT_FALSE(posted.Wait(50));
+  gate.Open();
+  EXPECT_TRUE(posted.Wait(kTimeoutMs));
+  producer.join();
+  EXPECT_EQ(log.Drain(queue.get()), (std::vector<int>{1, 2, 3}));
+}
+
+TEST(TaskQueueLimiterTest, TryPostTaskFailsOnAFullQueueWithoutWaiting) {
+  auto factory = CreateNativeTaskQueueFactory(Bounded(OverflowPolicy::kBlock));
+  auto queue = factory->CreateTaskQueue("bounded", TaskQueueFactory::Priority::NORMAL);
+  Log log;
+  Gate gate(queue.get());
+  EXPECT_TRUE(queue->TryPostTask(log.Task(1)));
+  EXPECT_TRUE(queue->TryPostTask(log.Task(2)));
+  EXPECT_FALSE(queue->TryPostTask(log.Task(3)));
+  gate.Open();
+  EXPECT_EQ(log.Drain(queue.get()), (std::vector<int>{1, 2}));
+}
+
+TEST(TaskQueueLimiterTest, PostDroppableTaskRunsOnAnUnboundedQueue) {
+  auto factory = CreateNativeTaskQueueFactory(TaskQueueOptions());
+  auto queue = factory->CreateTaskQueue("unbounded", TaskQueueFactory::Priority::NORMAL);
+  Log log;
+  queue->PostDroppableTask(log.Task(1));
+  EXPECT_TRUE(queue->TryPostTask(log.Task(2)));
+  EXPECT_EQ(log.Drain(queue.get()), (std::vector<int>{1, 2}));
+}
+
+void ExpectDeleteReleasesBlockedProducer(std::unique_ptr<TaskQueueFactory> factory) {
+  auto queue = factory->CreateTaskQueue("bounded", TaskQueueFactory::Priority::NORMAL);
+  TaskQueueBase* const raw_queue = queue.get();
+  Gate gate(raw_queue);
+  raw_queue->PostTask([] {});
+  raw_queue->PostTask([] {});
+  rtc::Event posted;
+  std::thread producer([&] {
+    raw_queue->PostTask([] { ADD_FAILURE() << "posted to a deleted queue"; });
+    posted.Set();
+  });
+  EXPECT_FALSE(posted.Wait(50));
+  // Delete() waits for the gate task, but lets the producer go first.
+  std::thread deleter([&] { queue.reset(); });
+  EXPECT_TRUE(posted.Wait(kTimeoutMs));
+  gate.Open();
+  deleter.join();
+  producer.join();
+}
+
+TEST(TaskQueueLimiterTest, DeleteReleasesBlockedProducer) {
+  ExpectDeleteReleasesBlockedProducer(CreateNativeTaskQueueFactory(Bounded(OverflowPolicy::kBlock)));
+}
+
+TEST(TaskQueueLimiterTest, PoolDeleteReleasesBlockedProducer) {
+  ExpectDeleteReleasesBlockedProducer(CreateTaskQueuePoolFactory(2, Bounded(OverflowPolicy::kBlock)));
+}
+
+}  // namespace
+}  // namespace webrtc
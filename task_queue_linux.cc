@@ -0,0 +1,662 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "task_queue_linux.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/any_invocable.h"
+#include "absl/strings/string_view.h"
+#include "task_queue_base.h"
+#include "delayed_task_store.h"
+#include "fd_watch_set.h"
+#include "high_precision_spinner.h"
+#include "inline_task.h"
+#include "mpsc_queue.h"
+#include "platform_thread.h"
+#include "run_loop_slice.h"
+#include "task_lanes.h"
+#include "task_node_pool.h"
+#include "task_queue_limiter.h"
+#include "task_queue_metrics.h"
+#include "task_queue_watchdog.h"
+#include "task_trace.h"
+#include "thread_cache.h"
+#include "time_utils.h"
+
+namespace webrtc {
+namespace {
+
+[[noreturn]] void FatalError(absl::string_view queue_name, const char* what) {
+  fprintf(stderr, "TaskQueueLinux %.*s: %s failed: %s\n", static_cast<int>(queue_name.size()), queue_name.data(), what,
+          strerror(errno));
+  abort();
+}
+
+// Readiness reported per epoll_wait(); the rest is reported by the next one.
+constexpr int kMaxEvents = 32;
+
+uint32_t ToEpollEvents(int events) {
+  uint32_t epoll_events = 0;
+  if (events & TaskQueueBase::kFdReadable)
+    epoll_events |= EPOLLIN | EPOLLRDHUP;
+  if (events & TaskQueueBase::kFdWritable)
+    epoll_events |= EPOLLOUT;
+  return epoll_events;
+}
+
+int FromEpollEvents(uint32_t epoll_events) {
+  int events = 0;
+  if (epoll_events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+    events |= TaskQueueBase::kFdReadable;
+  if (epoll_events & EPOLLOUT)
+    events |= TaskQueueBase::kFdWritable;
+  return events;
+}
+
+rtc::ThreadPriority TaskQueuePriorityToThreadPriority(
+  TaskQueueFactory::Priority priority) {
+  switch (priority) {
+  case TaskQueueFactory::Priority::HIGH:
+    return rtc::ThreadPriority::kRealtime;
+  case TaskQueueFactory::Priority::LOW:
+    return rtc::ThreadPriority::kLow;
+  case TaskQueueFactory::Priority::NORMAL:
+    return rtc::ThreadPriority::kNormal;
+  }
+  return rtc::ThreadPriority::kNormal;
+}
+
+// Node carried by the lock-free pending queue. Delayed tasks posted from
+// other threads travel through the same queue and are moved into
+// timer_tasks_ by the queue thread. Nodes come from the queue's
+// TaskNodePool and the closure is stored inline.
+struct PendingTask : public MpscNode {
+  explicit PendingTask(QueuedClosure task) : task(std::move(task)) {}
+  QueuedClosure task;
+  // Set instead of `task` for PostCancelableDelayedTask.
+  rtc::scoped_refptr<CancelableTaskState> cancelable;
+  bool delayed = false;
+  // Set for PostLowPriorityTask and PostIdleTask.
+  TaskQueueBase::TaskLane lane = TaskQueueBase::TaskLane::kNormal;
+  // Earliest time a delayed task may run, and how much later it may run to
+  // share a wakeup with other timers. For a lane task, its deadline.
+  Timestamp due_time = Timestamp::MinusInfinity();
+  TimeDelta slack = TimeDelta::Zero();
+  // Post time of an immediate task, only recorded with metrics enabled.
+  int64_t posted_us = 0;
+  // Flow from the post to the run, only recorded while tracing.
+  uint64_t trace_flow = 0;
+  // Post site of an immediate task, only recorded with a watchdog.
+  const char* posted_from_file = nullptr;
+  int posted_from_line = 0;
+  // Capacity the task holds on a bounded queue.
+  size_t charge = 0;
+};
+
+class TaskQueueLinux : public TaskQueueBase {
+ public:
+  TaskQueueLinux(absl::string_view queue_name,
+                 const rtc::ThreadAttributes& attributes,
+                 const TaskQueueOptions& options,
+                 std::shared_ptr<rtc::ThreadCache> thread_cache,
+                 std::shared_ptr<TaskQueueWatchdog> watchdog);
+  ~TaskQueueLinux() override = default;
+
+  virtual void Delete() override;
+  virtual void PostTask(absl::AnyInvocable<void() &&> task) override;
+  void RunPendingTasks();
+  absl::optional<TaskQueueStats> GetStats() const override;
+ protected:
+  void PostDelayedTaskImpl(absl::AnyInvocable<void() &&> task, TimeDelta delay, DelayPrecision precision) override;
+  void PostCancelableDelayedTaskImpl(rtc::scoped_refptr<CancelableTaskState> task, TimeDelta delay, DelayPrecision precision) override;
+  void PostTasksImpl(std::vector<BatchedTask> tasks) override;
+  void PostQueuedClosureImpl(QueuedClosure task) override;
+  void PostLaneTaskImpl(TaskLane lane, absl::AnyInvocable<void() &&> task, TimeDelta deadline) override;
+  bool TryPostTaskImpl(absl::AnyInvocable<void() &&> task) override;
+  void PostDroppableTaskImpl(absl::AnyInvocable<void() &&> task) override;
+  bool RegisterFdImpl(int fd, int events, absl::AnyInvocable<void(int events)> callback) override;
+  void UnregisterFdImpl(int fd) override;
+ private:
+  bool Admit(PendingTask* task, bool try_only = false);
+  void SetDueTime(PendingTask* task, Timestamp now, TimeDelta delay, DelayPrecision precision) const;
+  void PostDelayedPendingTask(PendingTask* task, TimeDelta delay, DelayPrecision precision);
+  bool InsertDelayedTask(PendingTask* task);
+  void PushPending(PendingTask* task);
+  void RunThreadMain();
+  void Wakeup();
+  bool RunDueTasks();
+  void RunLaneTasks(bool idle);
+  // Work left over from an iteration whose budget ran out. Lane tasks are
+  // not backlog: the idle lane only runs once there is none.
+  bool HasBacklog() const { return carry_ != nullptr || due_next_ < due_tasks_.size(); }
+  void ScheduleNextTimer();
+
+  std::unique_ptr<DelayedTaskStore> timer_tasks_;
+  const TimeDelta low_precision_slack_;
+  HighPrecisionSpinner spinner_;
+  TaskLanes lanes_;
+  const TimeDelta low_priority_budget_;
+  // Due tasks taken from timer_tasks_; those from due_next_ on have not run.
+  std::vector<DelayedTaskStore::DueTask> due_tasks_;
+  size_t due_next_ = 0;
+  // Rest of the pending batch, oldest first, when the immediate task budget
+  // ran out before the batch did.
+  PendingTask* carry_ = nullptr;
+  const RunLoopBudget immediate_task_budget_;
+  const RunLoopBudget timer_budget_;
+  // Descriptors registered with RegisterFd(), in the epoll set next to
+  // wakeup_fd_ and timer_fd_.
+  FdWatchSet fd_watches_;
+  // Null unless TaskQueueOptions::enable_metrics.
+  const std::unique_ptr<TaskQueueMetrics> metrics_;
+  // Null unless TaskQueueOptions::capacity sets a limit.
+  const std::unique_ptr<TaskQueueLimiter> limiter_;
+  // Shared with the factory, which the queue may outlive.
+  const std::shared_ptr<rtc::ThreadCache> thread_cache_;
+  rtc::ThreadCache::Thread* thread_ = nullptr;
+  // Null unless the factory has a watchdog.
+  const std::shared_ptr<TaskQueueWatchdog> watchdog_;
+  TaskQueueWatchdog::Probe* watchdog_probe_ = nullptr;
+  TaskNodePool<PendingTask> task_pool_;
+  MpscQueue<PendingTask> pending_;
+  std::atomic<bool> quit_{false};
+  // All three descriptors are created before the queue thread starts and are
+  // closed only after it has been joined.
+  int epoll_fd_;
+  int wakeup_fd_;
+  int timer_fd_;
+};
+
+TaskQueueLinux::TaskQueueLinux(absl::string_view queue_name,
+                               const rtc::ThreadAttributes& attributes,
+                               const TaskQueueOptions& options,
+                               std::shared_ptr<rtc::ThreadCache> thread_cache,
+                               std::shared_ptr<TaskQueueWatchdog> watchdog)
+  : timer_tasks_(CreateDelayedTaskStore(options.delayed_task_policy)),
+    low_precision_slack_(options.low_precision_slack),
+    spinner_(options.high_precision_spin, options.high_precision_spin_budget),
+    low_priority_budget_(options.low_priority_budget),
+    immediate_task_budget_(options.immediate_task_budget),
+    timer_budget_(options.timer_budget),
+    metrics_(options.enable_metrics ? std::make_unique<TaskQueueMetrics>() : nullptr),
+    limiter_(TaskQueueLimiter::Create(options.capacity, queue_name)),
+    thread_cache_(std::move(thread_cache)),
+    watchdog_(std::move(watchdog)),
+    epoll_fd_(::epoll_create1(EPOLL_CLOEXEC)),
+    wakeup_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+    timer_fd_(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {
+  // A queue that cannot wait on its descriptors would spin or never wake up.
+  if (epoll_fd_ < 0 || wakeup_fd_ < 0 || timer_fd_ < 0)
+    FatalError(queue_name, "creating the epoll, event or timer descriptor");
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = wakeup_fd_;
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &event) != 0)
+    FatalError(queue_name, "adding the event descriptor to epoll");
+  event.data.fd = timer_fd_;
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &event) != 0)
+    FatalError(queue_name, "adding the timer descriptor to epoll");
+  if (watchdog_)
+    watchdog_probe_ = watchdog_->Register(queue_name, [this] { return !pending_.empty(); });
+  thread_ = thread_cache_->Start([this] { RunThreadMain(); }, queue_name, attributes);
+}
+
+void TaskQueueLinux::Delete() {
+  // Producers blocked on a full queue must be out before it goes away.
+  if (limiter_)
+    limiter_->Close();
+  quit_.store(true, std::memory_order_release);
+  Wakeup();
+  thread_cache_->Join(thread_);
+  if (watchdog_)
+    watchdog_->Unregister(watchdog_probe_);
+  for (PendingTask* task : {carry_, pending_.PopAll()}) {
+    while (task != nullptr) {
+      PendingTask* next = MpscQueue<PendingTask>::Next(task);
+      task_pool_.Delete(task);
+      task = next;
+    }
+  }
+  ::close(timer_fd_);
+  ::close(wakeup_fd_);
+  ::close(epoll_fd_);
+  delete this;
+}
+
+void TaskQueueLinux::PostTask(absl::AnyInvocable<void() &&> task) {
+  PendingTask* pending = task_pool_.New(std::move(task));
+  if (Admit(pending))
+    PushPending(pending);
+}
+
+void TaskQueueLinux::PostQueuedClosureImpl(QueuedClosure task) {
+  PendingTask* pending = task_pool_.New(std::move(task));
+  if (Admit(pending))
+    PushPending(pending);
+}
+
+bool TaskQueueLinux::TryPostTaskImpl(absl::AnyInvocable<void() &&> task) {
+  PendingTask* pending = task_pool_.New(std::move(task));
+  if (!Admit(pending, /*try_only=*/true))
+    return false;
+  PushPending(pending);
+  return true;
+}
+
+void TaskQueueLinux::PostDroppableTaskImpl(absl::AnyInvocable<void() &&> task) {
+  if (!limiter_) {
+    PostTask(std::move(task));
+    return;
+  }
+  QueuedClosure droppable = limiter_->AdmitDroppable(std::move(task), this, sizeof(PendingTask), IsCurrent());
+  if (droppable)
+    PushPending(task_pool_.New(std::move(droppable)));
+}
+
+// Charges `task` to a bounded queue. Returns false, and drops the task, if
+// the queue is full and the overflow policy, or `try_only`, rejects it.
+bool TaskQueueLinux::Admit(PendingTask* task, bool try_only) {
+  if (!limiter_ || task->cancelable || task->lane != TaskLane::kNormal)
+    return true;
+  const size_t charge = TaskQueueLimiter::Charge(sizeof(PendingTask), task->task);
+  if (!(try_only ? limiter_->TryAdmit(charge) : limiter_->Admit(charge, IsCurrent()))) {
+    task_pool_.Delete(task);
+    return false;
+  }
+  task->charge = charge;
+  return true;
+}
+
+absl::optional<TaskQueueStats> TaskQueueLinux::GetStats() const {
+  if (!metrics_)
+    return absl::nullopt;
+  return metrics_->GetStats();
+}
+
+void TaskQueueLinux::PushPending(PendingTask* task) {
+  if (metrics_ && !task->delayed && task->lane == TaskLane::kNormal)
+    task->posted_us = metrics_->OnPosted();
+  if (!task->cancelable)
+    task->trace_flow = TaskTrace::OnPosted();
+  if (watchdog_probe_ && !task->delayed) {
+    if (const Location* site = TaskTrace::PostSite::Current()) {
+      task->posted_from_file = site->file();
+      task->posted_from_line = site->line();
+    }
+  }
+  // Only the producer that makes the queue non-empty pays for the eventfd
+  // write; everyone else piggybacks on the wakeup that is already pending.
+  if (pending_.Push(task))
+    Wakeup();
+}
+
+bool TaskQueueLinux::RegisterFdImpl(int fd, int events, absl::AnyInvocable<void(int events)> callback) {
+  if (!fd_watches_.Add(fd, events, std::move(callback)))
+    return false;
+  epoll_event event = {};
+  event.events = ToEpollEvents(events);
+  event.data.fd = fd;
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+    fd_watches_.Remove(fd);
+    return false;
+  }
+  return true;
+}
+
+void TaskQueueLinux::UnregisterFdImpl(int fd) {
+  if (fd_watches_.Remove(fd))
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void TaskQueueLinux::PostLaneTaskImpl(TaskLane lane, absl::AnyInvocable<void() &&> task, TimeDelta deadline) {
+  const Timestamp due_time = TaskLanes::Deadline(rtc::CurrentTimestamp(), deadline);
+  if (IsCurrent()) {
+    lanes_.Add(lane, TaskTrace::Bind(TaskTrace::OnPosted(), std::move(task)), due_time);
+    return;
+  }
+  PendingTask* pending = task_pool_.New(std::move(task));
+  pending->lane = lane;
+  pending->due_time = due_time;
+  PushPending(pending);
+}
+
+void TaskQueueLinux::PostDelayedTaskImpl(absl::AnyInvocable<void() &&> task, TimeDelta delay, DelayPrecision precision) {
+  PostDelayedPendingTask(task_pool_.New(std::move(task)), delay, precision);
+}
+
+void TaskQueueLinux::PostCancelableDelayedTaskImpl(rtc::scoped_refptr<CancelableTaskState> task, TimeDelta delay, DelayPrecision precision) {
+  PendingTask* pending = task_pool_.New(nullptr);
+  pending->cancelable = std::move(task);
+  PostDelayedPendingTask(pending, delay, precision);
+}
+
+void TaskQueueLinux::PostDelayedPendingTask(PendingTask* task, TimeDelta delay, DelayPrecision precision) {
+  if (!Admit(task))
+    return;
+  if (delay <= TimeDelta::Zero()) {
+    if (task->cancelable)
+      task->task = [state = std::move(task->cancelable)] { state->Run(); };
+    PushPending(task);
+    return;
+  }
+  task->delayed = true;
+  SetDueTime(task, rtc::CurrentTimestamp(), delay, precision);
+  if (IsCurrent()) {
+    if (!task->cancelable)
+      task->trace_flow = TaskTrace::OnPosted();
+    if (InsertDelayedTask(task))
+      ScheduleNextTimer();
+    return;
+  }
+  PushPending(task);
+}
+
+void TaskQueueLinux::PostTasksImpl(std::vector<BatchedTask> tasks) {
+  if (tasks.empty())
+    return;
+  // Link the batch newest-to-oldest up front so a single CAS publishes all of
+  // it and a single eventfd write wakes the queue for all of it. Delayed
+  // entries are sorted into timer_tasks_ by the queue thread, which re-arms
+  // the timer once per batch.
+  const Timestamp now = rtc::CurrentTimestamp();
+  int64_t posted_us = 0;
+  if (metrics_) {
+    posted_us = metrics_->OnPosted(std::count_if(tasks.begin(), tasks.end(), [](const BatchedTask& task) {
+      return task.delay <= TimeDelta::Zero();
+    }));
+  }
+  PendingTask* first = nullptr;
+  PendingTask* last = nullptr;
+  for (BatchedTask& batched : tasks) {
+    PendingTask* task = task_pool_.New(std::move(batched.task));
+    if (!Admit(task)) {
+      if (metrics_ && batched.delay <= TimeDelta::Zero())
+        metrics_->OnDropped();
+      continue;
+    }
+    task->trace_flow = TaskTrace::OnPosted();
+    if (batched.delay > TimeDelta::Zero()) {
+      task->delayed = true;
+      SetDueTime(task, now, batched.delay, batched.precision);
+    } else {
+      task->posted_us = posted_us;
+    }
+    if (first == nullptr)
+      first = task;
+    else
+      task->mpsc_next = last;
+    last = task;
+  }
+  if (first != nullptr && pending_.PushChain(first, last))
+    Wakeup();
+}
+
+void TaskQueueLinux::SetDueTime(PendingTask* task, Timestamp now, TimeDelta delay, DelayPrecision precision) const {
+  task->due_time = now + delay;
+  task->slack = precision == DelayPrecision::kLow ? LowPrecisionSlack(delay, low_precision_slack_) : TimeDelta::Zero();
+}
+
+// Moves `task` into timer_tasks_ and returns true if the timer must be
+// re-armed because the next wakeup moved earlier. Low precision tasks are
+// coalesced here, on the queue thread, where the armed wakeup is known.
+bool TaskQueueLinux::InsertDelayedTask(PendingTask* task) {
+  absl::optional<Timestamp> previous_wakeup = timer_tasks_->NextWakeupTime();
+  const Timestamp due_time = timer_tasks_->CoalescedDueTime(task->due_time, task->slack);
+  if (task->slack.IsZero())
+    spinner_.AddDeadline(due_time);
+  if (task->cancelable)
+    timer_tasks_->Insert(rtc::CurrentTimestamp(), due_time, std::move(task->cancelable));
+  else
+    timer_tasks_->Insert(rtc::CurrentTimestamp(), due_time, TaskTrace::Bind(task->trace_flow, std::move(task->task)),
+                         task->charge);
+  task_pool_.Delete(task);
+  if (metrics_)
+    metrics_->SetDelayedTasks(timer_tasks_->size());
+  absl::optional<Timestamp> wakeup = timer_tasks_->NextWakeupTime();
+  return wakeup && (!previous_wakeup || *wakeup < *previous_wakeup);
+}
+
+void TaskQueueLinux::Wakeup() {
+  const uint64_t one = 1;
+  // EAGAIN means the counter is already saturated, i.e. a wakeup is pending.
+  while (::write(wakeup_fd_, &one, sizeof(one)) < 0 && errno == EINTR) {
+  }
+}
+
+void TaskQueueLinux::RunPendingTasks() {
+  // One exchange takes the whole batch; tasks posted while it runs start the
+  // next batch and raise a fresh wakeup. The timer is re-armed once for all
+  // delayed tasks in the batch. What the budget leaves of a batch is
+  // finished, ahead of newer tasks, on the next iteration; once it is done the
+  // newer tasks are taken in the same call, as their wakeup may already have
+  // been consumed.
+  bool reschedule = false;
+  if (watchdog_probe_)
+    watchdog_probe_->PendingTaken();
+  RunLoopSlice slice(immediate_task_budget_);
+  bool carried = carry_ != nullptr;
+  PendingTask* task = carried ? carry_ : pending_.PopAll();
+  while (task != nullptr && slice.Admit()) {
+    PendingTask* next = MpscQueue<PendingTask>::Next(task);
+    if (task->delayed) {
+      reschedule |= InsertDelayedTask(task);
+    } else if (task->lane != TaskLane::kNormal) {
+      lanes_.Add(task->lane, TaskTrace::Bind(task->trace_flow, std::move(task->task)), task->due_time);
+      task_pool_.Delete(task);
+    } else {
+      if (limiter_)
+        limiter_->Release(task->charge);
+      TaskTrace::TaskScope scope(task->trace_flow);
+      TaskQueueWatchdog::RunningTask running(watchdog_probe_, task->posted_from_file, task->posted_from_line);
+      if (metrics_)
+        metrics_->RunTask(std::move(task->task), task->posted_us);
+      else
+        std::move(task->task)();
+      task_pool_.Delete(task);
+    }
+    task = next;
+    if (task == nullptr && carried) {
+      task = pending_.PopAll();
+      carried = false;
+    }
+  }
+  carry_ = task;
+  if (reschedule)
+    ScheduleNextTimer();
+}
+
+void TaskQueueLinux::RunThreadMain() {
+  CurrentTaskQueueSetter set_current(this);
+  epoll_event events[kMaxEvents];
+  while (true) {
+    // With work left over, or lane tasks waiting, only poll: the new events
+    // get their turn, then the leftovers continue. Otherwise block.
+    const bool poll = HasBacklog() || !lanes_.empty();
+    int count = ::epoll_wait(epoll_fd_, events, kMaxEvents, poll ? 0 : -1);
+    if (count < 0 && errno == EINTR)
+      continue;
+
+    bool timer_fired = false;
+    bool woken = false;
+    bool fd_ready = false;
+    for (int i = 0; i < count; ++i) {
+      if (events[i].data.fd == timer_fd_)
+        timer_fired = true;
+      else if (events[i].data.fd == wakeup_fd_)
+        woken = true;
+      else
+        fd_ready = true;
+    }
+
+    if (woken) {
+      uint64_t value;
+      ::read(wakeup_fd_, &value, sizeof(value));
+      if (quit_.load(std::memory_order_acquire))
+        break;
+    }
+    if (metrics_ && count > 0) {
+      metrics_->OnWakeup();
+      if (timer_fired)
+        metrics_->OnTimerWakeup();
+    }
+
+    if (timer_fired) {
+      uint64_t expirations;
+      ::read(timer_fd_, &expirations, sizeof(expirations));
+    }
+    // Due timers are serviced on every iteration, not only when the timer
+    // fires, so a flood of immediate tasks delays them by at most one
+    // immediate task budget.
+    bool reschedule = RunDueTasks();
+    // Spin out the last stretch before a high precision deadline rather
+    // than trusting the timer with it. New tasks cut the spin short; the
+    // timer is then re-armed in the past and fires right away.
+    if (timer_fired &&
+        spinner_.SpinToDeadline([this] { return !pending_.empty() || quit_.load(std::memory_order_relaxed); }))
+      reschedule |= RunDueTasks();
+    if (timer_fired || reschedule)
+      ScheduleNextTimer();
+
+    if (woken || carry_ != nullptr)
+      RunPendingTasks();
+    // After the tasks, which may have unregistered some of the descriptors;
+    // Dispatch() skips those.
+    if (fd_ready) {
+      for (int i = 0; i < count; ++i) {
+        const int fd = events[i].data.fd;
+        if (fd == timer_fd_ || fd == wakeup_fd_)
+          continue;
+        TaskQueueWatchdog::RunningTask running(watchdog_probe_);
+        fd_watches_.Dispatch(fd, FromEpollEvents(events[i].events));
+      }
+    }
+    // Idle tasks run on iterations that found no events and left no backlog.
+    RunLaneTasks(/*idle=*/count == 0 && !HasBacklog());
+  }
+}
+
+void TaskQueueLinux::RunLaneTasks(bool idle) {
+  if (lanes_.empty())
+    return;
+  QueuedClosure task;
+  auto run = [this, &task] {
+    TaskQueueWatchdog::RunningTask running(watchdog_probe_);
+    if (metrics_)
+      metrics_->RunLaneTask(std::move(task));
+    else
+      std::move(task)();
+  };
+  const Timestamp now = rtc::CurrentTimestamp();
+  while (lanes_.PopExpired(now, &task))
+    run();
+  // A slice of every iteration, so that a stream of normal tasks cannot
+  // starve the low priority lane.
+  const int64_t slice_end_us = now.us() + low_priority_budget_.us();
+  while (rtc::TimeMicros() < slice_end_us && lanes_.PopLowPriority(&task))
+    run();
+  // Nothing else was pending when this iteration polled; new work posted
+  // since is picked up before the next lane task.
+  if (idle && pending_.empty() && lanes_.PopAny(&task))
+    run();
+}
+
+// Runs due tasks within the timer budget and returns true if it took tasks
+// out of timer_tasks_, i.e. the timer must be re-armed.
+bool TaskQueueLinux::RunDueTasks() {
+  bool took = false;
+  if (due_next_ == due_tasks_.size()) {
+    // Tasks may post further delayed tasks, so take the due ones out first.
+    // due_tasks_ keeps its capacity between timer expirations.
+    due_tasks_.clear();
+    due_next_ = 0;
+    const Timestamp now = rtc::CurrentTimestamp();
+    absl::optional<Timestamp> wakeup = timer_tasks_->NextWakeupTime();
+    if (!wakeup || *wakeup > now)
+      return false;
+    timer_tasks_->TakeDueTasks(now, &due_tasks_);
+    took = true;
+    if (metrics_)
+      metrics_->SetDelayedTasks(timer_tasks_->size());
+  }
+  RunLoopSlice slice(timer_budget_);
+  while (due_next_ < due_tasks_.size() && slice.Admit()) {
+    DelayedTaskStore::DueTask& due = due_tasks_[due_next_++];
+    if (limiter_)
+      limiter_->Release(due.charge);
+    TaskQueueWatchdog::RunningTask running(watchdog_probe_);
+    if (metrics_)
+      metrics_->RunDelayedTask(std::move(due.task), due.due_time);
+    else
+      std::move(due.task)();
+  }
+  return took;
+}
+
+void TaskQueueLinux::ScheduleNextTimer() {
+  itimerspec spec = {};
+  absl::optional<Timestamp> wakeup = timer_tasks_->NextWakeupTime();
+  if (wakeup) {
+    if (spinner_.enabled())
+      wakeup = spinner_.TimerTime(rtc::CurrentTimestamp(), *wakeup);
+    // An all-zero it_value disarms the timer, so never arm for time zero.
+    int64_t since_epoch = std::max<int64_t>(wakeup->us(), 1);
+    spec.it_value.tv_sec = since_epoch / 1000000;
+    spec.it_value.tv_nsec = (since_epoch % 1000000) * 1000;
+  }
+  // Absolute CLOCK_MONOTONIC deadlines: timerfd applies no timer slack, so a
+  // high precision task is released as close to its deadline as the kernel
+  // allows.
+  ::timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+class TaskQueueLinuxFactory : public TaskQueueFactory {
+ public:
+  explicit TaskQueueLinuxFactory(const TaskQueueOptions& options)
+    : options_(options),
+      thread_cache_(std::make_shared<rtc::ThreadCache>(options.thread_cache_size)),
+      watchdog_(TaskQueueWatchdog::Create(options)) {}
+  std::unique_ptr<TaskQueueBase, TaskQueueDeleter> CreateTaskQueue(absl::string_view name,
+    Priority priority) const override {
+    return CreateTaskQueue(name, priority, rtc::ThreadAttributes());
+  }
+  std::unique_ptr<TaskQueueBase, TaskQueueDeleter> CreateTaskQueue(absl::string_view name,
+    Priority priority, const rtc::ThreadAttributes& attributes) const override {
+    rtc::ThreadAttributes thread_attributes = attributes;
+    thread_attributes.SetPriority(TaskQueuePriorityToThreadPriority(priority));
+    return std::unique_ptr<TaskQueueBase, TaskQueueDeleter>(
+        new TaskQueueLinux(name, thread_attributes, options_, thread_cache_, watchdog_));
+  }
+
+ private:
+  const TaskQueueOptions options_;
+  const std::shared_ptr<rtc::ThreadCache> thread_cache_;
+  const std::shared_ptr<TaskQueueWatchdog> watchdog_;
+};
+}  // namespace
+
+std::unique_ptr<TaskQueueFactory> CreateTaskQueueLinuxFactory(const TaskQueueOptions& options) {
+  return std::make_unique<TaskQueueLinuxFactory>(options);
+}
+}  // namespace webrtc
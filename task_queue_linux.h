@@ -0,0 +1,21 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef RTC_BASE_TASK_QUEUE_LINUX_H_
+#define RTC_BASE_TASK_QUEUE_LINUX_H_
+
+#include <memory>
+#include "task_queue_factory.h"
+#include "task_queue_options.h"
+
+namespace webrtc {
+std::unique_ptr<TaskQueueFactory> CreateTaskQueueLinuxFactory(const TaskQueueOptions& options = TaskQueueOptions());
+}
+#endif  // RTC_BASE_TASK_QUEUE_LINUX_H_
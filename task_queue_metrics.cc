@@ -0,0 +1,76 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_queue_metrics.h"
+
+#include <algorithm>
+
+namespace webrtc {
+namespace {
+
+int BucketOf(int64_t duration_us) {
+  int bucket = 0;
+  while (duration_us > 0 && bucket < HistogramSnapshot::kBuckets - 1) {
+    duration_us >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+}  // namespace
+
+int64_t HistogramSnapshot::PercentileUs(double fraction) const {
+  if (count == 0)
+    return 0;
+  const double rank = std::min(std::max(fraction, 0.0), 1.0) * count;
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    seen += buckets[i];
+    if (seen >= rank && seen > 0)
+      return i == 0 ? 0 : std::min((int64_t{1} << i) - 1, max_us);
+  }
+  return max_us;
+}
+
+void DurationHistogram::Add(int64_t duration_us) {
+  duration_us = std::max<int64_t>(duration_us, 0);
+  Increment(buckets_[BucketOf(duration_us)], 1);
+  Increment(count_, 1);
+  Increment(sum_us_, static_cast<uint64_t>(duration_us));
+  if (duration_us > max_us_.load(std::memory_order_relaxed))
+    max_us_.store(duration_us, std::memory_order_relaxed);
+}
+
+HistogramSnapshot DurationHistogram::Snapshot() const {
+  HistogramSnapshot snapshot;
+  for (int i = 0; i < HistogramSnapshot::kBuckets; ++i)
+    snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+  // Buckets are read first, so `count` may include a few samples that the
+  // buckets miss, never the other way round.
+  snapshot.count = count_.load(std::memory_order_relaxed);
+  snapshot.sum_us = static_cast<int64_t>(sum_us_.load(std::memory_order_relaxed));
+  snapshot.max_us = max_us_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+TaskQueueStats TaskQueueMetrics::GetStats() const {
+  TaskQueueStats stats;
+  stats.pending_tasks = std::max<int64_t>(pending_.load(std::memory_order_relaxed), 0);
+  stats.peak_pending_tasks = peak_pending_.load(std::memory_order_relaxed);
+  stats.delayed_tasks = delayed_.load(std::memory_order_relaxed);
+  stats.tasks_run = tasks_run_.load(std::memory_order_relaxed);
+  stats.wakeups = wakeups_.load(std::memory_order_relaxed);
+  stats.timer_wakeups = timer_wakeups_.load(std::memory_order_relaxed);
+  stats.queue_latency = queue_latency_.Snapshot();
+  stats.run_time = run_time_.Snapshot();
+  stats.timer_lateness = timer_lateness_.Snapshot();
+  return stats;
+}
+
+}  // namespace webrtc
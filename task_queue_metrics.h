@@ -0,0 +1,112 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_TASK_QUEUE_METRICS_H_
+#define RTC_BASE_TASK_QUEUE_METRICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <utility>
+
+#include "task_queue_stats.h"
+#include "time_utils.h"
+#include "timestamp.h"
+
+namespace webrtc {
+
+// Lock-free duration histogram behind HistogramSnapshot. Add() is meant for
+// a single writer at a time (the queue running the task); Snapshot() may be
+// called from any thread and sees every sample up to some recent point.
+class DurationHistogram {
+ public:
+  void Add(int64_t duration_us);
+  HistogramSnapshot Snapshot() const;
+
+ private:
+  static void Increment(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> buckets_[HistogramSnapshot::kBuckets] = {};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_us_{0};
+  std::atomic<int64_t> max_us_{0};
+};
+
+// Statistics recorder owned by a queue that was created with
+// TaskQueueOptions::enable_metrics. Queues without it keep a null pointer
+// and skip every hook, so disabled metrics cost one branch per post and
+// per task.
+class TaskQueueMetrics {
+ public:
+  // Called by the posting thread for `count` immediate tasks. Returns the
+  // post time to carry with the tasks.
+  int64_t OnPosted(int64_t count = 1) {
+    const int64_t depth = pending_.fetch_add(count, std::memory_order_relaxed) + count;
+    int64_t peak = peak_pending_.load(std::memory_order_relaxed);
+    while (depth > peak &&
+           !peak_pending_.compare_exchange_weak(peak, depth, std::memory_order_relaxed)) {
+    }
+    return rtc::TimeMicros();
+  }
+  // An immediate task was dropped without running.
+  void OnDropped() { pending_.fetch_sub(1, std::memory_order_relaxed); }
+  void OnWakeup() { wakeups_.fetch_add(1, std::memory_order_relaxed); }
+  // Counted in addition to OnWakeup() when the delayed task timer fired.
+  void OnTimerWakeup() { timer_wakeups_.fetch_add(1, std::memory_order_relaxed); }
+  void SetDelayedTasks(size_t count) {
+    delayed_.store(static_cast<int64_t>(count), std::memory_order_relaxed);
+  }
+
+  // Run an immediate task posted at `posted_us`, or a delayed task due at
+  // `due_time`, and record it.
+  template <typename Closure>
+  void RunTask(Closure&& task, int64_t posted_us) {
+    const int64_t start_us = rtc::TimeMicros();
+    pending_.fetch_sub(1, std::memory_order_relaxed);
+    queue_latency_.Add(start_us - posted_us);
+    Run(std::forward<Closure>(task), start_us);
+  }
+  // Run a low priority or idle task; only its run time is recorded.
+  template <typename Closure>
+  void RunLaneTask(Closure&& task) {
+    Run(std::forward<Closure>(task), rtc::TimeMicros());
+  }
+  template <typename Closure>
+  void RunDelayedTask(Closure&& task, Timestamp due_time) {
+    const int64_t start_us = rtc::TimeMicros();
+    timer_lateness_.Add(start_us - due_time.us());
+    Run(std::forward<Closure>(task), start_us);
+  }
+
+  TaskQueueStats GetStats() const;
+
+ private:
+  template <typename Closure>
+  void Run(Closure&& task, int64_t start_us) {
+    std::move(task)();
+    run_time_.Add(rtc::TimeMicros() - start_us);
+    tasks_run_.store(tasks_run_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  std::atomic<int64_t> pending_{0};
+  std::atomic<int64_t> peak_pending_{0};
+  std::atomic<int64_t> delayed_{0};
+  std::atomic<uint64_t> tasks_run_{0};
+  std::atomic<uint64_t> wakeups_{0};
+  std::atomic<uint64_t> timer_wakeups_{0};
+  DurationHistogram queue_latency_;
+  DurationHistogram run_time_;
+  DurationHistogram timer_lateness_;
+};
+
+}  // namespace webrtc
+#endif  // RTC_BASE_TASK_QUEUE_METRICS_H_
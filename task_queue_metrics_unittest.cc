@@ -0,0 +1,154 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_queue_metrics.h"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "absl/types/optional.h"
+#include "event.h"
+#include "gtest/gtest.h"
+#include "task_queue_factory.h"
+#include "task_queue_for_test.h"
+#include "task_queue_options.h"
+#include "task_queue_pool.h"
+#include "task_queue_stats.h"
+#include "time_delta.h"
+
+namespace webrtc {
+namespace {
+
+constexpr int kTimeoutMs = 5000;
+
+TEST(TaskQueueMetricsTest, HistogramBucketsArePowersOfTwo) {
+  DurationHistogram histogram;
+  histogram.Add(-5);
+  histogram.Add(0);
+  histogram.Add(1);
+  histogram.Add(2);
+  histogram.Add(3);
+  histogram.Add(1000);
+  const HistogramSnapshot snapshot = histogram.Snapshot();
+  EXPECT_EQ(snapshot.count, 6u);
+  EXPECT_EQ(snapshot.sum_us, 1006);
+  EXPECT_EQ(snapshot.max_us, 1000);
+  // Negative durations count as zero.
+  EXPECT_EQ(snapshot.buckets[0], 2u);
+  EXPECT_EQ(snapshot.buckets[1], 1u);
+  EXPECT_EQ(snapshot.buckets[2], 2u);
+  // 1000 us is in [512, 1024).
+  EXPECT_EQ(snapshot.buckets[10], 1u);
+}
+
+TEST(TaskQueueMetricsTest, LongDurationsGoToTheLastBucket) {
+  DurationHistogram histogram;
+  histogram.Add(int64_t{1} << 40);
+  EXPECT_EQ(histogram.Snapshot().buckets[HistogramSnapshot::kBuckets - 1], 1u);
+}
+
+TEST(TaskQueueMetricsTest, PercentileIsTheUpperBoundOfItsBucket) {
+  DurationHistogram histogram;
+  EXPECT_EQ(histogram.Snapshot().PercentileUs(0.5), 0);
+  for (int i = 0; i < 90; ++i)
+    histogram.Add(5);
+  for (int i = 0; i < 10; ++i)
+    histogram.Add(700);
+  const HistogramSnapshot snapshot = histogram.Snapshot();
+  // 5 us is in [4, 8), 700 us in [512, 1024), capped by the maximum.
+  EXPECT_EQ(snapshot.PercentileUs(0.5), 7);
+  EXPECT_EQ(snapshot.PercentileUs(0.9), 7);
+  EXPECT_EQ(snapshot.PercentileUs(0.91), 700);
+  EXPECT_EQ(snapshot.PercentileUs(1.0), 700);
+}
+
+// Posts `kTasks` tasks while the queue is held in a task, then reads the
+// statistics from a task posted after they ran.
+void ExpectStatsOfPostedTasks(TaskQueueFactory& factory) {
+  constexpr int kTasks = 20;
+  auto queue = factory.CreateTaskQueue("metrics", TaskQueueFactory::Priority::NORMAL);
+  rtc::Event entered;
+  rtc::Event open;
+  queue->PostTask([&] {
+    entered.Set();
+    open.Wait(kTimeoutMs);
+  });
+  ASSERT_TRUE(entered.Wait(kTimeoutMs));
+  rtc::Event ran;
+  int run = 0;
+  for (int i = 0; i < kTasks; ++i) {
+    queue->PostTask([&] {
+      if (++run == kTasks)
+        ran.Set();
+    });
+  }
+  absl::optional<TaskQueueStats> held = queue->GetStats();
+  ASSERT_TRUE(held);
+  EXPECT_EQ(held->pending_tasks, kTasks);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  open.Set();
+  ASSERT_TRUE(ran.Wait(kTimeoutMs));
+
+  rtc::Event read;
+  absl::optional<TaskQueueStats> stats;
+  queue->PostTask([&] {
+    stats = queue->GetStats();
+    read.Set();
+  });
+  ASSERT_TRUE(read.Wait(kTimeoutMs));
+  ASSERT_TRUE(stats);
+  // The held task and the others; the reading task has started but not
+  // finished.
+  EXPECT_EQ(stats->tasks_run, kTasks + 1u);
+  EXPECT_EQ(stats->pending_tasks, 0);
+  EXPECT_EQ(stats->peak_pending_tasks, kTasks);
+  EXPECT_EQ(stats->queue_latency.count, kTasks + 2u);
+  EXPECT_EQ(stats->run_time.count, kTasks + 1u);
+  // The tasks posted behind the held one waited for it to be let go.
+  EXPECT_GE(stats->queue_latency.max_us, 2000);
+  EXPECT_GE(stats->wakeups, 1u);
+}
+
+TEST(TaskQueueMetricsTest, CountsPostedTasks) {
+  auto factory = CreateNativeTaskQueueFactory(TaskQueueOptions().SetEnableMetrics(true));
+  ExpectStatsOfPostedTasks(*factory);
+}
+
+TEST(TaskQueueMetricsTest, PoolCountsPostedTasks) {
+  auto factory = CreateTaskQueuePoolFactory(2, TaskQueueOptions().SetEnableMetrics(true));
+  ExpectStatsOfPostedTasks(*factory);
+}
+
+TEST(TaskQueueMetricsTest, RecordsDelayedTaskLateness) {
+  auto factory = CreateNativeTaskQueueFactory(TaskQueueOptions().SetEnableMetrics(true));
+  auto queue = factory->CreateTaskQueue("metrics", TaskQueueFactory::Priority::NORMAL);
+  rtc::Event ran;
+  absl::optional<TaskQueueStats> stats;
+  queue->PostDelayedTask(
+      [&] {
+        stats = queue->GetStats();
+        ran.Set();
+      },
+      TimeDelta::Millis(5));
+  ASSERT_TRUE(ran.Wait(kTimeoutMs));
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(stats->timer_lateness.count, 1u);
+  EXPECT_EQ(stats->queue_latency.count, 0u);
+  EXPECT_GE(stats->timer_wakeups, 1u);
+}
+
+TEST(TaskQueueMetricsTest, NoStatsWithoutMetrics) {
+  auto factory = CreateNativeTaskQueueFactory();
+  auto queue = factory->CreateTaskQueue("metrics", TaskQueueFactory::Priority::NORMAL);
+  EXPECT_FALSE(queue->GetStats());
+}
+
+}  // namespace
+}  // namespace webrtc
@@ -0,0 +1,192 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef API_TASK_QUEUE_TASK_QUEUE_OPTIONS_H_
+#define API_TASK_QUEUE_TASK_QUEUE_OPTIONS_H_
+
+#include <stddef.h>
+
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "time_delta.h"
+
+namespace webrtc {
+
+// How a queue keeps its delayed tasks.
+enum class DelayedTaskPolicy {
+  // Binary heap: O(log n) insert and pop, tasks run in exact due time order.
+  kHeap,
+  // Hierarchical timing wheel with 1 ms ticks: O(1) insert and expiry. Tasks
+  // never run early, but tasks due within the same tick run in posting order.
+  kTimingWheel,
+};
+
+// How much one source of work (immediate tasks, due timers, OS messages) may
+// run per iteration of a queue's loop. A source that runs out of budget keeps
+// its remaining work, in order, for the next iteration, after the other
+// sources had their turn; due timers are checked on every iteration. The
+// first item of an iteration always runs. Zero means no limit.
+struct RunLoopBudget {
+  int max_tasks = 0;
+  TimeDelta max_time = TimeDelta::Zero();
+};
+
+// What a bounded queue does with a task posted while it is full, see
+// TaskQueueCapacity.
+enum class OverflowPolicy {
+  // The poster waits for room. Posts from the queue itself are let through,
+  // as waiting would deadlock.
+  kBlock,
+  // The posted task is dropped.
+  kDropNewest,
+  // The oldest task posted with PostDroppableTask() that has not started is
+  // dropped to make room; without one, the posted task is dropped.
+  kDropOldestDroppable,
+  // The posted task is dropped and `on_overflow` is called on the posting
+  // thread.
+  kCallback,
+};
+
+// Limit on the tasks a queue holds that have not run yet: their number, and
+// the bytes of their task nodes and of closures too large to be stored
+// inline (memory the captures own elsewhere is not seen). Zero means no
+// limit. Low priority and idle tasks and cancelable delayed tasks are not
+// counted, and a task is always let into a queue that holds none.
+struct TaskQueueCapacity {
+  int max_tasks = 0;
+  size_t max_bytes = 0;
+  OverflowPolicy policy = OverflowPolicy::kDropNewest;
+  std::function<void(const std::string& queue_name)> on_overflow;
+};
+
+// What the watchdog of a factory reports, see TaskQueueOptions::watchdog.
+struct TaskQueueWatchdogReport {
+  enum class Kind {
+    // A task has been running for longer than slow_task_threshold.
+    kSlowTask,
+    // Posted tasks have waited for longer than stalled_queue_threshold
+    // without the queue taking any of them.
+    kStalledQueue,
+  };
+  Kind kind;
+  std::string queue_name;
+  // For kSlowTask, where the task was posted from if it was posted with a
+  // Location from another thread; null otherwise.
+  const char* posted_from_file = nullptr;
+  int posted_from_line = 0;
+  // Time the task has been running or the oldest task has been waiting, at
+  // the granularity of the watchdog's sampling.
+  TimeDelta elapsed = TimeDelta::Zero();
+};
+
+// Per-queue settings understood by the task queue factories.
+struct TaskQueueOptions {
+  DelayedTaskPolicy delayed_task_policy = DelayedTaskPolicy::kHeap;
+  // Collect the statistics returned by TaskQueueBase::GetStats(). Costs two
+  // clock reads per task while enabled.
+  bool enable_metrics = false;
+  // Low precision delayed tasks may run up to this much late. Their deadlines
+  // are aligned to a grid of this size, or merged into an already pending
+  // wakeup, so that timers expire together instead of each waking the thread.
+  // Delays shorter than the window keep millisecond granularity; high
+  // precision tasks always keep their exact deadline. Zero keeps plain
+  // millisecond rounding.
+  TimeDelta low_precision_slack = TimeDelta::Millis(8);
+  // Sleep-then-spin mode for high precision delayed tasks: the queue thread
+  // sleeps on the OS timer until this long before the earliest high precision
+  // deadline and yields in a loop for the rest. Zero disables it. Only queues
+  // with a thread of their own spin; the pool factory ignores it.
+  TimeDelta high_precision_spin = TimeDelta::Zero();
+  // Fraction of wall time the queue thread may spend spinning. Once used up
+  // the queue sleeps until the deadline, as without spinning.
+  double high_precision_spin_budget = 0.05;
+  // Time per loop iteration (per slice on the pool) given to low priority
+  // tasks while normal tasks keep the queue busy. Zero runs them only when
+  // the queue is otherwise idle.
+  TimeDelta low_priority_budget = TimeDelta::Millis(1);
+  // Per-iteration budgets of the queue loop, see RunLoopBudget. With the
+  // defaults a flood of immediate tasks delays a due timer by about 10 ms at
+  // most. The pool applies them per slice. Messages are Windows only.
+  RunLoopBudget immediate_task_budget = {0, TimeDelta::Millis(10)};
+  RunLoopBudget timer_budget = {0, TimeDelta::Millis(10)};
+  RunLoopBudget message_budget = {0, TimeDelta::Millis(10)};
+  // Number of queue threads the Linux and Windows factories spawn up front
+  // and keep parked after their queue is deleted, so that creating a queue
+  // adopts one instead of spawning a thread. Only queues with default thread
+  // attributes (other than priority) use them. Ignored by the pool factory.
+  int thread_cache_size = 0;
+  // Watchdog over the queues of a factory: a monitor thread of the factory
+  // samples every queue a few times per threshold and calls `watchdog` once
+  // for every task that runs for longer than slow_task_threshold and once
+  // for every stall of a queue whose pending tasks wait for longer than
+  // stalled_queue_threshold. Disabled without a callback. Running a task
+  // costs the queue a few relaxed atomic stores while enabled.
+  TimeDelta slow_task_threshold = TimeDelta::PlusInfinity();
+  TimeDelta stalled_queue_threshold = TimeDelta::PlusInfinity();
+  std::function<void(const TaskQueueWatchdogReport&)> watchdog;
+  // Bounds every queue of the factory, see TaskQueueCapacity. A full queue
+  // applies the policy to PostTask() and its variants; TryPostTask() fails
+  // instead. Unbounded by default, at no cost; a bounded queue pays two
+  // atomic updates per task.
+  TaskQueueCapacity capacity;
+  TaskQueueOptions& SetDelayedTaskPolicy(DelayedTaskPolicy policy) {
+    delayed_task_policy = policy;
+    return *this;
+  }
+  TaskQueueOptions& SetEnableMetrics(bool enable) {
+    enable_metrics = enable;
+    return *this;
+  }
+  TaskQueueOptions& SetLowPrecisionSlack(TimeDelta slack) {
+    low_precision_slack = slack;
+    return *this;
+  }
+  TaskQueueOptions& SetLowPriorityBudget(TimeDelta budget) {
+    low_priority_budget = budget;
+    return *this;
+  }
+  TaskQueueOptions& SetImmediateTaskBudget(RunLoopBudget budget) {
+    immediate_task_budget = budget;
+    return *this;
+  }
+  TaskQueueOptions& SetTimerBudget(RunLoopBudget budget) {
+    timer_budget = budget;
+    return *this;
+  }
+  TaskQueueOptions& SetMessageBudget(RunLoopBudget budget) {
+    message_budget = budget;
+    return *this;
+  }
+  TaskQueueOptions& SetThreadCacheSize(int size) {
+    thread_cache_size = size;
+    return *this;
+  }
+  TaskQueueOptions& SetWatchdog(TimeDelta slow_task,
+                                TimeDelta stalled_queue,
+                                std::function<void(const TaskQueueWatchdogReport&)> callback) {
+    slow_task_threshold = slow_task;
+    stalled_queue_threshold = stalled_queue;
+    watchdog = std::move(callback);
+    return *this;
+  }
+  TaskQueueOptions& SetCapacity(TaskQueueCapacity limit) {
+    capacity = std::move(limit);
+    return *this;
+  }
+  TaskQueueOptions& SetHighPrecisionSpin(TimeDelta guard, double cpu_budget = 0.05) {
+    high_precision_spin = guard;
+    high_precision_spin_budget = cpu_budget;
+    return *this;
+  }
+};
+
+}  // namespace webrtc
+#endif  // API_TASK_QUEUE_TASK_QUEUE_OPTIONS_H_
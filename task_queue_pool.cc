@@ -0,0 +1,812 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "task_queue_pool.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/any_invocable.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "task_queue_base.h"
+#include "delayed_task_store.h"
+#include "inline_task.h"
+#include "mpsc_queue.h"
+#include "platform_thread.h"
+#include "run_loop_slice.h"
+#include "task_lanes.h"
+#include "task_node_pool.h"
+#include "task_queue_limiter.h"
+#include "task_queue_metrics.h"
+#include "task_queue_watchdog.h"
+#include "task_trace.h"
+#include "time_utils.h"
+
+namespace webrtc {
+namespace {
+
+class TaskQueueSequence;
+
+// Worker threads shared by all sequences of one factory, plus a timer thread
+// that makes sequences runnable when their next delayed task is due.
+class WorkerPool {
+ public:
+  explicit WorkerPool(int num_threads);
+  ~WorkerPool();
+
+  // Deleter of the shared pool. The last sequence may be released on one of
+  // the pool's own threads, which cannot join itself; the pool is then
+  // destroyed on a detached thread instead.
+  static void Destroy(WorkerPool* pool);
+
+  // Queues `sequence` to run one slice on some worker. Takes a reference.
+  void Schedule(TaskQueueSequence* sequence);
+  // Queues `sequence` to run one slice, allowed to run an idle task, once no
+  // worker finds another runnable sequence. Takes a reference.
+  void ScheduleIdle(TaskQueueSequence* sequence);
+  // Schedules `sequence` at `time`. Takes a reference until then.
+  void ScheduleAt(TaskQueueSequence* sequence, Timestamp time);
+  // Drops the pending ScheduleAt() requests of a deleted sequence.
+  void CancelWakeups(TaskQueueSequence* sequence);
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<TaskQueueSequence*> runnable;
+    rtc::PlatformThread thread;
+  };
+  struct Wakeup {
+    Timestamp time;
+    TaskQueueSequence* sequence;
+  };
+
+  void RunWorker(size_t index);
+  TaskQueueSequence* Take(size_t index);
+  TaskQueueSequence* TakeIdle();
+  void RunTimer();
+  static bool Later(const Wakeup& a, const Wakeup& b) { return a.time > b.time; }
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> next_worker_{0};
+  // Sequences waiting in any worker's deque, and workers parked because they
+  // found none. Both are updated before the other is read, so a Schedule()
+  // and a worker going to sleep cannot miss each other.
+  std::atomic<int> runnable_count_{0};
+  std::atomic<int> idle_count_{0};
+  std::mutex park_mutex_;
+  std::condition_variable park_cv_;
+  bool quit_ = false;  // Guarded by park_mutex_.
+  // Sequences left with only idle tasks. Guarded by park_mutex_.
+  std::deque<TaskQueueSequence*> idle_runnable_;
+
+  std::mutex timer_mutex_;
+  std::condition_variable timer_cv_;
+  std::vector<Wakeup> wakeups_;  // Min-heap on time. Guarded by timer_mutex_.
+  bool timer_quit_ = false;  // Guarded by timer_mutex_.
+  rtc::PlatformThread timer_thread_;
+};
+
+// Identifies the pool worker running on the current thread, if any, so that
+// sequences woken from a task stay on the worker that woke them. The timer
+// thread has an index past the workers.
+struct CurrentWorker {
+  const WorkerPool* pool;
+  size_t index;
+};
+thread_local CurrentWorker current_worker = {nullptr, 0};
+
+struct PendingTask : public MpscNode {
+  explicit PendingTask(QueuedClosure task) : task(std::move(task)) {}
+  QueuedClosure task;
+  // Set instead of `task` for PostCancelableDelayedTask.
+  rtc::scoped_refptr<CancelableTaskState> cancelable;
+  bool delayed = false;
+  // Set for PostLowPriorityTask and PostIdleTask.
+  TaskQueueBase::TaskLane lane = TaskQueueBase::TaskLane::kNormal;
+  // Earliest time a delayed task may run, and how much later it may run to
+  // share a wakeup with other timers. For a lane task, its deadline.
+  Timestamp due_time = Timestamp::MinusInfinity();
+  TimeDelta slack = TimeDelta::Zero();
+  // Post time of an immediate task, only recorded with metrics enabled.
+  int64_t posted_us = 0;
+  // Flow from the post to the run, only recorded while tracing.
+  uint64_t trace_flow = 0;
+  // Post site of an immediate task, only recorded with a watchdog.
+  const char* posted_from_file = nullptr;
+  int posted_from_line = 0;
+  // Capacity the task holds on a bounded queue.
+  size_t charge = 0;
+};
+
+// A TaskQueueBase without a thread. Posting makes the sequence runnable; a
+// worker then runs one slice of it: the due delayed tasks and the tasks that
+// were pending when the slice started. Tasks posted meanwhile go to the next
+// slice, after the sequences that became runnable before them, so a busy
+// sequence cannot starve the others sharing its worker.
+class TaskQueueSequence final : public TaskQueueBase {
+ public:
+  TaskQueueSequence(std::shared_ptr<WorkerPool> pool,
+                    absl::string_view name,
+                    bool high_priority,
+                    const TaskQueueOptions& options,
+                    std::shared_ptr<TaskQueueWatchdog> watchdog);
+
+  void Delete() override;
+  void PostTask(absl::AnyInvocable<void() &&> task) override;
+  absl::optional<TaskQueueStats> GetStats() const override;
+
+  void AddRef() const { ref_count_.fetch_add(1, std::memory_order_relaxed); }
+  void Release() const {
+    if (ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete this;
+  }
+  bool high_priority() const { return high_priority_; }
+  // Makes the sequence runnable unless it already is.
+  void Wake();
+  // Worker side; the caller holds a reference. `pool_idle` is set for slices
+  // scheduled with ScheduleIdle(), which may run an idle task.
+  void RunSlice(bool pool_idle);
+
+ protected:
+  void PostDelayedTaskImpl(absl::AnyInvocable<void() &&> task, TimeDelta delay, DelayPrecision precision) override;
+  void PostCancelableDelayedTaskImpl(rtc::scoped_refptr<CancelableTaskState> task, TimeDelta delay, DelayPrecision precision) override;
+  void PostTasksImpl(std::vector<BatchedTask> tasks) override;
+  void PostQueuedClosureImpl(QueuedClosure task) override;
+  void PostLaneTaskImpl(TaskLane lane, absl::AnyInvocable<void() &&> task, TimeDelta deadline) override;
+  bool TryPostTaskImpl(absl::AnyInvocable<void() &&> task) override;
+  void PostDroppableTaskImpl(absl::AnyInvocable<void() &&> task) override;
+
+ private:
+  // kScheduled: queued on a worker or running. kRerun: woken while running;
+  // the worker queues it again when the slice ends. kIdleWait: only idle
+  // tasks are left, and the sequence waits for the pool to be idle; a wakeup
+  // schedules it as from kIdle.
+  enum State { kIdle, kScheduled, kRerun, kIdleWait };
+
+  ~TaskQueueSequence() override;
+
+  bool Admit(PendingTask* task, bool try_only = false);
+  void SetDueTime(PendingTask* task, Timestamp now, TimeDelta delay, DelayPrecision precision) const;
+  void PostDelayedPendingTask(PendingTask* task, TimeDelta delay, DelayPrecision precision);
+  void InsertDelayedTask(PendingTask* task);
+  void PushPending(PendingTask* task);
+  void DeletePending();
+  void RunLaneTasks(Timestamp now, bool pool_idle);
+
+  const std::shared_ptr<WorkerPool> pool_;
+  const bool high_priority_;
+  mutable std::atomic<int> ref_count_{1};
+  std::atomic<int> state_{kIdle};
+  std::atomic<bool> quit_{false};
+  // Set while queued with ScheduleIdle().
+  std::atomic<bool> idle_scheduled_{false};
+  // Held by the worker for the duration of a slice, so Delete() can wait for
+  // the running task.
+  std::mutex run_mutex_;
+  // Only used inside slices.
+  std::unique_ptr<DelayedTaskStore> timer_tasks_;
+  const TimeDelta low_precision_slack_;
+  // Due tasks taken from timer_tasks_; those from due_next_ on have not run.
+  std::vector<DelayedTaskStore::DueTask> due_tasks_;
+  size_t due_next_ = 0;
+  // Rest of the pending batch, oldest first, left by a slice whose immediate
+  // task budget ran out.
+  PendingTask* carry_ = nullptr;
+  const RunLoopBudget immediate_task_budget_;
+  const RunLoopBudget timer_budget_;
+  absl::optional<Timestamp> requested_wakeup_;
+  TaskLanes lanes_;
+  const TimeDelta low_priority_budget_;
+  // Null unless TaskQueueOptions::enable_metrics.
+  const std::unique_ptr<TaskQueueMetrics> metrics_;
+  // Null unless TaskQueueOptions::capacity sets a limit.
+  const std::unique_ptr<TaskQueueLimiter> limiter_;
+  // Null unless the factory has a watchdog.
+  const std::shared_ptr<TaskQueueWatchdog> watchdog_;
+  TaskQueueWatchdog::Probe* watchdog_probe_ = nullptr;
+  TaskNodePool<PendingTask> task_pool_;
+  MpscQueue<PendingTask> pending_;
+};
+
+TaskQueueSequence::TaskQueueSequence(std::shared_ptr<WorkerPool> pool,
+                                     absl::string_view name,
+                                     bool high_priority,
+                                     const TaskQueueOptions& options,
+                                     std::shared_ptr<TaskQueueWatchdog> watchdog)
+  : pool_(std::move(pool)),
+    high_priority_(high_priority),
+    timer_tasks_(CreateDelayedTaskStore(options.delayed_task_policy)),
+    low_precision_slack_(options.low_precision_slack),
+    immediate_task_budget_(options.immediate_task_budget),
+    timer_budget_(options.timer_budget),
+    low_priority_budget_(options.low_priority_budget),
+    metrics_(options.enable_metrics ? std::make_unique<TaskQueueMetrics>() : nullptr),
+    limiter_(TaskQueueLimiter::Create(options.capacity, name)),
+    watchdog_(std::move(watchdog)) {
+  if (watchdog_)
+    watchdog_probe_ = watchdog_->Register(name, [this] { return !pending_.empty(); });
+}
+
+TaskQueueSequence::~TaskQueueSequence() {
+  // Tasks posted after Delete() are dropped here.
+  DeletePending();
+}
+
+void TaskQueueSequence::Delete() {
+  // Must not be called from one of the sequence's own tasks.
+
+  // Producers blocked on a full queue must be out before it goes away.
+  if (limiter_)
+    limiter_->Close();
+  quit_.store(true, std::memory_order_release);
+  pool_->CancelWakeups(this);
+  {
+    // Waits for the running task, if any; later slices see quit_ and return
+    // without touching the sequence.
+    std::lock_guard<std::mutex> lock(run_mutex_);
+    DeletePending();
+    for (PendingTask* task = carry_; task != nullptr;) {
+      PendingTask* next = MpscQueue<PendingTask>::Next(task);
+      task_pool_.Delete(task);
+      task = next;
+    }
+    carry_ = nullptr;
+    due_tasks_.clear();
+    timer_tasks_.reset();
+    lanes_.Clear();
+  }
+  if (watchdog_)
+    watchdog_->Unregister(watchdog_probe_);
+  // Workers may still hold references to the sequence; the last one frees it.
+  Release();
+}
+
+void TaskQueueSequence::DeletePending() {
+  for (PendingTask* task = pending_.PopAll(); task != nullptr;) {
+    PendingTask* next = MpscQueue<PendingTask>::Next(task);
+    task_pool_.Delete(task);
+    task = next;
+  }
+}
+
+void TaskQueueSequence::PostTask(absl::AnyInvocable<void() &&> task) {
+  PendingTask* pending = task_pool_.New(std::move(task));
+  if (Admit(pending))
+    PushPending(pending);
+}
+
+void TaskQueueSequence::PostQueuedClosureImpl(QueuedClosure task) {
+  PendingTask* pending = task_pool_.New(std::move(task));
+  if (Admit(pending))
+    PushPending(pending);
+}
+
+bool TaskQueueSequence::TryPostTaskImpl(absl::AnyInvocable<void() &&> task) {
+  PendingTask* pending = task_pool_.New(std::move(task));
+  if (!Admit(pending, /*try_only=*/true))
+    return false;
+  PushPending(pending);
+  return true;
+}
+
+void TaskQueueSequence::PostDroppableTaskImpl(absl::AnyInvocable<void() &&> task) {
+  if (!limiter_) {
+    PostTask(std::move(task));
+    return;
+  }
+  QueuedClosure droppable = limiter_->AdmitDroppable(std::move(task), this, sizeof(PendingTask), IsCurrent());
+  if (droppable)
+    PushPending(task_pool_.New(std::move(droppable)));
+}
+
+// Charges `task` to a bounded queue. Returns false, and drops the task, if
+// the queue is full and the overflow policy, or `try_only`, rejects it. A
+// producer that waits for room on a pool queue holds its own thread, which
+// may be a worker of the same pool.
+bool TaskQueueSequence::Admit(PendingTask* task, bool try_only) {
+  if (!limiter_ || task->cancelable || task->lane != TaskLane::kNormal)
+    return true;
+  const size_t charge = TaskQueueLimiter::Charge(sizeof(PendingTask), task->task);
+  if (!(try_only ? limiter_->TryAdmit(charge) : limiter_->Admit(charge, IsCurrent()))) {
+    task_pool_.Delete(task);
+    return false;
+  }
+  task->charge = charge;
+  return true;
+}
+
+absl::optional<TaskQueueStats> TaskQueueSequence::GetStats() const {
+  if (!metrics_)
+    return absl::nullopt;
+  return metrics_->GetStats();
+}
+
+void TaskQueueSequence::PushPending(PendingTask* task) {
+  if (metrics_ && !task->delayed && task->lane == TaskLane::kNormal)
+    task->posted_us = metrics_->OnPosted();
+  if (!task->cancelable)
+    task->trace_flow = TaskTrace::OnPosted();
+  if (watchdog_probe_ && !task->delayed) {
+    if (const Location* site = TaskTrace::PostSite::Current()) {
+      task->posted_from_file = site->file();
+      task->posted_from_line = site->line();
+    }
+  }
+  // A non-empty queue has already been handed to Wake() by the producer that
+  // made it non-empty.
+  if (pending_.Push(task))
+    Wake();
+}
+
+void TaskQueueSequence::Wake() {
+  int state = state_.load(std::memory_order_acquire);
+  while (true) {
+    if (state == kRerun)
+      return;
+    const int next = state == kScheduled ? kRerun : kScheduled;
+    if (state_.compare_exchange_weak(state, next, std::memory_order_acq_rel,
+                                     std::memory_order_acquire)) {
+      if (next == kScheduled)
+        pool_->Schedule(this);
+      return;
+    }
+  }
+}
+
+void TaskQueueSequence::PostLaneTaskImpl(TaskLane lane, absl::AnyInvocable<void() &&> task, TimeDelta deadline) {
+  const Timestamp due_time = TaskLanes::Deadline(rtc::CurrentTimestamp(), deadline);
+  // Inside a slice the lanes can be used directly; RunSlice() sees them
+  // before it decides whether another slice is needed.
+  if (IsCurrent()) {
+    lanes_.Add(lane, TaskTrace::Bind(TaskTrace::OnPosted(), std::move(task)), due_time);
+    return;
+  }
+  PendingTask* pending = task_pool_.New(std::move(task));
+  pending->lane = lane;
+  pending->due_time = due_time;
+  PushPending(pending);
+}
+
+void TaskQueueSequence::PostDelayedTaskImpl(absl::AnyInvocable<void() &&> task, TimeDelta delay, DelayPrecision precision) {
+  PostDelayedPendingTask(task_pool_.New(std::move(task)), delay, precision);
+}
+
+void TaskQueueSequence::PostCancelableDelayedTaskImpl(rtc::scoped_refptr<CancelableTaskState> task, TimeDelta delay, DelayPrecision precision) {
+  PendingTask* pending = task_pool_.New(nullptr);
+  pending->cancelable = std::move(task);
+  PostDelayedPendingTask(pending, delay, precision);
+}
+
+void TaskQueueSequence::PostTasksImpl(std::vector<BatchedTask> tasks) {
+  if (tasks.empty())
+    return;
+  const Timestamp now = rtc::CurrentTimestamp();
+  int64_t posted_us = 0;
+  if (metrics_) {
+    posted_us = metrics_->OnPosted(std::count_if(tasks.begin(), tasks.end(), [](const BatchedTask& task) {
+      return task.delay <= TimeDelta::Zero();
+    }));
+  }
+  PendingTask* first = nullptr;
+  PendingTask* last = nullptr;
+  for (BatchedTask& batched : tasks) {
+    PendingTask* task = task_pool_.New(std::move(batched.task));
+    if (!Admit(task)) {
+      if (metrics_ && batched.delay <= TimeDelta::Zero())
+        metrics_->OnDropped();
+      continue;
+    }
+    task->trace_flow = TaskTrace::OnPosted();
+    if (batched.delay > TimeDelta::Zero()) {
+      task->delayed = true;
+      SetDueTime(task, now, batched.delay, batched.precision);
+    } else {
+      task->posted_us = posted_us;
+    }
+    if (first == nullptr)
+      first = task;
+    else
+      task->mpsc_next = last;
+    last = task;
+  }
+  if (first != nullptr && pending_.PushChain(first, last))
+    Wake();
+}
+
+void TaskQueueSequence::SetDueTime(PendingTask* task, Timestamp now, TimeDelta delay, DelayPrecision precision) const {
+  task->due_time = now + delay;
+  task->slack = precision == DelayPrecision::kLow ? LowPrecisionSlack(delay, low_precision_slack_) : TimeDelta::Zero();
+}
+
+void TaskQueueSequence::PostDelayedPendingTask(PendingTask* task, TimeDelta delay, DelayPrecision precision) {
+  if (!Admit(task))
+    return;
+  if (delay <= TimeDelta::Zero()) {
+    if (task->cancelable)
+      task->task = [state = std::move(task->cancelable)] { state->Run(); };
+    PushPending(task);
+    return;
+  }
+  task->delayed = true;
+  SetDueTime(task, rtc::CurrentTimestamp(), delay, precision);
+  // Inside a slice the store can be used directly; the wakeup is requested
+  // when the slice ends.
+  if (IsCurrent()) {
+    if (!task->cancelable)
+      task->trace_flow = TaskTrace::OnPosted();
+    InsertDelayedTask(task);
+    return;
+  }
+  PushPending(task);
+}
+
+void TaskQueueSequence::InsertDelayedTask(PendingTask* task) {
+  // Grid-aligned deadlines also let the pool's timer thread serve the
+  // wakeups of many sequences at once.
+  const Timestamp due_time = timer_tasks_->CoalescedDueTime(task->due_time, task->slack);
+  if (task->cancelable)
+    timer_tasks_->Insert(rtc::CurrentTimestamp(), due_time, std::move(task->cancelable));
+  else
+    timer_tasks_->Insert(rtc::CurrentTimestamp(), due_time, TaskTrace::Bind(task->trace_flow, std::move(task->task)),
+                         task->charge);
+  task_pool_.Delete(task);
+}
+
+void TaskQueueSequence::RunSlice(bool pool_idle) {
+  bool more_work = false;
+  bool idle_work = false;
+  {
+    std::lock_guard<std::mutex> lock(run_mutex_);
+    if (pool_idle)
+      idle_scheduled_.store(false, std::memory_order_relaxed);
+    if (quit_.load(std::memory_order_acquire))
+      return;
+    if (pool_idle) {
+      // Woken since, and scheduled as usual; that slice runs instead.
+      int state = kIdleWait;
+      if (!state_.compare_exchange_strong(state, kScheduled, std::memory_order_acq_rel))
+        return;
+    }
+    // Everything pushed before this point is picked up by the PopAll below,
+    // so wakeups received while queued are consumed here.
+    state_.exchange(kScheduled, std::memory_order_acq_rel);
+    CurrentTaskQueueSetter set_current(this);
+
+    const Timestamp now = rtc::CurrentTimestamp();
+    if (metrics_)
+      metrics_->OnWakeup();
+    if (requested_wakeup_ && *requested_wakeup_ <= now) {
+      requested_wakeup_ = absl::nullopt;
+      if (metrics_)
+        metrics_->OnTimerWakeup();
+    }
+    // Budgets apply per slice; whatever is left over is finished, in order,
+    // in the next slice, after the other sequences on the worker had theirs.
+    if (due_next_ == due_tasks_.size()) {
+      due_tasks_.clear();
+      due_next_ = 0;
+      timer_tasks_->TakeDueTasks(now, &due_tasks_);
+    }
+    RunLoopSlice timer_slice(timer_budget_);
+    while (due_next_ < due_tasks_.size() && timer_slice.Admit()) {
+      if (quit_.load(std::memory_order_acquire))
+        break;
+      DelayedTaskStore::DueTask& due = due_tasks_[due_next_++];
+      if (limiter_)
+        limiter_->Release(due.charge);
+      TaskQueueWatchdog::RunningTask running(watchdog_probe_);
+      if (metrics_)
+        metrics_->RunDelayedTask(std::move(due.task), due.due_time);
+      else
+        std::move(due.task)();
+    }
+
+    // Once a carried batch is done, the tasks posted meanwhile are taken in
+    // the same slice: the wakeup they raised was consumed when it started.
+    if (watchdog_probe_)
+      watchdog_probe_->PendingTaken();
+    RunLoopSlice task_slice(immediate_task_budget_);
+    bool carried = carry_ != nullptr;
+    PendingTask* task = carried ? carry_ : pending_.PopAll();
+    while (task != nullptr && task_slice.Admit()) {
+      PendingTask* next = MpscQueue<PendingTask>::Next(task);
+      if (task->delayed) {
+        InsertDelayedTask(task);
+      } else if (task->lane != TaskLane::kNormal) {
+        if (!quit_.load(std::memory_order_acquire))
+          lanes_.Add(task->lane, TaskTrace::Bind(task->trace_flow, std::move(task->task)), task->due_time);
+        task_pool_.Delete(task);
+      } else {
+        if (limiter_)
+          limiter_->Release(task->charge);
+        if (quit_.load(std::memory_order_acquire)) {
+          // Dropped by Delete().
+        } else {
+          TaskTrace::TaskScope scope(task->trace_flow);
+          TaskQueueWatchdog::RunningTask running(watchdog_probe_, task->posted_from_file, task->posted_from_line);
+          if (metrics_)
+            metrics_->RunTask(std::move(task->task), task->posted_us);
+          else
+            std::move(task->task)();
+        }
+        task_pool_.Delete(task);
+      }
+      task = next;
+      if (task == nullptr && carried) {
+        task = pending_.PopAll();
+        carried = false;
+      }
+    }
+    carry_ = task;
+    if (quit_.load(std::memory_order_acquire))
+      return;
+    RunLaneTasks(rtc::CurrentTimestamp(), pool_idle);
+    if (quit_.load(std::memory_order_acquire))
+      return;
+    // Low priority tasks get a slice every time, unless their budget is
+    // zero; idle tasks, and those low priority tasks, wait for the pool to
+    // run out of other work, or for their deadline.
+    more_work = carry_ != nullptr || due_next_ < due_tasks_.size() ||
+                (low_priority_budget_ > TimeDelta::Zero() && lanes_.has_low_priority());
+    idle_work = !lanes_.empty();
+    if (metrics_)
+      metrics_->SetDelayedTasks(timer_tasks_->size());
+
+    absl::optional<Timestamp> wakeup = timer_tasks_->NextWakeupTime();
+    const Timestamp lane_deadline = lanes_.earliest_deadline();
+    if (lane_deadline.IsFinite() && (!wakeup || lane_deadline < *wakeup))
+      wakeup = lane_deadline;
+    if (wakeup && (!requested_wakeup_ || *wakeup < *requested_wakeup_)) {
+      requested_wakeup_ = wakeup;
+      pool_->ScheduleAt(this, *wakeup);
+    }
+  }
+
+  int state = kScheduled;
+  if (more_work ||
+      !state_.compare_exchange_strong(state, idle_work ? kIdleWait : kIdle, std::memory_order_acq_rel)) {
+    // Woken while running, or work is left over: go to the back of the line
+    // for another slice.
+    state_.store(kScheduled, std::memory_order_relaxed);
+    pool_->Schedule(this);
+  } else if (idle_work && !idle_scheduled_.exchange(true, std::memory_order_relaxed)) {
+    pool_->ScheduleIdle(this);
+  }
+}
+
+// Lane tasks get the expired ones, a budgeted slice of low priority tasks,
+// and, in a slice scheduled because the pool was idle, one more task if
+// nothing new arrived during the slice. Sharing the worker with other
+// sequences is left to the scheduler: a sequence with low priority tasks
+// left simply asks for another slice.
+void TaskQueueSequence::RunLaneTasks(Timestamp now, bool pool_idle) {
+  if (lanes_.empty())
+    return;
+  QueuedClosure task;
+  auto run = [this, &task] {
+    TaskQueueWatchdog::RunningTask running(watchdog_probe_);
+    if (metrics_)
+      metrics_->RunLaneTask(std::move(task));
+    else
+      std::move(task)();
+  };
+  while (!quit_.load(std::memory_order_acquire) && lanes_.PopExpired(now, &task))
+    run();
+  const int64_t slice_end_us = now.us() + low_priority_budget_.us();
+  while (!quit_.load(std::memory_order_acquire) && rtc::TimeMicros() < slice_end_us &&
+         lanes_.PopLowPriority(&task))
+    run();
+  if (pool_idle && !quit_.load(std::memory_order_acquire) && pending_.empty() && carry_ == nullptr &&
+      lanes_.PopAny(&task))
+    run();
+}
+
+WorkerPool::WorkerPool(int num_threads) {
+  if (num_threads <= 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 0; i < num_threads; ++i)
+    workers_.push_back(std::make_unique<Worker>());
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    workers_[i]->thread = rtc::PlatformThread::SpawnJoinable(
+        [this, i] { RunWorker(i); }, "TaskQueuePool" + std::to_string(i));
+  }
+  timer_thread_ = rtc::PlatformThread::SpawnJoinable([this] { RunTimer(); }, "TaskQueuePoolTimer");
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(timer_mutex_);
+    timer_quit_ = true;
+  }
+  timer_cv_.notify_one();
+  timer_thread_.Finalize();
+  {
+    std::lock_guard<std::mutex> lock(park_mutex_);
+    quit_ = true;
+  }
+  park_cv_.notify_all();
+  for (auto& worker : workers_)
+    worker->thread.Finalize();
+
+  // Every sequence holds the pool, so no references to sequences are left.
+}
+
+void WorkerPool::Destroy(WorkerPool* pool) {
+  if (current_worker.pool == pool)
+    rtc::PlatformThread::SpawnDetached([pool] { delete pool; }, "TaskQueuePoolExit");
+  else
+    delete pool;
+}
+
+void WorkerPool::Schedule(TaskQueueSequence* sequence) {
+  sequence->AddRef();
+  // Sequences woken by a task stay on that task's worker; the others are
+  // spread round robin. Idle workers steal from busy ones either way.
+  size_t index;
+  if (current_worker.pool == this && current_worker.index < workers_.size())
+    index = current_worker.index;
+  else
+    index = next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+  Worker& worker = *workers_[index];
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (sequence->high_priority())
+      worker.runnable.push_front(sequence);
+    else
+      worker.runnable.push_back(sequence);
+  }
+  runnable_count_.fetch_add(1);
+  if (idle_count_.load() > 0) {
+    std::lock_guard<std::mutex> lock(park_mutex_);
+    park_cv_.notify_one();
+  }
+}
+
+void WorkerPool::ScheduleIdle(TaskQueueSequence* sequence) {
+  sequence->AddRef();
+  std::lock_guard<std::mutex> lock(park_mutex_);
+  idle_runnable_.push_back(sequence);
+  park_cv_.notify_one();
+}
+
+TaskQueueSequence* WorkerPool::TakeIdle() {
+  std::lock_guard<std::mutex> lock(park_mutex_);
+  if (idle_runnable_.empty())
+    return nullptr;
+  TaskQueueSequence* sequence = idle_runnable_.front();
+  idle_runnable_.pop_front();
+  return sequence;
+}
+
+TaskQueueSequence* WorkerPool::Take(size_t index) {
+  // Own deque first, then steal the longest waiting sequence of the others.
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    Worker& worker = *workers_[(index + i) % workers_.size()];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (!worker.runnable.empty()) {
+      TaskQueueSequence* sequence = worker.runnable.front();
+      worker.runnable.pop_front();
+      runnable_count_.fetch_sub(1);
+      return sequence;
+    }
+  }
+  return nullptr;
+}
+
+void WorkerPool::RunWorker(size_t index) {
+  current_worker = {this, index};
+  while (true) {
+    if (TaskQueueSequence* sequence = Take(index)) {
+      sequence->RunSlice(/*pool_idle=*/false);
+      sequence->Release();
+      continue;
+    }
+    if (TaskQueueSequence* sequence = TakeIdle()) {
+      sequence->RunSlice(/*pool_idle=*/true);
+      sequence->Release();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(park_mutex_);
+    if (quit_)
+      break;
+    idle_count_.fetch_add(1);
+    if (runnable_count_.load() == 0 && idle_runnable_.empty())
+      park_cv_.wait(lock);
+    idle_count_.fetch_sub(1);
+  }
+}
+
+void WorkerPool::ScheduleAt(TaskQueueSequence* sequence, Timestamp time) {
+  sequence->AddRef();
+  bool earliest;
+  {
+    std::lock_guard<std::mutex> lock(timer_mutex_);
+    earliest = wakeups_.empty() || time < wakeups_.front().time;
+    wakeups_.push_back({time, sequence});
+    std::push_heap(wakeups_.begin(), wakeups_.end(), &Later);
+  }
+  if (earliest)
+    timer_cv_.notify_one();
+}
+
+void WorkerPool::CancelWakeups(TaskQueueSequence* sequence) {
+  size_t cancelled;
+  {
+    std::lock_guard<std::mutex> lock(timer_mutex_);
+    auto end = std::remove_if(wakeups_.begin(), wakeups_.end(),
+                              [sequence](const Wakeup& wakeup) { return wakeup.sequence == sequence; });
+    cancelled = wakeups_.end() - end;
+    wakeups_.erase(end, wakeups_.end());
+    std::make_heap(wakeups_.begin(), wakeups_.end(), &Later);
+  }
+  // The caller still holds its own reference.
+  for (size_t i = 0; i < cancelled; ++i)
+    sequence->Release();
+}
+
+void WorkerPool::RunTimer() {
+  current_worker = {this, workers_.size()};
+  std::unique_lock<std::mutex> lock(timer_mutex_);
+  while (!timer_quit_) {
+    if (wakeups_.empty()) {
+      timer_cv_.wait(lock);
+      continue;
+    }
+    const Timestamp now = rtc::CurrentTimestamp();
+    if (wakeups_.front().time > now) {
+      // steady_clock based, like rtc::TimeMicros().
+      timer_cv_.wait_for(lock, std::chrono::microseconds((wakeups_.front().time - now).us()));
+      continue;
+    }
+    std::pop_heap(wakeups_.begin(), wakeups_.end(), &Later);
+    TaskQueueSequence* sequence = wakeups_.back().sequence;
+    wakeups_.pop_back();
+    lock.unlock();
+    sequence->Wake();
+    sequence->Release();
+    lock.lock();
+  }
+}
+
+class TaskQueuePoolFactory : public TaskQueueFactory {
+ public:
+  TaskQueuePoolFactory(int num_threads, const TaskQueueOptions& options)
+    : pool_(new WorkerPool(num_threads), &WorkerPool::Destroy),
+      options_(options),
+      watchdog_(TaskQueueWatchdog::Create(options)) {}
+  std::unique_ptr<TaskQueueBase, TaskQueueDeleter> CreateTaskQueue(absl::string_view name,
+    Priority priority) const override {
+    return std::unique_ptr<TaskQueueBase, TaskQueueDeleter>(
+        new TaskQueueSequence(pool_, name, priority == Priority::HIGH, options_, watchdog_));
+  }
+
+ private:
+  // Shared with the sequences, which may outlive the factory.
+  const std::shared_ptr<WorkerPool> pool_;
+  const TaskQueueOptions options_;
+  const std::shared_ptr<TaskQueueWatchdog> watchdog_;
+};
+}  // namespace
+
+std::unique_ptr<TaskQueueFactory> CreateTaskQueuePoolFactory(int num_threads, const TaskQueueOptions& options) {
+  return std::make_unique<TaskQueuePoolFactory>(num_threads, options);
+}
+}  // namespace webrtc
@@ -0,0 +1,30 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_TASK_QUEUE_POOL_H_
+#define RTC_BASE_TASK_QUEUE_POOL_H_
+
+#include <memory>
+#include "task_queue_factory.h"
+#include "task_queue_options.h"
+
+namespace webrtc {
+// Creates task queues that do not own a thread. Each queue is a sequence:
+// its tasks run one at a time in posting order and IsCurrent() holds while
+// they run, but the sequences share `num_threads` worker threads (0 means
+// one per core) that steal runnable sequences from each other. Queues with
+// Priority::HIGH jump ahead of other runnable sequences. Thread attributes
+// given to CreateTaskQueue() are ignored.
+//
+// The queues share the threads with the factory and may outlive it; the
+// threads exit once the factory and every queue are gone.
+std::unique_ptr<TaskQueueFactory> CreateTaskQueuePoolFactory(int num_threads = 0,
+                                                             const TaskQueueOptions& options = TaskQueueOptions());
+}
+#endif  // RTC_BASE_TASK_QUEUE_POOL_H_
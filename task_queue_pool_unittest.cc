@@ -0,0 +1,92 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_queue_pool.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "event.h"
+#include "gtest/gtest.h"
+#include "time_delta.h"
+
+namespace webrtc {
+namespace {
+
+constexpr int kTimeoutMs = 5000;
+
+TEST(TaskQueuePoolTest, QueueOutlivesFactory) {
+  auto factory = CreateTaskQueuePoolFactory(2);
+  auto queue = factory->CreateTaskQueue("outlives", TaskQueueFactory::Priority::NORMAL);
+  factory.reset();
+  rtc::Event done;
+  queue->PostDelayedTask([&done] { done.Set(); }, TimeDelta::Millis(10));
+  EXPECT_TRUE(done.Wait(kTimeoutMs));
+}
+
+// The last reference to the sequence, and with it to the pool, may be
+// dropped on a worker.
+TEST(TaskQueuePoolTest, DeletesLastQueueWhileItsTaskRuns) {
+  for (int i = 0; i < 20; ++i) {
+    auto factory = CreateTaskQueuePoolFactory(1);
+    auto queue = factory->CreateTaskQueue("last", TaskQueueFactory::Priority::NORMAL);
+    factory.reset();
+    rtc::Event running;
+    queue->PostTask([&] {
+      queue->PostTask([] {});
+      running.Set();
+    });
+    ASSERT_TRUE(running.Wait(kTimeoutMs));
+    queue.reset();
+  }
+}
+
+TEST(TaskQueuePoolTest, RunsIdleTaskOnceThePoolIsIdle) {
+  auto factory = CreateTaskQueuePoolFactory(1);
+  auto idle_queue = factory->CreateTaskQueue("idle", TaskQueueFactory::Priority::NORMAL);
+  auto busy_queue = factory->CreateTaskQueue("busy", TaskQueueFactory::Priority::NORMAL);
+  rtc::Event done;
+  std::vector<int> order;
+  busy_queue->PostTask([&] {
+    // Both sequences become runnable on the only worker, the idle one first.
+    idle_queue->PostIdleTask([&] {
+      order.push_back(2);
+      done.Set();
+    });
+    busy_queue->PostTask([&] { order.push_back(1); });
+  });
+  ASSERT_TRUE(done.Wait(kTimeoutMs));
+  EXPECT_EQ(order, (std::vector<int>{1, 2}));
+}
+
+TEST(TaskQueuePoolTest, RunsIdleTaskAtItsDeadlineOnABusyPool) {
+  auto factory = CreateTaskQueuePoolFactory(1);
+  auto idle_queue = factory->CreateTaskQueue("idle", TaskQueueFactory::Priority::NORMAL);
+  auto busy_queue = factory->CreateTaskQueue("busy", TaskQueueFactory::Priority::NORMAL);
+  std::atomic<bool> stop{false};
+  rtc::Event done;
+  std::function<void()> spin = [&] {
+    if (!stop.load())
+      busy_queue->PostTask(spin);
+  };
+  busy_queue->PostTask(spin);
+  idle_queue->PostIdleTask(
+      [&] {
+        stop.store(true);
+        done.Set();
+      },
+      TimeDelta::Millis(20));
+  EXPECT_TRUE(done.Wait(kTimeoutMs));
+  stop.store(true);
+}
+
+}  // namespace
+}  // namespace webrtc
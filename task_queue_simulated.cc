@@ -0,0 +1,206 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_queue_simulated.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/functional/any_invocable.h"
+#include "delayed_task_store.h"
+#include "inline_task.h"
+
+namespace webrtc {
+
+class SimulatedTaskQueueFactory::Queue final : public TaskQueueBase {
+ public:
+  explicit Queue(const SimulatedTaskQueueFactory* factory)
+    : factory_(factory), timer_tasks_(CreateDelayedTaskStore(DelayedTaskPolicy::kHeap)) {}
+
+  void Delete() override { factory_->RemoveQueue(this); }
+  void PostTask(absl::AnyInvocable<void() &&> task) override { PostQueuedClosureImpl(std::move(task)); }
+
+  void Run(QueuedClosure task) {
+    CurrentTaskQueueSetter set_current(this);
+    std::move(task)();
+  }
+
+  const SimulatedTaskQueueFactory* const factory_;
+  // Guarded by the factory's mutex_.
+  std::deque<QueuedClosure> tasks_;
+  const std::unique_ptr<DelayedTaskStore> timer_tasks_;
+  bool running_ = false;
+  // Set by Delete() while a task of the queue runs; the queue is freed once
+  // it returns.
+  bool deleted_ = false;
+
+ protected:
+  void PostQueuedClosureImpl(QueuedClosure task) override {
+    std::lock_guard<std::mutex> lock(factory_->mutex_);
+    if (deleted_)
+      return;
+    tasks_.push_back(std::move(task));
+    factory_->ready_.push_back(this);
+  }
+
+  void PostDelayedTaskImpl(absl::AnyInvocable<void() &&> task, TimeDelta delay, DelayPrecision precision) override {
+    if (delay <= TimeDelta::Zero()) {
+      PostTask(std::move(task));
+      return;
+    }
+    std::lock_guard<std::mutex> lock(factory_->mutex_);
+    if (deleted_)
+      return;
+    timer_tasks_->Insert(factory_->now_, factory_->now_ + delay, QueuedClosure(std::move(task)));
+  }
+
+  // Nothing else runs the tasks, so the caller runs the simulation until the
+  // call is done. Queues whose task is waiting for a call are skipped.
+  void BlockingCallImpl(absl::FunctionRef<void()> functor) override {
+    if (IsCurrent()) {
+      functor();
+      return;
+    }
+    bool done = false;
+    PostTask([functor, &done] {
+      functor();
+      done = true;
+    });
+    while (!done) {
+      if (!factory_->RunReadyTask()) {
+        fprintf(stderr, "BlockingCall() on a simulated queue that waits for its caller\n");
+        abort();
+      }
+    }
+  }
+};
+
+SimulatedTaskQueueFactory::SimulatedTaskQueueFactory(Timestamp start_time) : now_(start_time) {}
+
+SimulatedTaskQueueFactory::~SimulatedTaskQueueFactory() = default;
+
+std::unique_ptr<TaskQueueBase, TaskQueueDeleter> SimulatedTaskQueueFactory::CreateTaskQueue(
+    absl::string_view name,
+    Priority priority) const {
+  Queue* queue = new Queue(this);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queues_.push_back(queue);
+  }
+  return std::unique_ptr<TaskQueueBase, TaskQueueDeleter>(queue);
+}
+
+Timestamp SimulatedTaskQueueFactory::Now() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return now_;
+}
+
+void SimulatedTaskQueueFactory::AdvanceTime(TimeDelta duration) {
+  Timestamp end = Timestamp::MinusInfinity();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    end = now_ + duration;
+  }
+  RunUntilIdle();
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      absl::optional<Timestamp> next;
+      for (Queue* queue : queues_) {
+        absl::optional<Timestamp> wakeup = queue->timer_tasks_->NextWakeupTime();
+        if (wakeup && (!next || *wakeup < *next))
+          next = wakeup;
+      }
+      if (!next || *next > end) {
+        now_ = end;
+        return;
+      }
+      // Every queue is idle: jump to the next deadline.
+      now_ = std::max(now_, *next);
+      MoveDueTasks();
+    }
+    RunUntilIdle();
+  }
+}
+
+void SimulatedTaskQueueFactory::RunUntilIdle() {
+  while (RunReadyTask()) {
+  }
+}
+
+void SimulatedTaskQueueFactory::RemoveQueue(Queue* queue) const {
+  std::deque<QueuedClosure> dropped;
+  bool running;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queues_.erase(std::find(queues_.begin(), queues_.end(), queue));
+    ready_.erase(std::remove(ready_.begin(), ready_.end(), queue), ready_.end());
+    dropped.swap(queue->tasks_);
+    queue->deleted_ = true;
+    running = queue->running_;
+  }
+  // The dropped closures may post tasks of their own as they are destroyed,
+  // so they go outside the lock.
+  dropped.clear();
+  if (!running)
+    delete queue;
+}
+
+void SimulatedTaskQueueFactory::MoveDueTasks() const {
+  struct Due {
+    Timestamp due_time;
+    Queue* queue;
+    QueuedClosure task;
+  };
+  std::vector<Due> due;
+  std::vector<DelayedTaskStore::DueTask> taken;
+  for (Queue* queue : queues_) {
+    taken.clear();
+    queue->timer_tasks_->TakeDueTasks(now_, &taken);
+    for (DelayedTaskStore::DueTask& task : taken)
+      due.push_back({task.due_time, queue, std::move(task.task)});
+  }
+  // Ties go to the queue created first.
+  std::stable_sort(due.begin(), due.end(), [](const Due& a, const Due& b) { return a.due_time < b.due_time; });
+  for (Due& task : due) {
+    task.queue->tasks_.push_back(std::move(task.task));
+    ready_.push_back(task.queue);
+  }
+}
+
+bool SimulatedTaskQueueFactory::RunReadyTask() const {
+  Queue* queue = nullptr;
+  QueuedClosure task;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find_if(ready_.begin(), ready_.end(), [](const Queue* ready) { return !ready->running_; });
+    if (it == ready_.end())
+      return false;
+    queue = *it;
+    ready_.erase(it);
+    task = std::move(queue->tasks_.front());
+    queue->tasks_.pop_front();
+    queue->running_ = true;
+  }
+  queue->Run(std::move(task));
+  bool deleted;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue->running_ = false;
+    deleted = queue->deleted_;
+  }
+  if (deleted)
+    delete queue;
+  return true;
+}
+
+}  // namespace webrtc
@@ -0,0 +1,79 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_TASK_QUEUE_SIMULATED_H_
+#define RTC_BASE_TASK_QUEUE_SIMULATED_H_
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "task_queue_factory.h"
+#include "time_delta.h"
+#include "timestamp.h"
+
+namespace webrtc {
+
+// Creates task queues that run against a virtual clock, for tests. The
+// queues have no thread: their tasks run on the thread that calls
+// AdvanceTime() or RunUntilIdle(), one at a time, with IsCurrent() holding
+// for the queue of the running task. Tasks become ready in posting order
+// across all queues and run in that order; delayed tasks become ready when
+// the clock reaches their deadline, in deadline order, and the clock jumps
+// straight to the next deadline once every queue is idle. A run is therefore
+// deterministic and takes no real time, however much simulated time passes.
+//
+// Delayed tasks run exactly on their deadline, whatever their precision.
+// Queue priorities, lanes and thread attributes are ignored. Code under test
+// must read the time from Now(), not from rtc::TimeMicros(). Tasks may be
+// posted from any thread, but only one thread, not a task, may drive the
+// simulation; BlockingCall() must be made from that thread or from a task.
+// Every queue must be deleted before the factory.
+class SimulatedTaskQueueFactory : public TaskQueueFactory {
+ public:
+  explicit SimulatedTaskQueueFactory(Timestamp start_time = Timestamp::Seconds(10000));
+  SimulatedTaskQueueFactory(const SimulatedTaskQueueFactory&) = delete;
+  SimulatedTaskQueueFactory& operator=(const SimulatedTaskQueueFactory&) = delete;
+  ~SimulatedTaskQueueFactory() override;
+
+  std::unique_ptr<TaskQueueBase, TaskQueueDeleter> CreateTaskQueue(absl::string_view name,
+                                                                   Priority priority) const override;
+
+  // The virtual clock.
+  Timestamp Now() const;
+  // Runs every task that becomes ready within the next `duration` of
+  // simulated time, then leaves the clock `duration` ahead.
+  void AdvanceTime(TimeDelta duration);
+  // Runs the tasks that are ready, and those they post, without moving the
+  // clock.
+  void RunUntilIdle();
+
+ private:
+  class Queue;
+
+  void RemoveQueue(Queue* queue) const;
+  // Makes the delayed tasks due at now_ ready, in deadline order. Called
+  // with mutex_ held.
+  void MoveDueTasks() const;
+  // Runs one ready task of a queue that is not running a task already.
+  // Returns false if there is none.
+  bool RunReadyTask() const;
+
+  mutable std::mutex mutex_;
+  // Guarded by mutex_.
+  mutable Timestamp now_;
+  mutable std::vector<Queue*> queues_;
+  // One entry per ready task, in the order the tasks became ready.
+  mutable std::deque<Queue*> ready_;
+};
+
+}  // namespace webrtc
+#endif  // RTC_BASE_TASK_QUEUE_SIMULATED_H_
@@ -0,0 +1,73 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_queue_simulated.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "time_delta.h"
+#include "time_utils.h"
+#include "timestamp.h"
+
+namespace webrtc {
+namespace {
+
+TEST(SimulatedTaskQueueTest, RunsDelayedTaskOnItsVirtualDeadline) {
+  SimulatedTaskQueueFactory factory;
+  auto queue = factory.CreateTaskQueue("simulated", TaskQueueFactory::Priority::NORMAL);
+  const Timestamp start = factory.Now();
+  const int64_t real_start_us = rtc::TimeMicros();
+  Timestamp ran_at = Timestamp::MinusInfinity();
+  queue->PostDelayedTask([&] { ran_at = factory.Now(); }, TimeDelta::Seconds(30));
+
+  factory.AdvanceTime(TimeDelta::Seconds(30) - TimeDelta::Millis(1));
+  EXPECT_TRUE(ran_at.IsMinusInfinity());
+  factory.AdvanceTime(TimeDelta::Millis(1));
+  EXPECT_EQ(ran_at, start + TimeDelta::Seconds(30));
+  EXPECT_EQ(factory.Now(), start + TimeDelta::Seconds(30));
+  EXPECT_LT(rtc::TimeMicros() - real_start_us, 1000000);
+}
+
+TEST(SimulatedTaskQueueTest, RunsReadyTasksInPostingOrderAcrossQueues) {
+  SimulatedTaskQueueFactory factory;
+  auto first = factory.CreateTaskQueue("first", TaskQueueFactory::Priority::NORMAL);
+  auto second = factory.CreateTaskQueue("second", TaskQueueFactory::Priority::HIGH);
+  std::vector<int> order;
+  first->PostTask([&] { order.push_back(1); });
+  second->PostTask([&] {
+    EXPECT_TRUE(second->IsCurrent());
+    order.push_back(2);
+  });
+  first->PostTask([&] { order.push_back(3); });
+  factory.RunUntilIdle();
+  EXPECT_EQ(order, (std::vector<int>{1, 2, 3}));
+}
+
+TEST(SimulatedTaskQueueTest, RunsDelayedTasksInDeadlineOrder) {
+  SimulatedTaskQueueFactory factory;
+  auto queue = factory.CreateTaskQueue("simulated", TaskQueueFactory::Priority::NORMAL);
+  std::vector<int> order;
+  queue->PostDelayedTask([&] { order.push_back(3); }, TimeDelta::Millis(30));
+  queue->PostDelayedTask([&] { order.push_back(1); }, TimeDelta::Millis(10));
+  queue->PostDelayedTask([&] { order.push_back(2); }, TimeDelta::Millis(20));
+  factory.RunUntilIdle();
+  EXPECT_TRUE(order.empty());
+  factory.AdvanceTime(TimeDelta::Millis(30));
+  EXPECT_EQ(order, (std::vector<int>{1, 2, 3}));
+}
+
+TEST(SimulatedTaskQueueTest, BlockingCallRunsTheSimulation) {
+  SimulatedTaskQueueFactory factory;
+  auto queue = factory.CreateTaskQueue("simulated", TaskQueueFactory::Priority::NORMAL);
+  EXPECT_EQ(queue->BlockingCall([&] { return queue->IsCurrent(); }), true);
+}
+
+}  // namespace
+}  // namespace webrtc
@@ -0,0 +1,57 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef API_TASK_QUEUE_TASK_QUEUE_STATS_H_
+#define API_TASK_QUEUE_TASK_QUEUE_STATS_H_
+
+#include <stdint.h>
+
+#include <array>
+
+namespace webrtc {
+
+// Copy of a duration histogram with power-of-two buckets: bucket 0 counts
+// durations below 1 us and bucket i > 0 those in [2^(i-1), 2^i) us. The last
+// bucket also takes everything longer.
+struct HistogramSnapshot {
+  static constexpr int kBuckets = 32;
+
+  // Upper bound, in microseconds, of the bucket holding the `fraction`
+  // (0..1) quantile; 0 if the histogram is empty.
+  int64_t PercentileUs(double fraction) const;
+
+  uint64_t count = 0;
+  int64_t sum_us = 0;
+  int64_t max_us = 0;
+  std::array<uint64_t, kBuckets> buckets = {};
+};
+
+// Point-in-time statistics of one task queue, see TaskQueueBase::GetStats().
+struct TaskQueueStats {
+  // Tasks posted for immediate execution that have not started yet, and the
+  // highest that number has been.
+  int64_t pending_tasks = 0;
+  int64_t peak_pending_tasks = 0;
+  // Delayed tasks waiting for their deadline.
+  int64_t delayed_tasks = 0;
+  uint64_t tasks_run = 0;
+  // Times the queue woke up to run tasks, and how many of those were caused
+  // by its delayed task timer.
+  uint64_t wakeups = 0;
+  uint64_t timer_wakeups = 0;
+  // PostTask to start of the task, immediate tasks only.
+  HistogramSnapshot queue_latency;
+  // Start to end of every task.
+  HistogramSnapshot run_time;
+  // Start of a delayed task minus its deadline.
+  HistogramSnapshot timer_lateness;
+};
+
+}  // namespace webrtc
+#endif  // API_TASK_QUEUE_TASK_QUEUE_STATS_H_
@@ -0,0 +1,272 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <time.h>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "event.h"
+#include "gtest/gtest.h"
+#include "task_queue_factory.h"
+#include "task_queue_for_test.h"
+
+namespace webrtc {
+namespace {
+
+constexpr int kTimeoutMs = 5000;
+
+TEST(TaskQueueTest, RunsIdleTaskOnQuietQueue) {
+  auto factory = CreateNativeTaskQueueFactory();
+  auto queue = factory->CreateTaskQueue("idle", TaskQueueFactory::Priority::NORMAL);
+  rtc::Event done;
+  queue->PostIdleTask([&done] { done.Set(); });
+  EXPECT_TRUE(done.Wait(kTimeoutMs));
+}
+
+TEST(TaskQueueTest, RunsIdleTasksAfterNormalTasks) {
+  auto factory = CreateNativeTaskQueueFactory();
+  auto queue = factory->CreateTaskQueue("idle", TaskQueueFactory::Priority::NORMAL);
+  rtc::Event done;
+  int order = 0;
+  int idle_order = 0;
+  int normal_order = 0;
+  queue->PostTask([&] {
+    queue->PostIdleTask([&] {
+      idle_order = ++order;
+      done.Set();
+    });
+    queue->PostTask([&] { normal_order = ++order; });
+  });
+  ASSERT_TRUE(done.Wait(kTimeoutMs));
+  EXPECT_EQ(normal_order, 1);
+  EXPECT_EQ(idle_order, 2);
+}
+
+TEST(TaskQueueTest, RunsTasksOfEachProducerInPostingOrder) {
+  constexpr int kProducers = 4;
+  constexpr int kTasksPerProducer = 5000;
+  auto factory = CreateNativeTaskQueueFactory();
+  auto queue = factory->CreateTaskQueue("fifo", TaskQueueFactory::Priority::NORMAL);
+  // Only touched on the queue.
+  std::vector<int> next(kProducers, 0);
+  int out_of_order = 0;
+  int ran = 0;
+  rtc::Event done;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&, p] {
+      for (int i = 0; i < kTasksPerProducer; ++i) {
+        queue->PostTask([&, p, i] {
+          if (next[p] != i)
+            ++out_of_order;
+          next[p] = i + 1;
+          if (++ran == kProducers * kTasksPerProducer)
+            done.Set();
+        });
+      }
+    });
+  }
+  for (std::thread& producer : producers)
+    producer.join();
+  ASSERT_TRUE(done.Wait(kTimeoutMs));
+  EXPECT_EQ(out_of_order, 0);
+}
+
+TEST(TaskQueueTest, BlockingCallReturnsTheResult) {
+  auto factory = CreateNativeTaskQueueFactory();
+  auto queue = factory->CreateTaskQueue("blocking", TaskQueueFactory::Priority::NORMAL);
+  EXPECT_EQ(queue->BlockingCall([] { return 42; }), 42);
+  std::unique_ptr<int> moved = queue->BlockingCall([] { return std::make_unique<int>(7); });
+  ASSERT_TRUE(moved);
+  EXPECT_EQ(*moved, 7);
+  EXPECT_TRUE(queue->BlockingCall([&] { return queue->IsCurrent(); }));
+}
+
+TEST(TaskQueueTest, BlockingCallFromItsOwnQueueRunsInline) {
+  auto factory = CreateNativeTaskQueueFactory();
+  auto queue = factory->CreateTaskQueue("blocking", TaskQueueFactory::Priority::NORMAL);
+  int value = 0;
+  queue->BlockingCall([&] { queue->BlockingCall([&] { value = 1; }); });
+  EXPECT_EQ(value, 1);
+}
+
+TEST(TaskQueueTest, BlockingCallBetweenQueues) {
+  auto factory = CreateNativeTaskQueueFactory();
+  auto first = factory->CreateTaskQueue("first", TaskQueueFactory::Priority::NORMAL);
+  auto second = factory->CreateTaskQueue("second", TaskQueueFactory::Priority::NORMAL);
+  EXPECT_TRUE(first->BlockingCall([&] { return second->BlockingCall([&] { return second->IsCurrent(); }); }));
+}
+
+#if !defined(NDEBUG) && GTEST_HAS_DEATH_TEST
+TEST(TaskQueueDeathTest, BlockingCallCycleAborts) {
+  GTEST_FLAG_SET(death_test_style, "threadsafe");
+  EXPECT_DEATH(
+      {
+        auto factory = CreateNativeTaskQueueFactory();
+        auto first = factory->CreateTaskQueue("first", TaskQueueFactory::Priority::NORMAL);
+        auto second = factory->CreateTaskQueue("second", TaskQueueFactory::Priority::NORMAL);
+        first->BlockingCall([&] { second->BlockingCall([&] { first->BlockingCall([] {}); }); });
+      },
+      "deadlocks");
+}
+#endif
+
+#if !defined(_WIN32)
+int64_t ThreadCpuTimeUs() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Once the lanes are empty the loop blocks again instead of polling.
+TEST(TaskQueueTest, BlocksAfterIdleTasksRan) {
+  auto factory = CreateNativeTaskQueueFactory();
+  auto queue = factory->CreateTaskQueue("idle", TaskQueueFactory::Priority::NORMAL);
+  rtc::Event started;
+  int64_t start_us = 0;
+  queue->PostIdleTask([&] {
+    start_us = ThreadCpuTimeUs();
+    started.Set();
+  });
+  ASSERT_TRUE(started.Wait(kTimeoutMs));
+  timespec pause = {0, 200 * 1000 * 1000};
+  nanosleep(&pause, nullptr);
+  rtc::Event measured;
+  int64_t end_us = 0;
+  queue->PostTask([&] {
+    end_us = ThreadCpuTimeUs();
+    measured.Set();
+  });
+  ASSERT_TRUE(measured.Wait(kTimeoutMs));
+  EXPECT_LT(end_us - start_us, 50000);
+}
+
+// Non-blocking pipe, closed on destruction.
+class Pipe {
+ public:
+  Pipe() { EXPECT_EQ(::pipe2(fds_, O_NONBLOCK | O_CLOEXEC), 0); }
+  ~Pipe() {
+    ::close(fds_[0]);
+    ::close(fds_[1]);
+  }
+  int read_fd() const { return fds_[0]; }
+  void Write() { EXPECT_EQ(::write(fds_[1], "x", 1), 1); }
+  // Reads until the pipe would block, returns the number of bytes read.
+  int Drain() {
+    char buffer[16];
+    int total = 0;
+    ssize_t n;
+    while ((n = ::read(fds_[0], buffer, sizeof(buffer))) > 0)
+      total += static_cast<int>(n);
+    return total;
+  }
+
+ private:
+  int fds_[2] = {-1, -1};
+};
+
+TEST(TaskQueueTest, RegisterFdRunsCallbackOnTheQueueWhenReadable) {
+  auto factory = CreateNativeTaskQueueFactory();
+  auto queue = factory->CreateTaskQueue("fd", TaskQueueFactory::Priority::NORMAL);
+  Pipe pipe;
+  rtc::Event readable;
+  int bytes = 0;
+  int calls = 0;
+  ASSERT_TRUE(queue->RegisterFd(pipe.read_fd(), TaskQueueBase::kFdReadable, [&](int events) {
+    EXPECT_TRUE(queue->IsCurrent());
+    EXPECT_EQ(events, TaskQueueBase::kFdReadable);
+    ++calls;
+    bytes += pipe.Drain();
+    if (bytes == 2)
+      readable.Set();
+  }));
+  EXPECT_FALSE(queue->RegisterFd(pipe.read_fd(), TaskQueueBase::kFdReadable, [](int events) {}));
+  pipe.Write();
+  pipe.Write();
+  ASSERT_TRUE(readable.Wait(kTimeoutMs));
+  // Drained, so not ready any more: an iteration of the loop calls nothing.
+  const int calls_when_drained = queue->BlockingCall([&] { return calls; });
+  queue->BlockingCall([] {});
+  EXPECT_EQ(queue->BlockingCall([&] { return calls; }), calls_when_drained);
+  queue->UnregisterFd(pipe.read_fd());
+}
+
+// The callback leaves its pipe readable and unregisters it: level triggered,
+// it would run again on every iteration otherwise.
+TEST(TaskQueueTest, UnregisterFdFromItsOwnCallbackStopsTheCalls) {
+  auto factory = CreateNativeTaskQueueFactory();
+  auto queue = factory->CreateTaskQueue("fd", TaskQueueFactory::Priority::NORMAL);
+  Pipe pipe;
+  rtc::Event called;
+  int calls = 0;
+  auto alive = std::make_shared<int>(0);
+  std::weak_ptr<int> watch = alive;
+  ASSERT_TRUE(queue->RegisterFd(pipe.read_fd(), TaskQueueBase::kFdReadable, [&, alive = std::move(alive)](int events) {
+    ++calls;
+    queue->UnregisterFd(pipe.read_fd());
+    // Destroyed only once it returns.
+    EXPECT_EQ(*alive, 0);
+    called.Set();
+  }));
+  pipe.Write();
+  ASSERT_TRUE(called.Wait(kTimeoutMs));
+  for (int i = 0; i < 3; ++i)
+    queue->BlockingCall([] {});
+  EXPECT_EQ(queue->BlockingCall([&] { return calls; }), 1);
+  EXPECT_TRUE(watch.expired());
+  // The descriptor can be watched again.
+  rtc::Event called_again;
+  ASSERT_TRUE(queue->RegisterFd(pipe.read_fd(), TaskQueueBase::kFdReadable, [&](int events) {
+    pipe.Drain();
+    called_again.Set();
+  }));
+  EXPECT_TRUE(called_again.Wait(kTimeoutMs));
+  queue->UnregisterFd(pipe.read_fd());
+}
+
+// Both pipes are found ready by the same wait; whichever callback runs first
+// unregisters the other, which then must not run.
+TEST(TaskQueueTest, UnregisterFdFromAnotherCallbackSkipsReadinessAlreadySeen) {
+  auto factory = CreateNativeTaskQueueFactory();
+  auto queue = factory->CreateTaskQueue("fd", TaskQueueFactory::Priority::NORMAL);
+  Pipe pipes[2];
+  int calls = 0;
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_TRUE(queue->RegisterFd(pipes[i].read_fd(), TaskQueueBase::kFdReadable, [&, i](int events) {
+      ++calls;
+      pipes[i].Drain();
+      queue->UnregisterFd(pipes[1 - i].read_fd());
+    }));
+  }
+  rtc::Event blocked;
+  rtc::Event release;
+  queue->PostTask([&] {
+    blocked.Set();
+    release.Wait(kTimeoutMs);
+  });
+  ASSERT_TRUE(blocked.Wait(kTimeoutMs));
+  pipes[0].Write();
+  pipes[1].Write();
+  release.Set();
+  for (int i = 0; i < 3; ++i)
+    queue->BlockingCall([] {});
+  EXPECT_EQ(queue->BlockingCall([&] { return calls; }), 1);
+  for (Pipe& pipe : pipes)
+    queue->UnregisterFd(pipe.read_fd());
+}
+#endif
+
+}  // namespace
+}  // namespace webrtc
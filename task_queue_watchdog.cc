@@ -0,0 +1,159 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_queue_watchdog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "time_utils.h"
+
+namespace webrtc {
+namespace {
+
+// Samples per threshold; a report comes at most this fraction of the
+// threshold late.
+constexpr int kSamplesPerThreshold = 4;
+
+// The watchdog whose monitor thread this is, if any.
+thread_local const TaskQueueWatchdog* current_watchdog = nullptr;
+
+int SampleIntervalMs(TimeDelta slow_task_threshold, TimeDelta stalled_queue_threshold) {
+  const TimeDelta threshold = std::min(slow_task_threshold, stalled_queue_threshold);
+  if (!threshold.IsFinite())
+    return 1000;
+  return static_cast<int>(std::max<int64_t>((threshold / kSamplesPerThreshold).ms(), 1));
+}
+
+}  // namespace
+
+TaskQueueWatchdog::Probe::Probe(absl::string_view queue_name, std::function<bool()> has_pending)
+  : queue_name_(queue_name), has_pending_(std::move(has_pending)) {}
+
+std::shared_ptr<TaskQueueWatchdog> TaskQueueWatchdog::Create(const TaskQueueOptions& options) {
+  if (!options.watchdog ||
+      (!options.slow_task_threshold.IsFinite() && !options.stalled_queue_threshold.IsFinite()))
+    return nullptr;
+  return std::shared_ptr<TaskQueueWatchdog>(
+      new TaskQueueWatchdog(options.slow_task_threshold, options.stalled_queue_threshold, options.watchdog),
+      &TaskQueueWatchdog::Destroy);
+}
+
+void TaskQueueWatchdog::Destroy(TaskQueueWatchdog* watchdog) {
+  // A callback that deletes the last queue of a deleted factory drops the
+  // last reference on the monitor thread, which cannot join itself.
+  if (current_watchdog == watchdog)
+    rtc::PlatformThread::SpawnDetached([watchdog] { delete watchdog; }, "TaskQueueWatchdogExit");
+  else
+    delete watchdog;
+}
+
+TaskQueueWatchdog::TaskQueueWatchdog(TimeDelta slow_task_threshold,
+                                     TimeDelta stalled_queue_threshold,
+                                     std::function<void(const TaskQueueWatchdogReport&)> callback)
+  : slow_task_threshold_(slow_task_threshold),
+    stalled_queue_threshold_(stalled_queue_threshold),
+    callback_(std::move(callback)),
+    sample_interval_ms_(SampleIntervalMs(slow_task_threshold, stalled_queue_threshold)) {
+  thread_ = rtc::PlatformThread::SpawnJoinable([this] { Run(); }, "TaskQueueWatchdog");
+}
+
+TaskQueueWatchdog::~TaskQueueWatchdog() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  quit_cv_.notify_all();
+  thread_.Finalize();
+}
+
+TaskQueueWatchdog::Probe* TaskQueueWatchdog::Register(absl::string_view queue_name,
+                                                      std::function<bool()> has_pending) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  probes_.push_back(std::unique_ptr<Probe>(new Probe(queue_name, std::move(has_pending))));
+  return probes_.back().get();
+}
+
+void TaskQueueWatchdog::Unregister(Probe* probe) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = std::find_if(probes_.begin(), probes_.end(),
+                         [probe](const std::unique_ptr<Probe>& registered) { return registered.get() == probe; });
+  if (it != probes_.end())
+    probes_.erase(it);
+}
+
+void TaskQueueWatchdog::Run() {
+  current_watchdog = this;
+  std::vector<TaskQueueWatchdogReport> reports;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      // steady_clock based, like rtc::TimeMicros().
+      quit_cv_.wait_for(lock, std::chrono::milliseconds(sample_interval_ms_), [this] { return quit_; });
+      if (quit_)
+        return;
+      Sample(rtc::TimeMicros(), &reports);
+    }
+    // Outside the lock, so that the callback may create and delete queues.
+    for (const TaskQueueWatchdogReport& report : reports)
+      callback_(report);
+    reports.clear();
+  }
+}
+
+void TaskQueueWatchdog::Sample(int64_t now_us, std::vector<TaskQueueWatchdogReport>* reports) {
+  for (const std::unique_ptr<Probe>& probe : probes_) {
+    if (slow_task_threshold_.IsFinite()) {
+      const uint64_t task = probe->tasks_.load(std::memory_order_acquire);
+      if (task != probe->sampled_task_) {
+        // A task started since the last sample, or the queue went idle.
+        probe->sampled_task_ = task;
+        probe->task_seen_us_ = now_us;
+        probe->task_reported_ = false;
+      } else if ((task & 1) != 0 && !probe->task_reported_ &&
+                 now_us - probe->task_seen_us_ >= slow_task_threshold_.us()) {
+        TaskQueueWatchdogReport report;
+        report.kind = TaskQueueWatchdogReport::Kind::kSlowTask;
+        report.queue_name = probe->queue_name_;
+        report.posted_from_file = probe->file_.load(std::memory_order_relaxed);
+        report.posted_from_line = probe->line_.load(std::memory_order_relaxed);
+        report.elapsed = TimeDelta::Micros(now_us - probe->task_seen_us_);
+        // The post site may already be that of a later task.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (probe->tasks_.load(std::memory_order_relaxed) == task) {
+          probe->task_reported_ = true;
+          reports->push_back(std::move(report));
+        }
+      }
+    }
+    if (stalled_queue_threshold_.IsFinite()) {
+      const uint64_t takes = probe->takes_.load(std::memory_order_relaxed);
+      const bool pending = probe->has_pending_();
+      if (takes != probe->sampled_takes_ || !pending) {
+        // The queue took its tasks since the last sample; the ones pending
+        // now were posted after.
+        probe->sampled_takes_ = takes;
+        probe->pending_seen_us_ = pending ? now_us : -1;
+        probe->stall_reported_ = false;
+      } else if (probe->pending_seen_us_ < 0) {
+        probe->pending_seen_us_ = now_us;
+      } else if (!probe->stall_reported_ && now_us - probe->pending_seen_us_ >= stalled_queue_threshold_.us()) {
+        TaskQueueWatchdogReport report;
+        report.kind = TaskQueueWatchdogReport::Kind::kStalledQueue;
+        report.queue_name = probe->queue_name_;
+        report.elapsed = TimeDelta::Micros(now_us - probe->pending_seen_us_);
+        probe->stall_reported_ = true;
+        reports->push_back(std::move(report));
+      }
+    }
+  }
+}
+
+}  // namespace webrtc
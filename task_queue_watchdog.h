@@ -0,0 +1,132 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_TASK_QUEUE_WATCHDOG_H_
+#define RTC_BASE_TASK_QUEUE_WATCHDOG_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "platform_thread.h"
+#include "task_queue_options.h"
+
+namespace webrtc {
+
+// Monitor thread of a task queue factory, see TaskQueueOptions::watchdog.
+// Each queue of the factory registers a Probe and marks the tasks it runs;
+// the monitor samples the probes a few times per threshold. A task counts as
+// slow once the probe shows it still running for longer than the threshold,
+// a queue as stalled once it has had pending tasks, and not taken any, for
+// longer than the threshold.
+class TaskQueueWatchdog {
+ public:
+  class Probe {
+   public:
+    Probe(const Probe&) = delete;
+    Probe& operator=(const Probe&) = delete;
+
+    // Queue side, from the thread running the queue's tasks. `file` is the
+    // post site of the task, or null.
+    void TaskStarted(const char* file, int line) {
+      // Keeps the post site of this task from becoming visible before the
+      // end of the previous one.
+      std::atomic_thread_fence(std::memory_order_release);
+      file_.store(file, std::memory_order_relaxed);
+      line_.store(line, std::memory_order_relaxed);
+      tasks_.store(tasks_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    void TaskFinished() { tasks_.store(tasks_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+    // Called whenever the queue takes its pending tasks.
+    void PendingTaken() { takes_.store(takes_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+   private:
+    friend class TaskQueueWatchdog;
+    Probe(absl::string_view queue_name, std::function<bool()> has_pending);
+
+    const std::string queue_name_;
+    // Tells whether tasks are pending; called on the monitor thread.
+    const std::function<bool()> has_pending_;
+    // Odd while a task runs.
+    std::atomic<uint64_t> tasks_{0};
+    std::atomic<const char*> file_{nullptr};
+    std::atomic<int> line_{0};
+    std::atomic<uint64_t> takes_{0};
+
+    // Monitor thread state.
+    uint64_t sampled_task_ = 0;
+    int64_t task_seen_us_ = 0;
+    bool task_reported_ = false;
+    uint64_t sampled_takes_ = 0;
+    int64_t pending_seen_us_ = -1;
+    bool stall_reported_ = false;
+  };
+
+  // Marks a task as running on the queue of `probe`, if not null, while it
+  // lives.
+  class RunningTask {
+   public:
+    explicit RunningTask(Probe* probe, const char* file = nullptr, int line = 0) : probe_(probe) {
+      if (probe_)
+        probe_->TaskStarted(file, line);
+    }
+    RunningTask(const RunningTask&) = delete;
+    RunningTask& operator=(const RunningTask&) = delete;
+    ~RunningTask() {
+      if (probe_)
+        probe_->TaskFinished();
+    }
+
+   private:
+    Probe* const probe_;
+  };
+
+  // Null unless `options` enable the watchdog. The callback may delete
+  // queues, even the last reference to the watchdog.
+  static std::shared_ptr<TaskQueueWatchdog> Create(const TaskQueueOptions& options);
+
+  TaskQueueWatchdog(TimeDelta slow_task_threshold,
+                    TimeDelta stalled_queue_threshold,
+                    std::function<void(const TaskQueueWatchdogReport&)> callback);
+  TaskQueueWatchdog(const TaskQueueWatchdog&) = delete;
+  TaskQueueWatchdog& operator=(const TaskQueueWatchdog&) = delete;
+  // Every probe must have been unregistered. Not on the monitor thread.
+  ~TaskQueueWatchdog();
+
+  Probe* Register(absl::string_view queue_name, std::function<bool()> has_pending);
+  // Once this returns, the monitor no longer uses the probe or its
+  // `has_pending`.
+  void Unregister(Probe* probe);
+
+ private:
+  // Deleter of the watchdogs made by Create().
+  static void Destroy(TaskQueueWatchdog* watchdog);
+  void Run();
+  void Sample(int64_t now_us, std::vector<TaskQueueWatchdogReport>* reports);
+
+  const TimeDelta slow_task_threshold_;
+  const TimeDelta stalled_queue_threshold_;
+  const std::function<void(const TaskQueueWatchdogReport&)> callback_;
+  const int sample_interval_ms_;
+  std::mutex mutex_;
+  std::condition_variable quit_cv_;
+  std::vector<std::unique_ptr<Probe>> probes_;  // Guarded by mutex_.
+  bool quit_ = false;  // Guarded by mutex_.
+  rtc::PlatformThread thread_;
+};
+
+}  // namespace webrtc
+#endif  // RTC_BASE_TASK_QUEUE_WATCHDOG_H_
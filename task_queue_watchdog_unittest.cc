@@ -0,0 +1,84 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_queue_watchdog.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "event.h"
+#include "gtest/gtest.h"
+#include "task_queue_factory.h"
+#include "task_queue_for_test.h"
+#include "task_queue_options.h"
+#include "task_queue_pool.h"
+#include "time_delta.h"
+
+namespace webrtc {
+namespace {
+
+constexpr int kTimeoutMs = 5000;
+
+TEST(TaskQueueWatchdogTest, ReportsSlowTask) {
+  std::mutex mutex;
+  std::vector<TaskQueueWatchdogReport> reports;
+  rtc::Event reported;
+  auto factory = CreateNativeTaskQueueFactory(TaskQueueOptions().SetWatchdog(
+      TimeDelta::Millis(20), TimeDelta::PlusInfinity(), [&](const TaskQueueWatchdogReport& report) {
+        std::lock_guard<std::mutex> lock(mutex);
+        reports.push_back(report);
+        reported.Set();
+      }));
+  auto queue = factory->CreateTaskQueue("slow", TaskQueueFactory::Priority::NORMAL);
+  rtc::Event release;
+  queue->PostTask([&release] { release.Wait(kTimeoutMs); });
+  EXPECT_TRUE(reported.Wait(kTimeoutMs));
+  release.Set();
+  queue = nullptr;
+  std::lock_guard<std::mutex> lock(mutex);
+  ASSERT_EQ(reports.size(), 1u);
+  EXPECT_EQ(reports[0].kind, TaskQueueWatchdogReport::Kind::kSlowTask);
+  EXPECT_EQ(reports[0].queue_name, "slow");
+}
+
+// With the factory gone, the callback holds the last reference to the
+// watchdog through the queue it deletes. The watchdog then goes away after
+// the test, so the callback only uses state it shares.
+void ExpectCallbackMayDeleteLastQueue(std::unique_ptr<TaskQueueFactory> (*create)(const TaskQueueOptions&)) {
+  struct State {
+    std::unique_ptr<TaskQueueBase, TaskQueueDeleter> queue;
+    rtc::Event release;
+    rtc::Event deleted;
+  };
+  auto state = std::make_shared<State>();
+  auto factory = create(TaskQueueOptions().SetWatchdog(
+      TimeDelta::Millis(20), TimeDelta::PlusInfinity(), [state](const TaskQueueWatchdogReport&) {
+        state->release.Set();
+        state->queue = nullptr;
+        state->deleted.Set();
+      }));
+  state->queue = factory->CreateTaskQueue("last", TaskQueueFactory::Priority::NORMAL);
+  factory = nullptr;
+  state->queue->PostTask([state] { state->release.Wait(kTimeoutMs); });
+  EXPECT_TRUE(state->deleted.Wait(kTimeoutMs));
+}
+
+TEST(TaskQueueWatchdogTest, CallbackMayDeleteLastQueue) {
+  ExpectCallbackMayDeleteLastQueue(&CreateNativeTaskQueueFactory);
+}
+
+TEST(TaskQueueWatchdogTest, CallbackMayDeleteLastPoolQueue) {
+  ExpectCallbackMayDeleteLastQueue(
+      [](const TaskQueueOptions& options) { return CreateTaskQueuePoolFactory(1, options); });
+}
+
+}  // namespace
+}  // namespace webrtc
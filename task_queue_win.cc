@@ -16,32 +16,36 @@
 #include <mmsystem.h>  // Must come after windows headers.
 #include <string.h>
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <queue>
 #include <utility>
-#include <chrono>
+#include <vector>
 
 #include "absl/functional/any_invocable.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "task_queue_base.h"
 #include "arraysize.h"
-#include "event.h"
+#include "delayed_task_store.h"
+#include "fd_watch_set.h"
+#include "high_precision_spinner.h"
+#include "inline_task.h"
+#include "mpsc_queue.h"
 #include "platform_thread.h"
-
+#include "run_loop_slice.h"
+#include "task_lanes.h"
+#include "task_node_pool.h"
+#include "task_queue_limiter.h"
+#include "task_queue_metrics.h"
+#include "task_queue_watchdog.h"
+#include "task_trace.h"
+#include "thread_cache.h"
+#include "time_utils.h"
 
 namespace webrtc {
 namespace {
-#define WM_QUEUE_DELAYED_TASK WM_USER + 2
-
-void CALLBACK InitializeQueueThread(ULONG_PTR param) {
-  MSG msg;
-  ::PeekMessage(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
-  rtc::Event* data = reinterpret_cast<rtc::Event*>(param);
-  data->Set();
-}
-
 rtc::ThreadPriority TaskQueuePriorityToThreadPriority(
   TaskQueueFactory::Priority priority) {
   switch (priority) {
@@ -54,40 +58,78 @@ rtc::ThreadPriority TaskQueuePriorityToThreadPriority(
   }
 }
 
-int64_t CurrentTime() {
-  auto duration_now = std::chrono::system_clock::now().time_since_epoch();
-  int64_t time = std::chrono::duration_cast<std::chrono::milliseconds>(duration_now).count();
-  return time;
+// The queue's own handles lead the wait array: the timer event and in_queue_.
+// Socket events registered with RegisterFd() follow.
+constexpr DWORD kQueueHandles = 2;
+
+long ToNetworkEvents(int events) {
+  long network_events = 0;
+  if (events & TaskQueueBase::kFdReadable)
+    network_events |= FD_READ | FD_ACCEPT | FD_CLOSE;
+  if (events & TaskQueueBase::kFdWritable)
+    network_events |= FD_WRITE | FD_CONNECT;
+  return network_events;
+}
+
+int FromNetworkEvents(long network_events) {
+  int events = 0;
+  if (network_events & (FD_READ | FD_ACCEPT | FD_CLOSE))
+    events |= TaskQueueBase::kFdReadable;
+  if (network_events & (FD_WRITE | FD_CONNECT))
+    events |= TaskQueueBase::kFdWritable;
+  return events;
 }
 
+// `due_time` is the earliest time the task may run; `slack` is how much later
+// it may run to share a wakeup with other timers, zero for high precision.
 class DelayedTaskInfo {
  public:
-  DelayedTaskInfo() {}
-  DelayedTaskInfo(std::chrono::milliseconds delay, absl::AnyInvocable<void()&&> task)
-    :task_(std::move(task))
-  {
-  }
-  DelayedTaskInfo(int delay, absl::AnyInvocable<void() &&> task)
-    : delay_time_(delay), task_(std::move(task)), create_time_(std::chrono::system_clock::now()){}
+  DelayedTaskInfo(Timestamp due_time, TimeDelta slack, QueuedClosure task)
+    : due_time_(due_time), slack_(slack), task_(std::move(task)), trace_flow_(TaskTrace::OnPosted()) {}
+  DelayedTaskInfo(Timestamp due_time, TimeDelta slack, rtc::scoped_refptr<CancelableTaskState> task)
+    : due_time_(due_time), slack_(slack), cancelable_(std::move(task)) {}
   DelayedTaskInfo(DelayedTaskInfo&&) = default;
-  bool operator>(const DelayedTaskInfo& other) const {
-    return due_time() > other.due_time();
-  }
   DelayedTaskInfo& operator=(DelayedTaskInfo&& other) = default;
-  void Run() const {
-    std::move(task_)();
-  }
-  int64_t due_time() const
-  {
-    auto duration = create_time_.time_since_epoch();
-    int64_t millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
-    return millis + delay_time_.count();
+  // Capacity the task takes on a bounded queue; none if it is cancelable.
+  size_t Charge() const { return cancelable_ ? 0 : TaskQueueLimiter::Charge(sizeof(DelayedTaskInfo), task_); }
+  void InsertInto(DelayedTaskStore& store, HighPrecisionSpinner& spinner, Timestamp now, size_t charge) {
+    const Timestamp due_time = store.CoalescedDueTime(due_time_, slack_);
+    if (slack_.IsZero())
+      spinner.AddDeadline(due_time);
+    if (cancelable_)
+      store.Insert(now, due_time, std::move(cancelable_));
+    else
+      store.Insert(now, due_time, TaskTrace::Bind(trace_flow_, std::move(task_)), charge);
   }
 
  private:
-  std::chrono::milliseconds delay_time_;
-  std::chrono::time_point<std::chrono::system_clock> create_time_ = std::chrono::system_clock::now();
-  mutable absl::AnyInvocable<void() &&> task_;
+  Timestamp due_time_;
+  TimeDelta slack_;
+  QueuedClosure task_;
+  rtc::scoped_refptr<CancelableTaskState> cancelable_;
+  uint64_t trace_flow_ = 0;
+};
+
+struct PendingTask : public MpscNode {
+  explicit PendingTask(QueuedClosure task) : task(std::move(task)) {}
+  QueuedClosure task;
+  // Set instead of `task` for delayed tasks; they reach the timer store
+  // through in_queue_ like immediate tasks, so posting needs no thread
+  // message queue. Owned by the queue's delayed_pool_.
+  DelayedTaskInfo* delayed = nullptr;
+  // Set for PostLowPriorityTask and PostIdleTask, with the task's deadline.
+  TaskQueueBase::TaskLane lane = TaskQueueBase::TaskLane::kNormal;
+  Timestamp lane_deadline = Timestamp::PlusInfinity();
+  // Post time of an immediate task, only recorded with metrics enabled.
+  int64_t posted_us = 0;
+  // Flow from the post to the run of an immediate or lane task, only
+  // recorded while tracing. A delayed task keeps its own.
+  uint64_t trace_flow = 0;
+  // Post site of an immediate task, only recorded with a watchdog.
+  const char* posted_from_file = nullptr;
+  int posted_from_line = 0;
+  // Capacity the task holds on a bounded queue.
+  size_t charge = 0;
 };
 
 class MultimediaTimer {
@@ -122,128 +164,500 @@ class MultimediaTimer {
 
 class TaskQueueWin : public TaskQueueBase {
  public:
-  TaskQueueWin(absl::string_view queue_name, rtc::ThreadPriority priority);
+  TaskQueueWin(absl::string_view queue_name,
+               const rtc::ThreadAttributes& attributes,
+               const TaskQueueOptions& options,
+               std::shared_ptr<rtc::ThreadCache> thread_cache,
+               std::shared_ptr<TaskQueueWatchdog> watchdog);
   ~TaskQueueWin() override = default;
 
   virtual void Delete() override;
   virtual void PostTask(absl::AnyInvocable<void() &&> task) override;
-  virtual void PostDelayedTask(absl::AnyInvocable<void() &&> task, int delay) override;
-  virtual void PostDelayedHighPrecisionTask(absl::AnyInvocable<void() &&> task, int delay) override;
   void RunPendingTasks();
+  absl::optional<TaskQueueStats> GetStats() const override;
+ protected:
+  void PostDelayedTaskImpl(absl::AnyInvocable<void() &&> task, TimeDelta delay, DelayPrecision precision) override;
+  void PostCancelableDelayedTaskImpl(rtc::scoped_refptr<CancelableTaskState> task, TimeDelta delay, DelayPrecision precision) override;
+  void PostTasksImpl(std::vector<BatchedTask> tasks) override;
+  void PostQueuedClosureImpl(QueuedClosure task) override;
+  void PostLaneTaskImpl(TaskLane lane, absl::AnyInvocable<void() &&> task, TimeDelta deadline) override;
+  bool TryPostTaskImpl(absl::AnyInvocable<void() &&> task) override;
+  void PostDroppableTaskImpl(absl::AnyInvocable<void() &&> task) override;
+  bool RegisterFdImpl(NativeFd fd, int events, absl::AnyInvocable<void(int events)> callback) override;
+  void UnregisterFdImpl(NativeFd fd) override;
  private:
+  bool Admit(PendingTask* task, bool try_only = false);
+  TimeDelta Slack(TimeDelta delay, DelayPrecision precision) const;
+  void PostDelayedTaskInfo(DelayedTaskInfo* task_info);
+  void PushPending(PendingTask* task);
+  void DeletePendingTask(PendingTask* task);
   void RunThreadMain();
   bool ProcessQueuedMessages();
-  void RunDueTasks();
+  bool RunDueTasks();
+  void RunLaneTasks(bool idle);
+  void DispatchFdEvents(DWORD wait_result, DWORD count);
+  bool SpinToHighPrecisionDeadline();
+  // Work left over from an iteration whose budget ran out. Lane tasks are
+  // not backlog: the idle lane only runs once there is none.
+  bool HasBacklog() const { return carry_ != nullptr || due_next_ < due_tasks_.size(); }
   void ScheduleNextTimer();
   void CancelTimers();
 
   MultimediaTimer timer_;
-  std::priority_queue<DelayedTaskInfo, std::vector<DelayedTaskInfo>, std::greater<DelayedTaskInfo>> timer_tasks_;
+  std::unique_ptr<DelayedTaskStore> timer_tasks_;
+  const TimeDelta low_precision_slack_;
+  HighPrecisionSpinner spinner_;
+  TaskLanes lanes_;
+  const TimeDelta low_priority_budget_;
+  // Due tasks taken from timer_tasks_; those from due_next_ on have not run.
+  std::vector<DelayedTaskStore::DueTask> due_tasks_;
+  size_t due_next_ = 0;
+  // Rest of the pending batch, oldest first, when the immediate task budget
+  // ran out before the batch did.
+  PendingTask* carry_ = nullptr;
+  const RunLoopBudget immediate_task_budget_;
+  const RunLoopBudget timer_budget_;
+  const RunLoopBudget message_budget_;
+  // Null unless TaskQueueOptions::enable_metrics.
+  const std::unique_ptr<TaskQueueMetrics> metrics_;
+  // Null unless TaskQueueOptions::capacity sets a limit.
+  const std::unique_ptr<TaskQueueLimiter> limiter_;
   UINT_PTR timer_id_ = 0;
-  rtc::PlatformThread thread_;
-  std::queue<absl::AnyInvocable<void() &&>> pending_;
+  // Shared with the factory, which the queue may outlive.
+  const std::shared_ptr<rtc::ThreadCache> thread_cache_;
+  rtc::ThreadCache::Thread* thread_ = nullptr;
+  // Null unless the factory has a watchdog.
+  const std::shared_ptr<TaskQueueWatchdog> watchdog_;
+  TaskQueueWatchdog::Probe* watchdog_probe_ = nullptr;
+  std::atomic<bool> quit_{false};
+  // Task nodes and delayed task records are recycled per queue rather than
+  // allocated per post and freed on the queue thread.
+  TaskNodePool<PendingTask> task_pool_;
+  TaskNodePool<DelayedTaskInfo> delayed_pool_;
+  MpscQueue<PendingTask> pending_;
   HANDLE in_queue_;
+  // What the queue thread waits on: kQueueHandles, then one WSAEventSelect()
+  // event per socket of fd_sockets_, in the same order.
+  std::vector<HANDLE> wait_handles_;
+  std::vector<SOCKET> fd_sockets_;
+  FdWatchSet fd_watches_;
+  // Sockets found ready by DispatchFdEvents(), kept for its capacity.
+  std::vector<std::pair<NativeFd, int>> ready_fds_;
 };
 
-TaskQueueWin::TaskQueueWin(absl::string_view queue_name, rtc::ThreadPriority priority)
-  : in_queue_(::CreateEvent(nullptr, true, false, nullptr)) {
-  thread_ = rtc::PlatformThread::SpawnJoinable([this] { RunThreadMain(); }, queue_name, rtc::ThreadAttributes().SetPriority(priority));
-  rtc::Event event(false, false);
-  thread_.QueueAPC(&InitializeQueueThread, reinterpret_cast<ULONG_PTR>(&event));
-  event.Wait(rtc::Event::kForever);
+TaskQueueWin::TaskQueueWin(absl::string_view queue_name,
+                           const rtc::ThreadAttributes& attributes,
+                           const TaskQueueOptions& options,
+                           std::shared_ptr<rtc::ThreadCache> thread_cache,
+                           std::shared_ptr<TaskQueueWatchdog> watchdog)
+  : timer_tasks_(CreateDelayedTaskStore(options.delayed_task_policy)),
+    low_precision_slack_(options.low_precision_slack),
+    spinner_(options.high_precision_spin, options.high_precision_spin_budget),
+    low_priority_budget_(options.low_priority_budget),
+    immediate_task_budget_(options.immediate_task_budget),
+    timer_budget_(options.timer_budget),
+    message_budget_(options.message_budget),
+    metrics_(options.enable_metrics ? std::make_unique<TaskQueueMetrics>() : nullptr),
+    limiter_(TaskQueueLimiter::Create(options.capacity, queue_name)),
+    thread_cache_(std::move(thread_cache)),
+    watchdog_(std::move(watchdog)),
+    in_queue_(::CreateEvent(nullptr, true, false, nullptr)),
+    wait_handles_({*timer_.event_for_wait(), in_queue_}) {
+  // Nothing is posted to the thread's message queue, so there is no need to
+  // wait for the thread to create one.
+  if (watchdog_)
+    watchdog_probe_ = watchdog_->Register(queue_name, [this] { return !pending_.empty(); });
+  thread_ = thread_cache_->Start([this] { RunThreadMain(); }, queue_name, attributes);
 }
 
 void TaskQueueWin::Delete() {
-  while (!::PostThreadMessage(GetThreadId(*thread_.GetHandle()), WM_QUIT, 0, 0)) {
-    Sleep(1);
+  // Producers blocked on a full queue must be out before it goes away.
+  if (limiter_)
+    limiter_->Close();
+  quit_.store(true, std::memory_order_release);
+  ::SetEvent(in_queue_);
+  thread_cache_->Join(thread_);
+  if (watchdog_)
+    watchdog_->Unregister(watchdog_probe_);
+  for (PendingTask* task : {carry_, pending_.PopAll()}) {
+    while (task != nullptr) {
+      PendingTask* next = MpscQueue<PendingTask>::Next(task);
+      DeletePendingTask(task);
+      task = next;
+    }
+  }
+  for (size_t i = 0; i < fd_sockets_.size(); ++i) {
+    ::WSAEventSelect(fd_sockets_[i], nullptr, 0);
+    ::WSACloseEvent(wait_handles_[kQueueHandles + i]);
   }
-  thread_.Finalize();
   ::CloseHandle(in_queue_);
   delete this;
 }
 
 void TaskQueueWin::PostTask(absl::AnyInvocable<void() &&> task) {
-  pending_.push(std::move(task));
-  ::SetEvent(in_queue_);
+  PendingTask* pending = task_pool_.New(std::move(task));
+  if (Admit(pending))
+    PushPending(pending);
 }
 
-void TaskQueueWin::PostDelayedTask(absl::AnyInvocable<void() &&> task, int delay) {
-  if (delay <= 0) {
+void TaskQueueWin::PostQueuedClosureImpl(QueuedClosure task) {
+  PendingTask* pending = task_pool_.New(std::move(task));
+  if (Admit(pending))
+    PushPending(pending);
+}
+
+bool TaskQueueWin::TryPostTaskImpl(absl::AnyInvocable<void() &&> task) {
+  PendingTask* pending = task_pool_.New(std::move(task));
+  if (!Admit(pending, /*try_only=*/true))
+    return false;
+  PushPending(pending);
+  return true;
+}
+
+void TaskQueueWin::PostDroppableTaskImpl(absl::AnyInvocable<void() &&> task) {
+  if (!limiter_) {
     PostTask(std::move(task));
     return;
   }
-  auto* task_info = new DelayedTaskInfo(delay, std::move(task));
-  if (!::PostThreadMessage(GetThreadId(*thread_.GetHandle()), WM_QUEUE_DELAYED_TASK, 0, reinterpret_cast<LPARAM>(task_info))) {
-    delete task_info;
+  QueuedClosure droppable = limiter_->AdmitDroppable(std::move(task), this, sizeof(PendingTask), IsCurrent());
+  if (droppable)
+    PushPending(task_pool_.New(std::move(droppable)));
+}
+
+// Charges `task` to a bounded queue. Returns false, and drops the task, if
+// the queue is full and the overflow policy, or `try_only`, rejects it.
+bool TaskQueueWin::Admit(PendingTask* task, bool try_only) {
+  if (!limiter_ || task->lane != TaskLane::kNormal)
+    return true;
+  const size_t charge =
+      task->delayed ? task->delayed->Charge() : TaskQueueLimiter::Charge(sizeof(PendingTask), task->task);
+  if (charge == 0)
+    return true;
+  if (!(try_only ? limiter_->TryAdmit(charge) : limiter_->Admit(charge, IsCurrent()))) {
+    DeletePendingTask(task);
+    return false;
+  }
+  task->charge = charge;
+  return true;
+}
+
+void TaskQueueWin::PushPending(PendingTask* task) {
+  if (metrics_ && task->lane == TaskLane::kNormal && !task->delayed)
+    task->posted_us = metrics_->OnPosted();
+  if (!task->delayed) {
+    task->trace_flow = TaskTrace::OnPosted();
+    if (watchdog_probe_) {
+      if (const Location* site = TaskTrace::PostSite::Current()) {
+        task->posted_from_file = site->file();
+        task->posted_from_line = site->line();
+      }
+    }
+  }
+  // Only the producer that makes the queue non-empty signals; in_queue_ is a
+  // manual-reset event that stays set until the queue thread drains the batch.
+  if (pending_.Push(task))
+    ::SetEvent(in_queue_);
+}
+
+absl::optional<TaskQueueStats> TaskQueueWin::GetStats() const {
+  if (!metrics_)
+    return absl::nullopt;
+  return metrics_->GetStats();
+}
+
+void TaskQueueWin::DeletePendingTask(PendingTask* task) {
+  if (task->delayed)
+    delayed_pool_.Delete(task->delayed);
+  task_pool_.Delete(task);
+}
+
+bool TaskQueueWin::RegisterFdImpl(NativeFd fd, int events, absl::AnyInvocable<void(int events)> callback) {
+  // MsgWaitForMultipleObjectsEx() takes at most MAXIMUM_WAIT_OBJECTS - 1
+  // handles.
+  if (wait_handles_.size() >= MAXIMUM_WAIT_OBJECTS - 1 || !fd_watches_.Add(fd, events, std::move(callback)))
+    return false;
+  const SOCKET socket = static_cast<SOCKET>(fd);
+  WSAEVENT event = ::WSACreateEvent();
+  if (event == WSA_INVALID_EVENT || ::WSAEventSelect(socket, event, ToNetworkEvents(events)) != 0) {
+    if (event != WSA_INVALID_EVENT)
+      ::WSACloseEvent(event);
+    fd_watches_.Remove(fd);
+    return false;
   }
+  wait_handles_.push_back(event);
+  fd_sockets_.push_back(socket);
+  return true;
 }
 
-void TaskQueueWin::PostDelayedHighPrecisionTask(absl::AnyInvocable<void() &&> task, int delay) {
-  PostDelayedTask(std::move(task), delay);
+void TaskQueueWin::UnregisterFdImpl(NativeFd fd) {
+  if (!fd_watches_.Remove(fd))
+    return;
+  auto it = std::find(fd_sockets_.begin(), fd_sockets_.end(), static_cast<SOCKET>(fd));
+  const size_t index = kQueueHandles + (it - fd_sockets_.begin());
+  // The socket stays non-blocking.
+  ::WSAEventSelect(*it, nullptr, 0);
+  ::WSACloseEvent(wait_handles_[index]);
+  wait_handles_.erase(wait_handles_.begin() + index);
+  fd_sockets_.erase(it);
 }
 
-void TaskQueueWin::RunPendingTasks() {
-  while (true) {
-    absl::AnyInvocable<void() &&> task;
-    {
-      if (pending_.empty())
-        break;
-      task = std::move(pending_.front());
-      pending_.pop();
+// Dispatches the sockets that have network events, given the result of a
+// wait on `count` handles. The wait reports only the lowest signalled handle,
+// which is one of the queue's own while tasks keep coming, so the sockets are
+// polled unless it was one of theirs. From the first signalled socket on,
+// every socket is checked; reading its network events resets its event.
+void TaskQueueWin::DispatchFdEvents(DWORD wait_result, DWORD count) {
+  if (fd_sockets_.empty())
+    return;
+  size_t first;
+  if (wait_result >= WAIT_OBJECT_0 + kQueueHandles && wait_result < WAIT_OBJECT_0 + count) {
+    first = wait_result - WAIT_OBJECT_0 - kQueueHandles;
+  } else {
+    // Tasks of this iteration may have changed the sockets since the wait.
+    const DWORD polled = ::WaitForMultipleObjects(static_cast<DWORD>(fd_sockets_.size()),
+                                                  wait_handles_.data() + kQueueHandles, FALSE, 0);
+    if (polled >= WAIT_OBJECT_0 + fd_sockets_.size())
+      return;
+    first = polled - WAIT_OBJECT_0;
+  }
+  ready_fds_.clear();
+  for (size_t i = first; i < fd_sockets_.size(); ++i) {
+    WSANETWORKEVENTS network_events;
+    if (::WSAEnumNetworkEvents(fd_sockets_[i], wait_handles_[kQueueHandles + i], &network_events) == 0 &&
+        network_events.lNetworkEvents != 0)
+      ready_fds_.emplace_back(fd_sockets_[i], FromNetworkEvents(network_events.lNetworkEvents));
+  }
+  // Callbacks may register and unregister sockets; Dispatch() skips the
+  // ones that are gone.
+  for (const std::pair<NativeFd, int>& ready : ready_fds_) {
+    TaskQueueWatchdog::RunningTask running(watchdog_probe_);
+    fd_watches_.Dispatch(ready.first, ready.second);
+  }
+}
+
+void TaskQueueWin::PostLaneTaskImpl(TaskLane lane, absl::AnyInvocable<void() &&> task, TimeDelta deadline) {
+  const Timestamp due_time = TaskLanes::Deadline(rtc::CurrentTimestamp(), deadline);
+  if (IsCurrent()) {
+    lanes_.Add(lane, TaskTrace::Bind(TaskTrace::OnPosted(), std::move(task)), due_time);
+    return;
+  }
+  PendingTask* pending = task_pool_.New(std::move(task));
+  pending->lane = lane;
+  pending->lane_deadline = due_time;
+  PushPending(pending);
+}
+
+void TaskQueueWin::PostDelayedTaskImpl(absl::AnyInvocable<void() &&> task, TimeDelta delay, DelayPrecision precision) {
+  if (delay <= TimeDelta::Zero()) {
+    PostTask(std::move(task));
+    return;
+  }
+  PostDelayedTaskInfo(delayed_pool_.New(rtc::CurrentTimestamp() + delay, Slack(delay, precision), std::move(task)));
+}
+
+void TaskQueueWin::PostCancelableDelayedTaskImpl(rtc::scoped_refptr<CancelableTaskState> task, TimeDelta delay, DelayPrecision precision) {
+  if (delay <= TimeDelta::Zero()) {
+    PostTask([task = std::move(task)] { task->Run(); });
+    return;
+  }
+  PostDelayedTaskInfo(delayed_pool_.New(rtc::CurrentTimestamp() + delay, Slack(delay, precision), std::move(task)));
+}
+
+TimeDelta TaskQueueWin::Slack(TimeDelta delay, DelayPrecision precision) const {
+  return precision == DelayPrecision::kLow ? LowPrecisionSlack(delay, low_precision_slack_) : TimeDelta::Zero();
+}
+
+void TaskQueueWin::PostDelayedTaskInfo(DelayedTaskInfo* task_info) {
+  PendingTask* task = task_pool_.New(nullptr);
+  task->delayed = task_info;
+  if (Admit(task))
+    PushPending(task);
+}
+
+void TaskQueueWin::PostTasksImpl(std::vector<BatchedTask> tasks) {
+  if (tasks.empty())
+    return;
+  // The whole batch is published with one CAS and signalled with at most one
+  // SetEvent; RunPendingTasks re-arms the timer once for its delayed entries.
+  const Timestamp now = rtc::CurrentTimestamp();
+  int64_t posted_us = 0;
+  if (metrics_) {
+    posted_us = metrics_->OnPosted(std::count_if(tasks.begin(), tasks.end(), [](const BatchedTask& task) {
+      return task.delay <= TimeDelta::Zero();
+    }));
+  }
+  PendingTask* first = nullptr;
+  PendingTask* last = nullptr;
+  for (BatchedTask& batched : tasks) {
+    PendingTask* task;
+    if (batched.delay > TimeDelta::Zero()) {
+      task = task_pool_.New(nullptr);
+      task->delayed = delayed_pool_.New(now + batched.delay, Slack(batched.delay, batched.precision),
+                                        std::move(batched.task));
+    } else {
+      task = task_pool_.New(std::move(batched.task));
+      task->posted_us = posted_us;
+    }
+    if (!Admit(task)) {
+      if (metrics_ && batched.delay <= TimeDelta::Zero())
+        metrics_->OnDropped();
+      continue;
     }
+    if (!task->delayed)
+      task->trace_flow = TaskTrace::OnPosted();
+    if (first == nullptr)
+      first = task;
+    else
+      task->mpsc_next = last;
+    last = task;
+  }
+  if (first != nullptr && pending_.PushChain(first, last))
+    ::SetEvent(in_queue_);
+}
 
-    std::move(task)();
+void TaskQueueWin::RunPendingTasks() {
+  // One exchange takes the whole batch; tasks posted while it runs start the
+  // next batch and set in_queue_ again. What the budget leaves of a batch is
+  // finished, ahead of newer tasks, on the next iteration; once it is done the
+  // newer tasks are taken in the same call, as in_queue_ may already have been
+  // reset for them.
+  absl::optional<Timestamp> previous_wakeup = timer_tasks_->NextWakeupTime();
+  bool inserted = false;
+  if (watchdog_probe_)
+    watchdog_probe_->PendingTaken();
+  RunLoopSlice slice(immediate_task_budget_);
+  bool carried = carry_ != nullptr;
+  PendingTask* task = carried ? carry_ : pending_.PopAll();
+  while (task != nullptr && slice.Admit()) {
+    PendingTask* next = MpscQueue<PendingTask>::Next(task);
+    if (task->delayed) {
+      task->delayed->InsertInto(*timer_tasks_, spinner_, rtc::CurrentTimestamp(), task->charge);
+      inserted = true;
+    } else if (task->lane != TaskLane::kNormal) {
+      lanes_.Add(task->lane, TaskTrace::Bind(task->trace_flow, std::move(task->task)), task->lane_deadline);
+    } else {
+      if (limiter_)
+        limiter_->Release(task->charge);
+      TaskTrace::TaskScope scope(task->trace_flow);
+      TaskQueueWatchdog::RunningTask running(watchdog_probe_, task->posted_from_file, task->posted_from_line);
+      if (metrics_)
+        metrics_->RunTask(std::move(task->task), task->posted_us);
+      else
+        std::move(task->task)();
+    }
+    DeletePendingTask(task);
+    task = next;
+    if (task == nullptr && carried) {
+      task = pending_.PopAll();
+      carried = false;
+    }
+  }
+  carry_ = task;
+  if (!inserted)
+    return;
+  if (metrics_)
+    metrics_->SetDelayedTasks(timer_tasks_->size());
+  absl::optional<Timestamp> wakeup = timer_tasks_->NextWakeupTime();
+  if (wakeup && (!previous_wakeup || *wakeup < *previous_wakeup)) {
+    CancelTimers();
+    ScheduleNextTimer();
   }
 }
 
 void TaskQueueWin::RunThreadMain() {
   CurrentTaskQueueSetter set_current(this);
-  HANDLE handles[2] = {*timer_.event_for_wait(), in_queue_};
   while (true) {
-    DWORD result = ::MsgWaitForMultipleObjectsEx(2, handles, INFINITE, QS_ALLEVENTS, MWMO_ALERTABLE);
-    if (result == (WAIT_OBJECT_0 + 2)) {
+    // With work left over, or lane tasks waiting, only poll: the new events
+    // get their turn, then the leftovers continue. Otherwise block.
+    // MWMO_INPUTAVAILABLE also reports messages left over from an earlier
+    // iteration.
+    const bool poll = HasBacklog() || !lanes_.empty();
+    const DWORD count = static_cast<DWORD>(wait_handles_.size());
+    DWORD result = ::MsgWaitForMultipleObjectsEx(count, wait_handles_.data(), poll ? 0 : INFINITE, QS_ALLEVENTS,
+                                                 MWMO_ALERTABLE | MWMO_INPUTAVAILABLE);
+    if (quit_.load(std::memory_order_acquire))
+      break;
+    if (metrics_ && result != WAIT_TIMEOUT)
+      metrics_->OnWakeup();
+    if (result == (WAIT_OBJECT_0 + count)) {
       if (!ProcessQueuedMessages())
         break;
     }
 
-    if (result == WAIT_OBJECT_0 || (!timer_tasks_.empty() && ::WaitForSingleObject(*timer_.event_for_wait(), 0) == WAIT_OBJECT_0)) {
+    const bool timer_fired = result == WAIT_OBJECT_0 ||
+        (!timer_tasks_->empty() && ::WaitForSingleObject(*timer_.event_for_wait(), 0) == WAIT_OBJECT_0);
+    if (timer_fired) {
+      if (metrics_)
+        metrics_->OnTimerWakeup();
       timer_.Cancel();
-      RunDueTasks();
+    }
+    // Due timers are serviced on every iteration, not only when the timer
+    // fires, so a flood of immediate tasks or messages delays them by at most
+    // one budget.
+    bool reschedule = RunDueTasks();
+    if (timer_fired)
+      reschedule |= SpinToHighPrecisionDeadline();
+    if (timer_fired || reschedule) {
+      CancelTimers();
       ScheduleNextTimer();
     }
 
     if (result == (WAIT_OBJECT_0 + 1)) {
       ::ResetEvent(in_queue_);
-      RunPendingTasks();
+      // Delete() may have set quit_ and signalled after the check above;
+      // that signal was just reset, so the next wait would never end.
+      if (quit_.load(std::memory_order_acquire))
+        break;
     }
+    if (result == (WAIT_OBJECT_0 + 1) || carry_ != nullptr)
+      RunPendingTasks();
+    DispatchFdEvents(result, count);
+    // Idle tasks run on iterations that found no events and left no backlog.
+    RunLaneTasks(/*idle=*/result == WAIT_TIMEOUT && !HasBacklog());
   }
+  // The thread may go on to serve another queue.
+  CancelTimers();
+}
+
+void TaskQueueWin::RunLaneTasks(bool idle) {
+  if (lanes_.empty())
+    return;
+  QueuedClosure task;
+  auto run = [this, &task] {
+    TaskQueueWatchdog::RunningTask running(watchdog_probe_);
+    if (metrics_)
+      metrics_->RunLaneTask(std::move(task));
+    else
+      std::move(task)();
+  };
+  const Timestamp now = rtc::CurrentTimestamp();
+  while (lanes_.PopExpired(now, &task))
+    run();
+  // A slice of every iteration, so that a stream of normal tasks cannot
+  // starve the low priority lane.
+  const int64_t slice_end_us = now.us() + low_priority_budget_.us();
+  while (rtc::TimeMicros() < slice_end_us && lanes_.PopLowPriority(&task))
+    run();
+  // Nothing else was pending when this iteration polled; new work posted
+  // since is picked up before the next lane task.
+  if (idle && pending_.empty() && lanes_.PopAny(&task))
+    run();
 }
 
 bool TaskQueueWin::ProcessQueuedMessages() {
   MSG msg = {};
-  static constexpr std::chrono::milliseconds kMaxTaskProcessingTime(500);
-  auto duration = std::chrono::system_clock::now().time_since_epoch();
-  std::chrono::milliseconds start = std::chrono::duration_cast<std::chrono::milliseconds>(duration);
-  while (::PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE) && msg.message != WM_QUIT) {
+  // Messages beyond the budget stay queued for the next iteration.
+  RunLoopSlice slice(message_budget_);
+  while (slice.Admit() && ::PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE) && msg.message != WM_QUIT) {
     if (!msg.hwnd) {
       switch (msg.message) {
-        case WM_QUEUE_DELAYED_TASK: {
-          std::unique_ptr<DelayedTaskInfo> info(
-              reinterpret_cast<DelayedTaskInfo*>(msg.lParam));
-          bool need_to_schedule_timers =
-              timer_tasks_.empty() ||
-              timer_tasks_.top().due_time() > info->due_time();
-          timer_tasks_.push(std::move(*info));
-          if (need_to_schedule_timers) {
-            CancelTimers();
-            ScheduleNextTimer();
-          }
-          break;
-        }
         case WM_TIMER: {
           ::KillTimer(nullptr, msg.wParam);
           timer_id_ = 0;
+          if (metrics_)
+            metrics_->OnTimerWakeup();
           RunDueTasks();
+          SpinToHighPrecisionDeadline();
           ScheduleNextTimer();
           break;
         }
@@ -251,34 +665,65 @@ bool TaskQueueWin::ProcessQueuedMessages() {
           break;
       }
     } else {
+      // A window procedure stalls the queue like a task does.
+      TaskQueueWatchdog::RunningTask running(watchdog_probe_);
       ::TranslateMessage(&msg);
       ::DispatchMessage(&msg);
     }
-    auto duration_now = std::chrono::system_clock::now().time_since_epoch();
-    std::chrono::milliseconds now = std::chrono::duration_cast<std::chrono::milliseconds>(duration);
-    if (now > start + kMaxTaskProcessingTime)
-      break;
   }
   return msg.message != WM_QUIT;
 }
 
-void TaskQueueWin::RunDueTasks() {
-  auto now = CurrentTime();
-  do {
-    const auto& top = timer_tasks_.top();
-    if (top.due_time() > now)
-      break;
-    top.Run();
-    timer_tasks_.pop();
-  } while (!timer_tasks_.empty());
+// Runs due tasks within the timer budget and returns true if it took tasks
+// out of timer_tasks_, i.e. the timer must be re-armed.
+bool TaskQueueWin::RunDueTasks() {
+  bool took = false;
+  if (due_next_ == due_tasks_.size()) {
+    due_tasks_.clear();
+    due_next_ = 0;
+    const Timestamp now = rtc::CurrentTimestamp();
+    absl::optional<Timestamp> wakeup = timer_tasks_->NextWakeupTime();
+    if (!wakeup || *wakeup > now)
+      return false;
+    timer_tasks_->TakeDueTasks(now, &due_tasks_);
+    took = true;
+    if (metrics_)
+      metrics_->SetDelayedTasks(timer_tasks_->size());
+  }
+  RunLoopSlice slice(timer_budget_);
+  while (due_next_ < due_tasks_.size() && slice.Admit()) {
+    DelayedTaskStore::DueTask& due = due_tasks_[due_next_++];
+    if (limiter_)
+      limiter_->Release(due.charge);
+    TaskQueueWatchdog::RunningTask running(watchdog_probe_);
+    if (metrics_)
+      metrics_->RunDelayedTask(std::move(due.task), due.due_time);
+    else
+      std::move(due.task)();
+  }
+  return took;
+}
+
+// The multimedia timer overshoots by up to a few milliseconds; spin out the
+// last stretch before a high precision deadline instead. Posted tasks and
+// thread messages cut the spin short, after which the timer is re-armed in
+// the past and fires right away.
+bool TaskQueueWin::SpinToHighPrecisionDeadline() {
+  if (!spinner_.SpinToDeadline([this] { return !pending_.empty() || quit_.load(std::memory_order_relaxed) || HIWORD(::GetQueueStatus(QS_ALLINPUT)) != 0; }))
+    return false;
+  return RunDueTasks();
 }
 
 void TaskQueueWin::ScheduleNextTimer() {
-  if (timer_tasks_.empty())
+  absl::optional<Timestamp> wakeup = timer_tasks_->NextWakeupTime();
+  if (!wakeup)
     return;
+  if (spinner_.enabled())
+    wakeup = spinner_.TimerTime(rtc::CurrentTimestamp(), *wakeup);
 
-  const auto& next_task = timer_tasks_.top();
-  int64_t delay = next_task.due_time() - CurrentTime();
+  // The multimedia timer counts whole milliseconds; round up so that a
+  // deadline with a sub-millisecond part is never released early.
+  int64_t delay = (*wakeup - rtc::CurrentTimestamp()).RoundUpToMillis();
   delay = 0 > delay ? 0 : delay;
   uint32_t milliseconds = 5000;
   if (!timer_.StartOneShotTimer(delay))
@@ -295,15 +740,30 @@ void TaskQueueWin::CancelTimers() {
 
 class TaskQueueWinFactory : public TaskQueueFactory {
  public:
+  explicit TaskQueueWinFactory(const TaskQueueOptions& options)
+    : options_(options),
+      thread_cache_(std::make_shared<rtc::ThreadCache>(options.thread_cache_size)),
+      watchdog_(TaskQueueWatchdog::Create(options)) {}
   std::unique_ptr<TaskQueueBase, TaskQueueDeleter> CreateTaskQueue(absl::string_view name,
     Priority priority) const override {
+    return CreateTaskQueue(name, priority, rtc::ThreadAttributes());
+  }
+  std::unique_ptr<TaskQueueBase, TaskQueueDeleter> CreateTaskQueue(absl::string_view name,
+    Priority priority, const rtc::ThreadAttributes& attributes) const override {
+    rtc::ThreadAttributes thread_attributes = attributes;
+    thread_attributes.SetPriority(TaskQueuePriorityToThreadPriority(priority));
     return std::unique_ptr<TaskQueueBase, TaskQueueDeleter>(
-        new TaskQueueWin(name, TaskQueuePriorityToThreadPriority(priority)));
+        new TaskQueueWin(name, thread_attributes, options_, thread_cache_, watchdog_));
   }
+
+ private:
+  const TaskQueueOptions options_;
+  const std::shared_ptr<rtc::ThreadCache> thread_cache_;
+  const std::shared_ptr<TaskQueueWatchdog> watchdog_;
 };
 }  // namespace
 
-std::unique_ptr<TaskQueueFactory> CreateTaskQueueWinFactory() {
-  return std::make_unique<TaskQueueWinFactory>();
+std::unique_ptr<TaskQueueFactory> CreateTaskQueueWinFactory(const TaskQueueOptions& options) {
+  return std::make_unique<TaskQueueWinFactory>(options);
 }
 }  // namespace webrtc
\ No newline at end of file
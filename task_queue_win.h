@@ -13,8 +13,9 @@
 
 #include <memory>
 #include "task_queue_factory.h"
+#include "task_queue_options.h"
 
 namespace webrtc {
-std::unique_ptr<TaskQueueFactory> CreateTaskQueueWinFactory();
+std::unique_ptr<TaskQueueFactory> CreateTaskQueueWinFactory(const TaskQueueOptions& options = TaskQueueOptions());
 }
 #endif  // RTC_BASE_TASK_QUEUE_WIN_H_
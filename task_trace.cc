@@ -0,0 +1,458 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_trace.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "platform_thread_types.h"
+
+namespace webrtc {
+namespace {
+
+constexpr size_t kEventsPerThread = 8192;
+
+enum class EventType { kPost, kTask };
+
+struct Event {
+  EventType type;
+  rtc::PlatformThreadId tid;
+  // For kPost the post time; for kTask the span.
+  int64_t start_ns;
+  int64_t end_ns;
+  uint64_t flow;
+  // kPost only.
+  const char* file;
+  const char* function;
+  int line;
+};
+
+// Single-writer ring of events. Each slot carries a sequence number that is
+// odd while the owner writes it, so a reader copying a slot that is being
+// overwritten can tell and skip it.
+class EventRing {
+ public:
+  void Write(const Event& event) {
+    const uint64_t index = head_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[index % kEventsPerThread];
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.type.store(event.type, std::memory_order_relaxed);
+    slot.tid.store(event.tid, std::memory_order_relaxed);
+    slot.start_ns.store(event.start_ns, std::memory_order_relaxed);
+    slot.end_ns.store(event.end_ns, std::memory_order_relaxed);
+    slot.flow.store(event.flow, std::memory_order_relaxed);
+    slot.file.store(event.file, std::memory_order_relaxed);
+    slot.function.store(event.function, std::memory_order_relaxed);
+    slot.line.store(event.line, std::memory_order_relaxed);
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+    head_.store(index + 1, std::memory_order_release);
+  }
+
+  void Read(std::vector<Event>* events) const {
+    const uint64_t head = head_.load(std::memory_order_acquire);
+    for (uint64_t index = head > kEventsPerThread ? head - kEventsPerThread : 0; index < head; ++index) {
+      const Slot& slot = slots_[index % kEventsPerThread];
+      const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+      if (sequence != 2 * index + 2)
+        continue;
+      Event event;
+      event.type = slot.type.load(std::memory_order_relaxed);
+      event.tid = slot.tid.load(std::memory_order_relaxed);
+      event.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+      event.end_ns = slot.end_ns.load(std::memory_order_relaxed);
+      event.flow = slot.flow.load(std::memory_order_relaxed);
+      event.file = slot.file.load(std::memory_order_relaxed);
+      event.function = slot.function.load(std::memory_order_relaxed);
+      event.line = slot.line.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) == sequence)
+        events->push_back(event);
+    }
+  }
+
+  // Cleared when the owning thread exits; a new thread then takes the ring
+  // over, keeping the events already in it.
+  std::atomic<bool> owned{true};
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<EventType> type{EventType::kPost};
+    std::atomic<rtc::PlatformThreadId> tid{0};
+    std::atomic<int64_t> start_ns{0};
+    std::atomic<int64_t> end_ns{0};
+    std::atomic<uint64_t> flow{0};
+    std::atomic<const char*> file{nullptr};
+    std::atomic<const char*> function{nullptr};
+    std::atomic<int> line{0};
+  };
+
+  std::atomic<uint64_t> head_{0};
+  std::unique_ptr<Slot[]> slots_{new Slot[kEventsPerThread]};
+};
+
+// All rings ever created, and the thread names. Locked only to add a ring,
+// name a thread or export.
+struct Registry {
+  static Registry& Get() {
+    static Registry* const registry = new Registry();
+    return *registry;
+  }
+
+  std::mutex mutex;
+  std::vector<std::unique_ptr<EventRing>> rings;
+  std::unordered_map<rtc::PlatformThreadId, std::string> thread_names;
+};
+
+struct ThreadRing {
+  ~ThreadRing() {
+    if (ring)
+      ring->owned.store(false, std::memory_order_release);
+  }
+  EventRing* ring = nullptr;
+  rtc::PlatformThreadId tid = 0;
+};
+
+thread_local ThreadRing thread_ring;
+thread_local const Location* post_site = nullptr;
+std::atomic<uint64_t> next_flow{1};
+
+ThreadRing& CurrentRing() {
+  if (thread_ring.ring == nullptr) {
+    Registry& registry = Registry::Get();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto& ring : registry.rings) {
+      bool owned = false;
+      if (ring->owned.compare_exchange_strong(owned, true, std::memory_order_acquire)) {
+        thread_ring.ring = ring.get();
+        break;
+      }
+    }
+    if (thread_ring.ring == nullptr) {
+      registry.rings.push_back(std::make_unique<EventRing>());
+      thread_ring.ring = registry.rings.back().get();
+    }
+    thread_ring.tid = rtc::CurrentThreadId();
+  }
+  return thread_ring;
+}
+
+int ProcessId() {
+#if defined(_WIN32)
+  return static_cast<int>(::GetCurrentProcessId());
+#else
+  return static_cast<int>(::getpid());
+#endif
+}
+
+std::vector<Event> CollectEvents(std::unordered_map<rtc::PlatformThreadId, std::string>* thread_names) {
+  std::vector<Event> events;
+  Registry& registry = Registry::Get();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (const auto& ring : registry.rings)
+    ring->Read(&events);
+  *thread_names = registry.thread_names;
+  std::stable_sort(events.begin(), events.end(),
+                   [](const Event& a, const Event& b) { return a.start_ns < b.start_ns; });
+  return events;
+}
+
+std::string PostedFrom(const Event* post) {
+  if (post == nullptr)
+    return "unknown";
+  if (post->file == nullptr)
+    return "unknown";
+  return std::string(post->file) + ":" + std::to_string(post->line);
+}
+
+std::string TaskName(const Event* post) {
+  return post != nullptr && post->function != nullptr && post->function[0] != '\0' ? post->function : "Task";
+}
+
+std::string JsonString(const std::string& value) {
+  std::string out = "\"";
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out += escaped;
+    } else {
+      out += c;
+    }
+  }
+  out += '"';
+  return out;
+}
+
+// Minimal protobuf writer for the few perfetto.protos messages used below.
+class ProtoWriter {
+ public:
+  void Varint(int field, uint64_t value) {
+    Tag(field, 0);
+    RawVarint(value);
+  }
+  void Fixed64(int field, uint64_t value) {
+    Tag(field, 1);
+    for (int i = 0; i < 8; ++i)
+      out_ += static_cast<char>((value >> (8 * i)) & 0xff);
+  }
+  void Bytes(int field, const std::string& value) {
+    Tag(field, 2);
+    RawVarint(value.size());
+    out_ += value;
+  }
+  const std::string& str() const { return out_; }
+
+ private:
+  void Tag(int field, int wire_type) { RawVarint((static_cast<uint64_t>(field) << 3) | wire_type); }
+  void RawVarint(uint64_t value) {
+    while (value >= 0x80) {
+      out_ += static_cast<char>((value & 0x7f) | 0x80);
+      value >>= 7;
+    }
+    out_ += static_cast<char>(value);
+  }
+
+  std::string out_;
+};
+
+// Field numbers from perfetto/protos/perfetto/trace/.
+constexpr int kTracePacket = 1;
+constexpr int kPacketTimestamp = 8;
+constexpr int kPacketSequenceId = 10;
+constexpr int kPacketTrackEvent = 11;
+constexpr int kPacketSequenceFlags = 13;
+constexpr int kPacketTrackDescriptor = 60;
+constexpr int kTrackUuid = 1;
+constexpr int kTrackThread = 4;
+constexpr int kThreadPid = 1;
+constexpr int kThreadTid = 2;
+constexpr int kThreadName = 5;
+constexpr int kEventDebugAnnotations = 4;
+constexpr int kEventType = 9;
+constexpr int kEventTrackUuid = 11;
+constexpr int kEventName = 23;
+constexpr int kEventFlowIds = 47;
+constexpr int kEventTerminatingFlowIds = 48;
+constexpr int kAnnotationStringValue = 6;
+constexpr int kAnnotationName = 10;
+constexpr int kSliceBegin = 1;
+constexpr int kSliceEnd = 2;
+constexpr int kInstant = 3;
+constexpr uint32_t kSequenceId = 1;
+constexpr int kIncrementalStateCleared = 1;
+
+std::string PerfettoPacket(int64_t timestamp_ns, const ProtoWriter& event) {
+  ProtoWriter packet;
+  packet.Varint(kPacketTimestamp, timestamp_ns);
+  packet.Varint(kPacketSequenceId, kSequenceId);
+  packet.Bytes(kPacketTrackEvent, event.str());
+  return packet.str();
+}
+
+std::string PostedFromAnnotation(const Event* post) {
+  ProtoWriter annotation;
+  annotation.Bytes(kAnnotationName, "posted_from");
+  annotation.Bytes(kAnnotationStringValue, PostedFrom(post));
+  return annotation.str();
+}
+
+}  // namespace
+
+void TaskTrace::Start() {
+  enabled_.store(true, std::memory_order_relaxed);
+}
+
+void TaskTrace::Stop() {
+  enabled_.store(false, std::memory_order_relaxed);
+}
+
+TaskTrace::PostSite::PostSite(const Location& location) : previous_(post_site) {
+  post_site = &location;
+}
+
+TaskTrace::PostSite::~PostSite() {
+  post_site = previous_;
+}
+
+const Location* TaskTrace::PostSite::Current() {
+  return post_site;
+}
+
+uint64_t TaskTrace::RecordPost() {
+  ThreadRing& ring = CurrentRing();
+  const uint64_t flow = next_flow.fetch_add(1, std::memory_order_relaxed);
+  const int64_t now_ns = rtc::TimeNanos();
+  ring.ring->Write({EventType::kPost, ring.tid, now_ns, now_ns, flow, post_site ? post_site->file() : nullptr,
+                    post_site ? post_site->function() : nullptr, post_site ? post_site->line() : 0});
+  return flow;
+}
+
+void TaskTrace::RecordTask(uint64_t flow, int64_t start_ns) {
+  ThreadRing& ring = CurrentRing();
+  ring.ring->Write({EventType::kTask, ring.tid, start_ns, rtc::TimeNanos(), flow, nullptr, nullptr, 0});
+}
+
+QueuedClosure TaskTrace::Bind(uint64_t flow, QueuedClosure task) {
+  if (flow == 0)
+    return task;
+  return QueuedClosure([flow, task = std::move(task)]() mutable {
+    TaskScope scope(flow);
+    std::move(task)();
+  });
+}
+
+void TaskTrace::OnThreadNamed(const char* name) {
+  Registry& registry = Registry::Get();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.thread_names[rtc::CurrentThreadId()] = name;
+}
+
+std::string TaskTrace::ExportChromeJson() {
+  std::unordered_map<rtc::PlatformThreadId, std::string> thread_names;
+  const std::vector<Event> events = CollectEvents(&thread_names);
+  std::unordered_map<uint64_t, const Event*> posts;
+  for (const Event& event : events) {
+    if (event.type == EventType::kPost)
+      posts[event.flow] = &event;
+  }
+  const std::string pid = std::to_string(ProcessId());
+  std::string out = "{\"traceEvents\":[";
+  bool first = true;
+  auto add = [&](const std::string& json) {
+    if (!first)
+      out += ",\n";
+    first = false;
+    out += json;
+  };
+  auto ts = [](int64_t ns) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.3f", ns / 1000.0);
+    return std::string(buffer);
+  };
+  for (const auto& thread : thread_names) {
+    add("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" + pid + ",\"tid\":" + std::to_string(thread.first) +
+        ",\"args\":{\"name\":" + JsonString(thread.second) + "}}");
+  }
+  for (const Event& event : events) {
+    const std::string where = "\"pid\":" + pid + ",\"tid\":" + std::to_string(event.tid);
+    const std::string flow = std::to_string(event.flow);
+    if (event.type == EventType::kPost) {
+      // A zero-length slice for the flow to start from.
+      add("{\"ph\":\"X\",\"cat\":\"task_queue\",\"name\":\"PostTask\"," + where + ",\"ts\":" + ts(event.start_ns) +
+          ",\"dur\":0,\"args\":{\"posted_from\":" + JsonString(PostedFrom(&event)) + "}}");
+      add("{\"ph\":\"s\",\"cat\":\"task_queue\",\"name\":\"PostTask\",\"id\":" + flow + "," + where +
+          ",\"ts\":" + ts(event.start_ns) + "}");
+      continue;
+    }
+    auto post = posts.find(event.flow);
+    const Event* posted = post == posts.end() ? nullptr : post->second;
+    std::string args = "\"posted_from\":" + JsonString(PostedFrom(posted));
+    if (posted != nullptr)
+      args += ",\"queued_us\":" + ts(event.start_ns - posted->start_ns);
+    add("{\"ph\":\"X\",\"cat\":\"task_queue\",\"name\":" + JsonString(TaskName(posted)) + "," + where +
+        ",\"ts\":" + ts(event.start_ns) + ",\"dur\":" + ts(event.end_ns - event.start_ns) + ",\"args\":{" + args + "}}");
+    add("{\"ph\":\"f\",\"bp\":\"e\",\"cat\":\"task_queue\",\"name\":\"PostTask\",\"id\":" + flow + "," + where +
+        ",\"ts\":" + ts(event.start_ns) + "}");
+  }
+  out += "],\"displayTimeUnit\":\"ns\"}\n";
+  return out;
+}
+
+std::string TaskTrace::ExportPerfetto() {
+  std::unordered_map<rtc::PlatformThreadId, std::string> thread_names;
+  const std::vector<Event> events = CollectEvents(&thread_names);
+  std::unordered_map<uint64_t, const Event*> posts;
+  std::map<rtc::PlatformThreadId, bool> threads;
+  for (const Event& event : events) {
+    if (event.type == EventType::kPost)
+      posts[event.flow] = &event;
+    threads[event.tid] = true;
+  }
+  ProtoWriter trace;
+  // One track per thread, identified by its thread id.
+  bool first = true;
+  for (const auto& thread : threads) {
+    ProtoWriter descriptor;
+    descriptor.Varint(kTrackUuid, thread.first);
+    ProtoWriter thread_descriptor;
+    thread_descriptor.Varint(kThreadPid, ProcessId());
+    thread_descriptor.Varint(kThreadTid, thread.first);
+    auto name = thread_names.find(thread.first);
+    if (name != thread_names.end())
+      thread_descriptor.Bytes(kThreadName, name->second);
+    descriptor.Bytes(kTrackThread, thread_descriptor.str());
+    ProtoWriter packet;
+    packet.Varint(kPacketSequenceId, kSequenceId);
+    if (first)
+      packet.Varint(kPacketSequenceFlags, kIncrementalStateCleared);
+    first = false;
+    packet.Bytes(kPacketTrackDescriptor, descriptor.str());
+    trace.Bytes(kTracePacket, packet.str());
+  }
+  // Packets of a sequence must be in timestamp order; at equal times a slice
+  // ends before the next one begins.
+  struct Packet {
+    int64_t timestamp_ns;
+    int order;
+    std::string bytes;
+  };
+  std::vector<Packet> packets;
+  for (const Event& event : events) {
+    if (event.type == EventType::kPost) {
+      ProtoWriter instant;
+      instant.Varint(kEventType, kInstant);
+      instant.Varint(kEventTrackUuid, event.tid);
+      instant.Bytes(kEventName, "PostTask");
+      instant.Fixed64(kEventFlowIds, event.flow);
+      instant.Bytes(kEventDebugAnnotations, PostedFromAnnotation(&event));
+      packets.push_back({event.start_ns, 1, PerfettoPacket(event.start_ns, instant)});
+      continue;
+    }
+    auto post = posts.find(event.flow);
+    const Event* posted = post == posts.end() ? nullptr : post->second;
+    ProtoWriter begin;
+    begin.Varint(kEventType, kSliceBegin);
+    begin.Varint(kEventTrackUuid, event.tid);
+    begin.Bytes(kEventName, TaskName(posted));
+    begin.Fixed64(kEventTerminatingFlowIds, event.flow);
+    begin.Bytes(kEventDebugAnnotations, PostedFromAnnotation(posted));
+    packets.push_back({event.start_ns, 2, PerfettoPacket(event.start_ns, begin)});
+    ProtoWriter end;
+    end.Varint(kEventType, kSliceEnd);
+    end.Varint(kEventTrackUuid, event.tid);
+    const int64_t end_ns = std::max(event.end_ns, event.start_ns + 1);
+    packets.push_back({end_ns, 0, PerfettoPacket(end_ns, end)});
+  }
+  std::stable_sort(packets.begin(), packets.end(), [](const Packet& a, const Packet& b) {
+    return a.timestamp_ns != b.timestamp_ns ? a.timestamp_ns < b.timestamp_ns : a.order < b.order;
+  });
+  for (const Packet& packet : packets)
+    trace.Bytes(kTracePacket, packet.bytes);
+  return trace.str();
+}
+
+}  // namespace webrtc
@@ -0,0 +1,98 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_TASK_TRACE_H_
+#define RTC_BASE_TASK_TRACE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+#include "inline_task.h"
+#include "location.h"
+#include "time_utils.h"
+
+namespace webrtc {
+
+// Timeline of the tasks run by the task queues: one span per task on the
+// thread that ran it, and a flow arrow from the place it was posted from.
+// The time between the two is what the task spent waiting in its queue.
+// Each thread records into a ring buffer of its own, with no locks; once the
+// ring is full, the oldest events are overwritten. While tracing is stopped
+// a post costs one relaxed load.
+class TaskTrace {
+ public:
+  // Events of tasks posted while tracing is stopped are not recorded.
+  static void Start();
+  static void Stop();
+  static bool IsEnabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  // The recorded events, as Chrome JSON trace format (for chrome://tracing
+  // and ui.perfetto.dev) or as a serialized perfetto.protos.Trace. Thread
+  // names are those given to rtc::SetCurrentThreadName(). Can be called
+  // while tracing.
+  static std::string ExportChromeJson();
+  static std::string ExportPerfetto();
+
+  // Records `location` as the post site of the tasks the current thread
+  // posts while the object lives. See TaskQueueBase::PostTask().
+  class PostSite {
+   public:
+    explicit PostSite(const Location& location);
+    PostSite(const PostSite&) = delete;
+    PostSite& operator=(const PostSite&) = delete;
+    ~PostSite();
+
+    // The innermost post site of the current thread, or null.
+    static const Location* Current();
+
+   private:
+    const Location* const previous_;
+  };
+
+  // For task queue implementations. OnPosted() records a post on the
+  // calling thread and returns the id of the flow to the task's span, or 0
+  // when not tracing.
+  static uint64_t OnPosted() { return IsEnabled() ? RecordPost() : 0; }
+
+  // Records the span of the task with flow `flow`, from construction to
+  // destruction, on the current thread. Does nothing for flow 0.
+  class TaskScope {
+   public:
+    explicit TaskScope(uint64_t flow) : flow_(flow), start_ns_(flow != 0 ? rtc::TimeNanos() : 0) {}
+    TaskScope(const TaskScope&) = delete;
+    TaskScope& operator=(const TaskScope&) = delete;
+    ~TaskScope() {
+      if (flow_ != 0)
+        RecordTask(flow_, start_ns_);
+    }
+
+   private:
+    const uint64_t flow_;
+    const int64_t start_ns_;
+  };
+
+  // Keeps the flow of a task that leaves its queue node, e.g. for a timer
+  // store: the returned closure records the span when it runs. Returns
+  // `task` itself for flow 0.
+  static QueuedClosure Bind(uint64_t flow, QueuedClosure task);
+
+  // Called by rtc::SetCurrentThreadName().
+  static void OnThreadNamed(const char* name);
+
+ private:
+  static uint64_t RecordPost();
+  static void RecordTask(uint64_t flow, int64_t start_ns);
+
+  static inline std::atomic<bool> enabled_{false};
+};
+
+}  // namespace webrtc
+#endif  // RTC_BASE_TASK_TRACE_H_
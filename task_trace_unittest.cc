@@ -0,0 +1,276 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "task_trace.h"
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "event.h"
+#include "gtest/gtest.h"
+#include "location.h"
+#include "platform_thread_types.h"
+#include "task_queue_base.h"
+#include "task_queue_factory.h"
+#include "task_queue_for_test.h"
+
+namespace webrtc {
+namespace {
+
+constexpr int kTimeoutMs = 5000;
+constexpr char kQueueName[] = "traced_queue";
+constexpr char kFile[] = "task_trace_unittest.cc";
+constexpr char kFunction[] = "TracedTask";
+
+// Posts a task from `location` to a new queue while tracing, and returns the
+// id of the thread that ran it. The queue is gone, and with it the task's
+// span recorded, when this returns.
+rtc::PlatformThreadId TracePostedTask(const Location& location) {
+  TaskTrace::Start();
+  rtc::PlatformThreadId queue_tid = 0;
+  {
+    auto queue = CreateNativeTaskQueueFactory()->CreateTaskQueue(kQueueName, TaskQueueFactory::Priority::NORMAL);
+    rtc::Event done;
+    queue->PostTask(
+        [&] {
+          queue_tid = rtc::CurrentThreadId();
+          done.Set();
+        },
+        location);
+    EXPECT_TRUE(done.Wait(kTimeoutMs));
+  }
+  TaskTrace::Stop();
+  return queue_tid;
+}
+
+std::string PostedFrom(const Location& location) {
+  return std::string(location.file()) + ":" + std::to_string(location.line());
+}
+
+// The Chrome JSON export has one event per line.
+std::vector<std::string> JsonEvents(const std::string& json) {
+  std::vector<std::string> events;
+  size_t start = 0;
+  while (start < json.size()) {
+    size_t end = json.find('\n', start);
+    if (end == std::string::npos)
+      end = json.size();
+    events.push_back(json.substr(start, end - start));
+    start = end + 1;
+  }
+  return events;
+}
+
+bool Contains(const std::string& event, const std::string& part) {
+  return event.find(part) != std::string::npos;
+}
+
+// The number value of `key` in `event`, e.g. "tid" or "id".
+std::string JsonNumber(const std::string& event, const std::string& key) {
+  const std::string prefix = "\"" + key + "\":";
+  const size_t start = event.find(prefix);
+  if (start == std::string::npos)
+    return "";
+  const size_t begin = start + prefix.size();
+  return event.substr(begin, event.find_first_of(",}", begin) - begin);
+}
+
+TEST(TaskTraceTest, ChromeJsonLinksThePostToTheTask) {
+  const Location location(kFile, __LINE__, kFunction);
+  const std::string tid = std::to_string(TracePostedTask(location));
+  const std::vector<std::string> events = JsonEvents(TaskTrace::ExportChromeJson());
+  const std::string posted_from = "\"posted_from\":\"" + PostedFrom(location) + "\"";
+
+  // The post instant, directly followed by the start of its flow. The rings
+  // keep the events of earlier runs of the test, so the post is the last one.
+  std::string flow;
+  for (size_t i = 0; i + 1 < events.size(); ++i) {
+    if (Contains(events[i], "\"ph\":\"X\"") && Contains(events[i], "\"name\":\"PostTask\"") &&
+        Contains(events[i], "\"dur\":0,") && Contains(events[i], posted_from)) {
+      ASSERT_TRUE(Contains(events[i + 1], "\"ph\":\"s\""));
+      flow = JsonNumber(events[i + 1], "id");
+    }
+  }
+  ASSERT_FALSE(flow.empty());
+
+  // The task's span on the queue thread, named after the posting function,
+  // and the end of the flow.
+  bool task = false;
+  bool flow_end = false;
+  bool thread_name = false;
+  for (const std::string& event : events) {
+    if (Contains(event, "\"ph\":\"X\"") && Contains(event, std::string("\"name\":\"") + kFunction + "\"") &&
+        Contains(event, posted_from) && Contains(event, "\"queued_us\":") && JsonNumber(event, "tid") == tid)
+      task = true;
+    if (Contains(event, "\"ph\":\"f\"") && JsonNumber(event, "id") == flow && JsonNumber(event, "tid") == tid)
+      flow_end = true;
+    if (Contains(event, "\"name\":\"thread_name\"") && JsonNumber(event, "tid") == tid &&
+        Contains(event, std::string("\"args\":{\"name\":\"") + kQueueName + "\"}"))
+      thread_name = true;
+  }
+  EXPECT_TRUE(task);
+  EXPECT_TRUE(flow_end);
+  EXPECT_TRUE(thread_name);
+}
+
+// Just enough of a protobuf reader for the messages ExportPerfetto() writes.
+struct ProtoField {
+  int number = 0;
+  uint64_t value = 0;  // Varint and fixed64 fields.
+  std::string bytes;   // Length delimited fields.
+};
+
+bool ReadVarint(const std::string& message, size_t* pos, uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; *pos < message.size() && shift < 64; shift += 7) {
+    const uint8_t byte = static_cast<uint8_t>(message[(*pos)++]);
+    *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+std::vector<ProtoField> ParseProto(const std::string& message) {
+  std::vector<ProtoField> fields;
+  size_t pos = 0;
+  while (pos < message.size()) {
+    uint64_t tag;
+    ProtoField field;
+    if (!ReadVarint(message, &pos, &tag)) {
+      ADD_FAILURE() << "Truncated tag";
+      break;
+    }
+    field.number = static_cast<int>(tag >> 3);
+    const int wire_type = tag & 7;
+    if (wire_type == 0) {
+      if (!ReadVarint(message, &pos, &field.value)) {
+        ADD_FAILURE() << "Truncated varint";
+        break;
+      }
+    } else if (wire_type == 1 && pos + 8 <= message.size()) {
+      for (int i = 0; i < 8; ++i)
+        field.value |= static_cast<uint64_t>(static_cast<uint8_t>(message[pos + i])) << (8 * i);
+      pos += 8;
+    } else if (wire_type == 2) {
+      uint64_t size;
+      if (!ReadVarint(message, &pos, &size) || size > message.size() - pos) {
+        ADD_FAILURE() << "Truncated field " << field.number;
+        break;
+      }
+      field.bytes = message.substr(pos, size);
+      pos += size;
+    } else {
+      ADD_FAILURE() << "Unexpected wire type " << wire_type;
+      break;
+    }
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+const ProtoField* FindField(const std::vector<ProtoField>& fields, int number) {
+  for (const ProtoField& field : fields) {
+    if (field.number == number)
+      return &field;
+  }
+  return nullptr;
+}
+
+// A TrackEvent, flattened.
+struct TrackEvent {
+  uint64_t timestamp_ns = 0;
+  uint64_t type = 0;
+  uint64_t track = 0;
+  std::string name;
+  uint64_t flow = 0;
+  uint64_t terminating_flow = 0;
+  std::string posted_from;
+};
+
+TEST(TaskTraceTest, PerfettoLinksThePostToTheTask) {
+  const Location location(kFile, __LINE__, kFunction);
+  const uint64_t tid = TracePostedTask(location);
+  std::string thread_name;
+  std::vector<TrackEvent> events;
+  for (const ProtoField& packet : ParseProto(TaskTrace::ExportPerfetto())) {
+    ASSERT_EQ(packet.number, 1);
+    const std::vector<ProtoField> fields = ParseProto(packet.bytes);
+    if (const ProtoField* descriptor = FindField(fields, 60)) {
+      const std::vector<ProtoField> track = ParseProto(descriptor->bytes);
+      const ProtoField* uuid = FindField(track, 1);
+      const ProtoField* thread = FindField(track, 4);
+      ASSERT_TRUE(uuid && thread);
+      const std::vector<ProtoField> thread_fields = ParseProto(thread->bytes);
+      const ProtoField* thread_tid = FindField(thread_fields, 2);
+      const ProtoField* name = FindField(thread_fields, 5);
+      ASSERT_TRUE(thread_tid);
+      EXPECT_EQ(thread_tid->value, uuid->value);
+      if (uuid->value == tid && name)
+        thread_name = name->bytes;
+      continue;
+    }
+    const ProtoField* track_event = FindField(fields, 11);
+    const ProtoField* timestamp = FindField(fields, 8);
+    ASSERT_TRUE(track_event && timestamp);
+    TrackEvent event;
+    event.timestamp_ns = timestamp->value;
+    for (const ProtoField& field : ParseProto(track_event->bytes)) {
+      if (field.number == 9)
+        event.type = field.value;
+      else if (field.number == 11)
+        event.track = field.value;
+      else if (field.number == 23)
+        event.name = field.bytes;
+      else if (field.number == 47)
+        event.flow = field.value;
+      else if (field.number == 48)
+        event.terminating_flow = field.value;
+      else if (field.number == 4) {
+        const std::vector<ProtoField> annotation = ParseProto(field.bytes);
+        if (const ProtoField* value = FindField(annotation, 6))
+          event.posted_from = value->bytes;
+      }
+    }
+    events.push_back(event);
+  }
+  EXPECT_EQ(thread_name, kQueueName);
+
+  // Packets come in timestamp order.
+  for (size_t i = 1; i < events.size(); ++i)
+    EXPECT_LE(events[i - 1].timestamp_ns, events[i].timestamp_ns);
+
+  // The post instant, then the task's slice on the queue thread's track,
+  // ending the post's flow, then the end of the slice. The rings keep the
+  // events of earlier runs of the test, so the post is the last one.
+  size_t post = events.size();
+  while (post > 0 && !(events[post - 1].type == 3 && events[post - 1].posted_from == PostedFrom(location)))
+    --post;
+  ASSERT_GT(post, 0u);
+  --post;
+  EXPECT_EQ(events[post].name, "PostTask");
+  ASSERT_NE(events[post].flow, 0u);
+  size_t begin = post + 1;
+  while (begin < events.size() && events[begin].terminating_flow != events[post].flow)
+    ++begin;
+  ASSERT_LT(begin, events.size());
+  EXPECT_EQ(events[begin].type, 1u);
+  EXPECT_EQ(events[begin].track, tid);
+  EXPECT_EQ(events[begin].name, kFunction);
+  EXPECT_EQ(events[begin].posted_from, PostedFrom(location));
+  size_t end = begin + 1;
+  while (end < events.size() && !(events[end].type == 2 && events[end].track == tid))
+    ++end;
+  EXPECT_LT(end, events.size());
+}
+
+}  // namespace
+}  // namespace webrtc
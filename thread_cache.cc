@@ -0,0 +1,128 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "thread_cache.h"
+
+#include <condition_variable>
+#include <iterator>
+#include <string>
+#include <utility>
+
+namespace rtc {
+
+class ThreadCache::Thread {
+ public:
+  explicit Thread(const ThreadAttributes& attributes)
+    : priority(attributes.priority), stack_size(attributes.stack_size), cacheable(Cacheable(attributes)) {}
+
+  // Runs the functions handed over by Start() until told to exit.
+  void Main() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [this] { return function != nullptr || exit; });
+      if (function == nullptr)
+        return;
+      std::function<void()> run = std::move(function);
+      function = nullptr;
+      lock.unlock();
+      SetCurrentThreadName(name.c_str());
+      run();
+      lock.lock();
+      running = false;
+      cv.notify_all();
+    }
+  }
+
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      exit = true;
+    }
+    cv.notify_all();
+    thread.Finalize();
+  }
+
+  const ThreadPriority priority;
+  const size_t stack_size;
+  const bool cacheable;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::function<void()> function;
+  std::string name;
+  bool running = false;
+  bool exit = false;
+  PlatformThread thread;
+};
+
+ThreadCache::ThreadCache(int size) : size_(size > 0 ? size : 0) {
+  for (size_t i = 0; i < size_; ++i)
+    parked_.push_back(Spawn(ThreadAttributes()));
+}
+
+ThreadCache::~ThreadCache() {
+  for (Thread* thread : parked_) {
+    thread->Stop();
+    delete thread;
+  }
+}
+
+bool ThreadCache::Cacheable(const ThreadAttributes& attributes) {
+  return attributes.cpu_set.empty() && attributes.numa_node < 0 &&
+         attributes.scheduling_policy == ThreadSchedulingPolicy::kDefault;
+}
+
+ThreadCache::Thread* ThreadCache::Spawn(const ThreadAttributes& attributes) {
+  Thread* thread = new Thread(attributes);
+  thread->thread = PlatformThread::SpawnJoinable([thread] { thread->Main(); }, "ThreadCache", attributes);
+  return thread;
+}
+
+ThreadCache::Thread* ThreadCache::Start(std::function<void()> function, absl::string_view name,
+                                        const ThreadAttributes& attributes) {
+  Thread* thread = nullptr;
+  if (Cacheable(attributes)) {
+    // The most recently parked thread first: its stack is likely still warm.
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = parked_.rbegin(); it != parked_.rend(); ++it) {
+      if ((*it)->priority == attributes.priority && (*it)->stack_size == attributes.stack_size) {
+        thread = *it;
+        parked_.erase(std::next(it).base());
+        break;
+      }
+    }
+  }
+  if (thread == nullptr)
+    thread = Spawn(attributes);
+  {
+    std::lock_guard<std::mutex> lock(thread->mutex);
+    thread->function = std::move(function);
+    thread->name = std::string(name);
+    thread->running = true;
+  }
+  thread->cv.notify_all();
+  return thread;
+}
+
+void ThreadCache::Join(Thread* thread) {
+  {
+    std::unique_lock<std::mutex> lock(thread->mutex);
+    thread->cv.wait(lock, [thread] { return !thread->running; });
+  }
+  if (thread->cacheable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (parked_.size() < size_) {
+      parked_.push_back(thread);
+      return;
+    }
+  }
+  thread->Stop();
+  delete thread;
+}
+
+}  // namespace rtc
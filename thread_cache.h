@@ -0,0 +1,55 @@
+/*
+ *  Copyright 2019 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#ifndef RTC_BASE_THREAD_CACHE_H_
+#define RTC_BASE_THREAD_CACHE_H_
+
+#include <mutex>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "platform_thread.h"
+
+namespace rtc {
+
+// Keeps threads parked after the function they ran returned, so that the
+// next one needed is taken from the cache instead of being spawned. A thread
+// is reused only for the same priority and stack size; threads with a CPU
+// set, NUMA node or scheduling policy are never cached, as those settings
+// are not undone.
+class ThreadCache {
+ public:
+  class Thread;
+
+  // Spawns `size` threads up front, with default attributes, and keeps at
+  // most `size` parked. Zero spawns a thread for every Start().
+  explicit ThreadCache(int size);
+  ThreadCache(const ThreadCache&) = delete;
+  ThreadCache& operator=(const ThreadCache&) = delete;
+  // Every thread handed out must have been joined.
+  ~ThreadCache();
+
+  // Runs `function` on a parked thread, renamed to `name`, or on a new one.
+  // Does not wait for the thread.
+  Thread* Start(std::function<void()> function, absl::string_view name, const ThreadAttributes& attributes);
+  // Waits for the function of `thread` to return, then parks the thread or,
+  // if it cannot be cached, lets it exit and joins it.
+  void Join(Thread* thread);
+
+ private:
+  static bool Cacheable(const ThreadAttributes& attributes);
+  Thread* Spawn(const ThreadAttributes& attributes);
+
+  const size_t size_;
+  std::mutex mutex_;
+  std::vector<Thread*> parked_;
+};
+
+}  // namespace rtc
+#endif  // RTC_BASE_THREAD_CACHE_H_
@@ -0,0 +1,94 @@
+/*
+ *  Copyright (c) 2018 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef API_UNITS_TIME_DELTA_H_
+#define API_UNITS_TIME_DELTA_H_
+
+#include <stdint.h>
+
+#include <limits>
+
+namespace webrtc {
+
+// TimeDelta represents the difference between two timestamps. It has
+// microsecond resolution and can be positive or negative.
+class TimeDelta {
+ public:
+  static constexpr TimeDelta Zero() { return TimeDelta(0); }
+  static constexpr TimeDelta PlusInfinity() {
+    return TimeDelta(std::numeric_limits<int64_t>::max());
+  }
+  static constexpr TimeDelta MinusInfinity() {
+    return TimeDelta(std::numeric_limits<int64_t>::min());
+  }
+  static constexpr TimeDelta Seconds(int64_t value) {
+    return TimeDelta(value * 1000000);
+  }
+  static constexpr TimeDelta Millis(int64_t value) {
+    return TimeDelta(value * 1000);
+  }
+  static constexpr TimeDelta Micros(int64_t value) { return TimeDelta(value); }
+
+  TimeDelta() = default;
+
+  constexpr int64_t us() const { return microseconds_; }
+  // Rounds towards negative infinity, like integer division on positives.
+  constexpr int64_t ms() const {
+    return microseconds_ >= 0 ? microseconds_ / 1000
+                              : -((-microseconds_ + 999) / 1000);
+  }
+  // Rounds up; a timer armed for RoundUpToMillis() never fires early.
+  constexpr int64_t RoundUpToMillis() const { return -TimeDelta(-microseconds_).ms(); }
+
+  constexpr bool IsZero() const { return microseconds_ == 0; }
+  constexpr bool IsFinite() const { return !IsPlusInfinity() && !IsMinusInfinity(); }
+  constexpr bool IsPlusInfinity() const {
+    return microseconds_ == std::numeric_limits<int64_t>::max();
+  }
+  constexpr bool IsMinusInfinity() const {
+    return microseconds_ == std::numeric_limits<int64_t>::min();
+  }
+
+  constexpr TimeDelta operator+(TimeDelta other) const {
+    return TimeDelta(microseconds_ + other.microseconds_);
+  }
+  constexpr TimeDelta operator-(TimeDelta other) const {
+    return TimeDelta(microseconds_ - other.microseconds_);
+  }
+  constexpr TimeDelta operator-() const { return TimeDelta(-microseconds_); }
+  constexpr TimeDelta operator*(int64_t scalar) const {
+    return TimeDelta(microseconds_ * scalar);
+  }
+  constexpr TimeDelta operator/(int64_t scalar) const {
+    return TimeDelta(microseconds_ / scalar);
+  }
+  TimeDelta& operator+=(TimeDelta other) {
+    microseconds_ += other.microseconds_;
+    return *this;
+  }
+  TimeDelta& operator-=(TimeDelta other) {
+    microseconds_ -= other.microseconds_;
+    return *this;
+  }
+
+  constexpr bool operator==(TimeDelta other) const { return microseconds_ == other.microseconds_; }
+  constexpr bool operator!=(TimeDelta other) const { return microseconds_ != other.microseconds_; }
+  constexpr bool operator<(TimeDelta other) const { return microseconds_ < other.microseconds_; }
+  constexpr bool operator<=(TimeDelta other) const { return microseconds_ <= other.microseconds_; }
+  constexpr bool operator>(TimeDelta other) const { return microseconds_ > other.microseconds_; }
+  constexpr bool operator>=(TimeDelta other) const { return microseconds_ >= other.microseconds_; }
+
+ private:
+  explicit constexpr TimeDelta(int64_t microseconds) : microseconds_(microseconds) {}
+  int64_t microseconds_ = 0;
+};
+
+}  // namespace webrtc
+#endif  // API_UNITS_TIME_DELTA_H_
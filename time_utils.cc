@@ -0,0 +1,26 @@
+/*
+ *  Copyright 2005 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "time_utils.h"
+
+#include <chrono>
+
+namespace rtc {
+
+int64_t TimeMicros() {
+  auto duration_now = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration_now).count();
+}
+
+int64_t TimeNanos() {
+  auto duration_now = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(duration_now).count();
+}
+
+}  // namespace rtc
@@ -0,0 +1,31 @@
+/*
+ *  Copyright 2005 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef RTC_BASE_TIME_UTILS_H_
+#define RTC_BASE_TIME_UTILS_H_
+
+#include <stdint.h>
+
+#include "timestamp.h"
+
+namespace rtc {
+
+// Microseconds on the monotonic clock (std::chrono::steady_clock, which is
+// CLOCK_MONOTONIC on Linux and QueryPerformanceCounter on Windows).
+int64_t TimeMicros();
+// Same clock in nanoseconds.
+int64_t TimeNanos();
+
+inline webrtc::Timestamp CurrentTimestamp() {
+  return webrtc::Timestamp::Micros(TimeMicros());
+}
+
+}  // namespace rtc
+#endif  // RTC_BASE_TIME_UTILS_H_
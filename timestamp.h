@@ -0,0 +1,81 @@
+/*
+ *  Copyright (c) 2018 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef API_UNITS_TIMESTAMP_H_
+#define API_UNITS_TIMESTAMP_H_
+
+#include <stdint.h>
+
+#include <limits>
+
+#include "time_delta.h"
+
+namespace webrtc {
+
+// Timestamp represents the time that has passed since some unspecified
+// epoch, in microseconds. Timestamps from rtc::CurrentTimestamp() use the
+// monotonic clock and are unaffected by wall-clock adjustments.
+class Timestamp {
+ public:
+  static constexpr Timestamp PlusInfinity() {
+    return Timestamp(std::numeric_limits<int64_t>::max());
+  }
+  static constexpr Timestamp MinusInfinity() {
+    return Timestamp(std::numeric_limits<int64_t>::min());
+  }
+  static constexpr Timestamp Seconds(int64_t value) {
+    return Timestamp(value * 1000000);
+  }
+  static constexpr Timestamp Millis(int64_t value) {
+    return Timestamp(value * 1000);
+  }
+  static constexpr Timestamp Micros(int64_t value) { return Timestamp(value); }
+
+  Timestamp() = delete;
+
+  constexpr int64_t us() const { return microseconds_; }
+  constexpr int64_t ms() const { return microseconds_ / 1000; }
+
+  constexpr bool IsFinite() const { return !IsPlusInfinity() && !IsMinusInfinity(); }
+  constexpr bool IsPlusInfinity() const {
+    return microseconds_ == std::numeric_limits<int64_t>::max();
+  }
+  constexpr bool IsMinusInfinity() const {
+    return microseconds_ == std::numeric_limits<int64_t>::min();
+  }
+
+  constexpr Timestamp operator+(TimeDelta delta) const {
+    return Timestamp(microseconds_ + delta.us());
+  }
+  constexpr Timestamp operator-(TimeDelta delta) const {
+    return Timestamp(microseconds_ - delta.us());
+  }
+  constexpr TimeDelta operator-(Timestamp other) const {
+    return TimeDelta::Micros(microseconds_ - other.microseconds_);
+  }
+  Timestamp& operator+=(TimeDelta delta) {
+    microseconds_ += delta.us();
+    return *this;
+  }
+
+  constexpr bool operator==(Timestamp other) const { return microseconds_ == other.microseconds_; }
+  constexpr bool operator!=(Timestamp other) const { return microseconds_ != other.microseconds_; }
+  constexpr bool operator<(Timestamp other) const { return microseconds_ < other.microseconds_; }
+  constexpr bool operator<=(Timestamp other) const { return microseconds_ <= other.microseconds_; }
+  constexpr bool operator>(Timestamp other) const { return microseconds_ > other.microseconds_; }
+  constexpr bool operator>=(Timestamp other) const { return microseconds_ >= other.microseconds_; }
+
+ private:
+  explicit constexpr Timestamp(int64_t microseconds) : microseconds_(microseconds) {}
+  int64_t microseconds_;
+};
+
+}  // namespace webrtc
+#endif  // API_UNITS_TIMESTAMP_H_